@@ -1,12 +1,17 @@
 #pragma once
 #include "Application.h"
 #include "ApplicationEvent.h"
+#include "obj_loader.h"
+#include "obj_bvh.h"
+#include "GPUMeshCache.h"
+#include "GPUGeometryArena.h"
+#include "GPUMaterialBuffer.h"
+#include "ShaderProgram.h"
+#include "DrawList.h"
 #include <vector>
 #include <string>
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
-//Forward declare OBJ model.
-class OBJModel;
 class Skybox;
 
 class _3DRenderingFramework : public Application
@@ -30,8 +35,15 @@ private:
 	void RenderGridLines(glm::mat4 a_projectionViewMatrix);
 
 	//Functions to set up and render all obj models.
+	//LoadObjModelData starts the model loading in the background, FinishObjModelLoad does the GL setup once it is done.
 	bool LoadObjModelData(std::string a_sFilename, float a_fModelScale);
+	void FinishObjModelLoad();
+	void ShowModelLoadProgress();
 	void RenderOBJModel(OBJModel* a_model, glm::mat4 a_projectionViewMatrix);
+	//Draw the model from the shared geometry arena, one multi-draw indirect call per texture set.
+	void RenderOBJModelIndirect(OBJModel* a_model, glm::mat4 a_projectionViewMatrix);
+	//Find the model's triangle under a window position, using the hierarchy built while loading.
+	bool PickOBJModel(glm::vec2 a_windowPosition, OBJRayHit& a_hit);
 	std::vector<std::string> CheckFileNameForSubFolder(std::string a_sFilename);
 	std::string CheckFilenameForOBJPrefix(std::string a_sFilename);
 
@@ -53,15 +65,34 @@ private:
 	glm::mat4 m_projectionMatrix;
 
 	//Shader programs.
-	unsigned int m_uiProgram;
-	unsigned int m_objProgram;
+	ShaderProgram m_uiProgram;
+	ShaderProgram m_objProgram;
+	ShaderProgram m_objIndirectProgram; //Not created without GL 4.6.
 	unsigned int m_lineVBO;
-	unsigned int m_objModelBuffer[2];
+	unsigned int m_lineVAO;
 	float m_lightStrength;
+	float m_lodPixelError; //Largest screen space error in pixels allowed when choosing a level of detail.
 
 	//Model.
 	std::vector<OBJModel*> m_objList;
 	OBJModel* m_objModel;
+	//GPU buffers of m_objModel's meshes, filled once its load has finished.
+	GPUMeshCache m_objMeshCache;
+	//m_objModel's materials, uploaded with its meshes and indexed by the draw list's material ids.
+	GPUMaterialBuffer m_objMaterialBuffer;
+	//Order m_objModel's meshes are drawn in by RenderOBJModel, rebuilt every frame.
+	DrawList m_objDrawList;
+	//The same meshes in shared buffers for multi-draw indirect rendering, filled the first time it is used.
+	GPUGeometryArena m_geometryArena;
+	bool m_useIndirectDraw = false;
+	OBJLoadHandle m_objModelLoad;
+	bool m_objModelReady = false;
+	std::string m_objModelName;
+	//Scratch lists for drawing the meshlets that survive culling, kept to avoid reallocating every frame.
+	std::vector<unsigned int> m_visibleMeshlets;
+	std::vector<int> m_meshletDrawCounts;
+	std::vector<const void*> m_meshletDrawOffsets;
+	std::vector<int> m_meshletDrawBaseVertices;
 	Line* m_lines;
 	Skybox* m_skybox = nullptr;
 
@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+class OBJModel;
+class OBJMaterial;
+
+//One visible mesh, drawn in the order of its key.
+typedef struct DrawItem
+{
+	uint64_t key;
+	unsigned int mesh;
+	const OBJMaterial* material; //After falling back on the last mesh's material, null for the default material.
+	unsigned int materialId; //0 for the default material, otherwise the material's index in the model plus one.
+}DrawItem;
+
+//The visible meshes of a model in the order that changes the least state between them. Each gets a 64 bit key, from
+//the top bit down: program, texture set, material, depth. The keys are radix sorted every frame, so textures and
+//material uniforms only change where the texture set or material does, and nearer meshes within a material are drawn
+//first so the depth test rejects what they hide.
+class DrawList
+{
+public:
+	enum KeyBits
+	{
+		DEPTH_BITS = 24,
+		MATERIAL_BITS = 20,
+		TEXTURE_SET_BITS = 16,
+		PROGRAM_BITS = 4,
+	};
+
+	DrawList();
+
+	//Cull a_model's meshes against the frustum and sort the survivors. a_clipFromModel takes model space positions to
+	//clip space, a_modelCameraPosition is in model space and a_program (below 1 << PROGRAM_BITS) identifies the shader.
+	void Build(OBJModel* a_model, unsigned int a_program, const glm::mat4& a_clipFromModel, const glm::vec3& a_modelCameraPosition);
+	//Call when the model passed to Build is unloaded, as its meshes and materials are remembered between frames.
+	void Clear();
+	const std::vector<DrawItem>& GetItems() const { return m_items; }
+
+private:
+	//Work out each mesh's material and the texture set and material bits of its key.
+	void SetModel(OBJModel* a_model);
+	//Least significant digit first, a byte at a time, skipping bytes every key shares.
+	static void RadixSort(std::vector<DrawItem>& a_items, std::vector<DrawItem>& a_scratch);
+
+	OBJModel* m_model;
+	std::vector<uint64_t> m_meshKeys; //Key bits that do not change between frames.
+	std::vector<const OBJMaterial*> m_meshMaterials;
+	std::vector<unsigned int> m_meshMaterialIds;
+	std::vector<float> m_meshDepths;
+	std::vector<DrawItem> m_items;
+	std::vector<DrawItem> m_scratch;
+};
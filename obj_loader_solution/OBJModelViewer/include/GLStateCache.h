@@ -0,0 +1,19 @@
+#pragma once
+
+//Remembers the program and texture bindings set through it and skips the GL calls that would not change anything.
+//Code that changes the same state directly (texture loading, imgui) leaves it out of date, call Invalidate once
+//before drawing a frame.
+class GLStateCache
+{
+public:
+	static void UseProgram(unsigned int a_program);
+	static unsigned int GetProgram();
+	//Bind a_texture to a_target on texture unit a_unit, the active unit only changes when a bind is needed.
+	static void BindTexture(unsigned int a_unit, unsigned int a_target, unsigned int a_texture);
+	//Forget everything, the next call of each kind always reaches GL.
+	static void Invalidate();
+
+private:
+	//Only has static functions.
+	GLStateCache() = delete;
+};
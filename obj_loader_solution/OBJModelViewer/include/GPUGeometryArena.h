@@ -0,0 +1,157 @@
+#pragma once
+#include "obj_loader.h"
+#include <map>
+#include <vector>
+#include <cstddef>
+#include <glm/glm.hpp>
+
+//Free list over a range of elements, first fit, freed ranges merge with their neighbours.
+class GPURangeAllocator
+{
+public:
+	GPURangeAllocator() : m_freeRanges(), m_capacity(0), m_freeCount(0) {};
+
+	//Returns false if no free range is large enough.
+	bool Allocate(size_t a_count, size_t& a_offset);
+	void Free(size_t a_offset, size_t a_count);
+	//Add free elements at the end up to a_capacity.
+	void Grow(size_t a_capacity);
+	void Reset();
+	size_t GetCapacity() const { return m_capacity; }
+	size_t GetFreeCount() const { return m_freeCount; }
+
+private:
+	std::map<size_t, size_t> m_freeRanges; //Offset to count.
+	size_t m_capacity;
+	size_t m_freeCount;
+};
+
+//Layout read by glMultiDrawElementsIndirect.
+typedef struct GPUDrawCommand
+{
+	unsigned int count;
+	unsigned int instanceCount;
+	unsigned int firstIndex;
+	int baseVertex;
+	unsigned int baseInstance; //Index of the mesh's GPUDrawRecord, the vertex shader reads it as gl_BaseInstance.
+}GPUDrawCommand;
+
+//Per mesh values for the indirect shaders, std430 layout.
+typedef struct GPUDrawRecord
+{
+	glm::vec4 positionScale;
+	glm::vec4 positionOffset;
+	int materialIndex;
+	int hasTangents;
+	int padding[2];
+}GPUDrawRecord;
+
+//Material values for the shaders, std430 layout and also std140 as no member crosses a 16 byte boundary. Entry 0 is
+//the default material.
+typedef struct GPUMaterialRecord
+{
+	glm::vec4 kA;
+	glm::vec4 kD;
+	glm::vec4 kS;
+	int textureUsed;
+	int padding[3];
+}GPUMaterialRecord;
+
+//Recorded commands that share a texture set, submitted with a single glMultiDrawElementsIndirect.
+typedef struct GPUDrawBatch
+{
+	const OBJMaterial* material; //Whose textures to bind, null for untextured meshes.
+	unsigned int firstCommand;
+	unsigned int commandCount;
+}GPUDrawBatch;
+
+//One vertex buffer (per stream) and one index buffer shared by the meshes of every model added, carved up by a
+//suballocator. Each frame a command is recorded per visible mesh and a model is submitted with one multi-draw per
+//texture set, so the CPU cost no longer grows with the number of meshes. Needs GL 4.6 for gl_BaseInstance.
+class GPUGeometryArena
+{
+public:
+	GPUGeometryArena();
+	~GPUGeometryArena();
+
+	//Set up for meshes with vertices in a_layout, a_withTangents adds a tangent stream.
+	void Create(OBJMesh::VertexLayout a_layout, bool a_withTangents);
+	//Delete all the GL objects, needs the context they were created in.
+	void Destroy();
+	bool IsCreated() const { return m_vao != 0; }
+
+	//Copy every mesh of a_model in, returns false and adds nothing if a mesh's layout does not match the arena's.
+	//The arena keeps pointers to the model's meshes and materials, remove the model before unloading it.
+	bool AddModel(OBJModel* a_model);
+	void RemoveModel(const OBJModel* a_model);
+	bool HasModel(const OBJModel* a_model) const;
+	//Colours used for meshes with no material to fall back on.
+	void SetDefaultMaterial(const glm::vec4& a_kA, const glm::vec4& a_kD, const glm::vec4& a_kS);
+
+	//Forget the commands recorded last frame.
+	void BeginFrame();
+	//Record commands for the meshes of a_model inside the frustum at the level of detail SelectLod picks.
+	//a_clipFromModel takes model space positions to clip space, a_modelCameraPosition is in model space.
+	void RecordDraws(const OBJModel* a_model, const glm::mat4& a_clipFromModel, const glm::vec3& a_modelCameraPosition, float a_pixelsPerUnit, float a_maxPixelError);
+	//Upload the recorded commands and bind the geometry and storage buffers, then submit each batch and end.
+	void BeginSubmit();
+	const std::vector<GPUDrawBatch>& GetBatches() const { return m_batches; }
+	void SubmitBatch(unsigned int a_batch) const;
+	void EndSubmit() const;
+	unsigned int GetCommandCount() const { return (unsigned int)m_commands.size(); }
+
+private:
+	//Copying would double delete the GL objects.
+	GPUGeometryArena(const GPUGeometryArena&) = delete;
+	GPUGeometryArena& operator=(const GPUGeometryArena&) = delete;
+
+	//Where a mesh's data sits in the shared buffers, in elements.
+	typedef struct ArenaMesh
+	{
+		const OBJMesh* mesh;
+		const OBJMaterial* material; //Drawn with, after falling back on the last mesh's material, null for the default.
+		size_t vertexOffset;
+		size_t vertexCount;
+		size_t indexOffset; //The mesh's indices, followed by its level of detail indices.
+		size_t indexCount;
+		size_t lodIndexCount;
+		unsigned int drawRecord;
+	}ArenaMesh;
+	//Meshes of a model grouped by the textures they are drawn with, in the model's mesh order within a group.
+	typedef struct ArenaBatch
+	{
+		const OBJMaterial* material; //The first material using these textures, null when none do.
+		std::vector<unsigned int> meshes;
+	}ArenaBatch;
+	typedef struct ArenaModel
+	{
+		const OBJModel* model;
+		std::vector<ArenaMesh> meshes;
+		std::vector<ArenaBatch> batches;
+	}ArenaModel;
+
+	//Resize every vertex stream or the index buffer, keeping the contents.
+	void GrowVertices(size_t a_capacity);
+	void GrowIndices(size_t a_capacity);
+	//Point the vertex array at the current buffers.
+	void SetUpVertexArray();
+	//Rebuild and upload the draw and material records after models are added or removed.
+	void UpdateRecords();
+
+	OBJMesh::VertexLayout m_layout;
+	unsigned int m_vao;
+	unsigned int m_vertexBuffers[4]; //Vertex (or position stream), normal stream, uv stream, tangent stream, unused ones are 0.
+	size_t m_vertexStrides[4];
+	unsigned int m_indexBuffer; //32 bit indices.
+	unsigned int m_indirectBuffer;
+	unsigned int m_drawRecordBuffer;
+	unsigned int m_materialBuffer;
+	GPURangeAllocator m_vertexAllocator;
+	GPURangeAllocator m_indexAllocator;
+	std::vector<ArenaModel> m_models;
+	std::vector<GPUDrawRecord> m_drawRecords;
+	std::vector<GPUMaterialRecord> m_materialRecords;
+	//Recorded this frame.
+	std::vector<GPUDrawCommand> m_commands;
+	std::vector<GPUDrawBatch> m_batches;
+};
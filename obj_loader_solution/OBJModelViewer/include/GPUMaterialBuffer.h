@@ -0,0 +1,44 @@
+#pragma once
+#include <glm/glm.hpp>
+
+class OBJModel;
+
+//Every material of a model in one uniform buffer, uploaded once, so a draw only has to say which material it uses.
+//Entry 0 is the default material and entry i + 1 is the model's material i. Shaders see a window of WINDOW_SIZE
+//entries at a time, the most a uniform block is guaranteed to hold, and Bind moves the window when a material
+//outside it is needed.
+class GPUMaterialBuffer
+{
+public:
+	enum
+	{
+		WINDOW_SIZE = 256, //Entries in the shader's array, 256 * 64 bytes is the 16KB every GL 4 context allows.
+		BLOCK_BINDING = 0, //Uniform buffer binding point the window is bound to.
+	};
+
+	GPUMaterialBuffer();
+	~GPUMaterialBuffer();
+
+	//Upload a_model's materials, replacing whatever was there before. Needs a current GL context.
+	void Upload(OBJModel* a_model);
+	//Delete the buffer, needs the context it was created in.
+	void Clear();
+	bool IsUploaded() const { return m_buffer != 0; }
+
+	//Colours of entry 0, only uploaded when they change.
+	void SetDefaultMaterial(const glm::vec4& a_kA, const glm::vec4& a_kD, const glm::vec4& a_kS);
+	//Forget which window is bound, call once a frame before the first Bind.
+	void BeginFrame() { m_boundWindow = -1; }
+	//Bind the window holding material a_materialId if it is not already, returns the id's index within the window.
+	unsigned int Bind(unsigned int a_materialId);
+
+private:
+	//Copying would double delete the buffer.
+	GPUMaterialBuffer(const GPUMaterialBuffer&) = delete;
+	GPUMaterialBuffer& operator=(const GPUMaterialBuffer&) = delete;
+
+	unsigned int m_buffer;
+	unsigned int m_windowCount; //The buffer is padded to whole windows so every bound range fills the block.
+	int m_boundWindow;
+	glm::vec4 m_defaultMaterial[3];
+};
@@ -0,0 +1,42 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+class OBJModel;
+
+//GPU copy of one OBJMesh, its vertex array object captures the attribute layout and the element buffer binding.
+typedef struct GPUMesh
+{
+	unsigned int vao;
+	unsigned int vertexBuffers[4]; //Vertex (or position stream), normal stream, uv stream, tangent stream, unused ones are 0.
+	unsigned int indexBuffer; //The mesh's indices followed by its level of detail indices.
+	unsigned int indexType; //GL_UNSIGNED_SHORT or GL_UNSIGNED_INT for the mesh's own indices.
+	size_t lodIndexOffset; //Byte offset of the 32 bit level of detail indices in indexBuffer.
+}GPUMesh;
+
+//Uploads each mesh of a model into its own buffers once, so rendering only binds and draws.
+class GPUMeshCache
+{
+public:
+	GPUMeshCache();
+	~GPUMeshCache();
+
+	//Upload every mesh of a_model, replacing whatever was cached before. Needs a current GL context.
+	void Upload(OBJModel* a_model);
+	//Delete all the GL objects, needs the context they were created in.
+	void Clear();
+
+	unsigned int GetMeshCount() const { return (unsigned int)m_meshes.size(); }
+	//Meshes are in the same order as the model's.
+	const GPUMesh& GetMesh(unsigned int a_index) const { return m_meshes[a_index]; }
+	//Total size of the buffers created by the last Upload.
+	size_t GetBytesUploaded() const { return m_bytesUploaded; }
+
+private:
+	//Copying would double delete the GL objects.
+	GPUMeshCache(const GPUMeshCache&) = delete;
+	GPUMeshCache& operator=(const GPUMeshCache&) = delete;
+
+	std::vector<GPUMesh> m_meshes;
+	size_t m_bytesUploaded;
+};
@@ -0,0 +1,60 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <glm/fwd.hpp>
+
+//A linked shader program with its active uniforms looked up once at link time. Setting a uniform is a table lookup
+//and the value is only sent to GL when it differs from the last one sent, uniforms keep their values while the
+//program is not in use so this holds across frames.
+class ShaderProgram
+{
+public:
+	ShaderProgram();
+	~ShaderProgram();
+
+	//Link compiled shaders with ShaderUtil::CreateProgram, the shaders can be deleted afterwards.
+	bool Create(unsigned int a_vertexShader, unsigned int a_fragmentShader);
+	//Load, compile and link the two shader files.
+	bool Create(const char* a_vertexFilename, const char* a_fragmentFilename);
+	void Destroy();
+	bool IsValid() const { return m_program != 0; }
+	unsigned int GetHandle() const { return m_program; }
+
+	//Make the program current through GLStateCache.
+	void Use() const;
+	//-1 for names that are not active uniforms, which GL ignores like any other location of -1.
+	int GetUniformLocation(std::string_view a_name) const;
+	//Setters make the program current, uniforms that are not active are ignored.
+	void SetUniform(std::string_view a_name, int a_value);
+	void SetUniform(std::string_view a_name, float a_value);
+	void SetUniform(std::string_view a_name, const glm::vec3& a_value);
+	void SetUniform(std::string_view a_name, const glm::vec4& a_value);
+	void SetUniform(std::string_view a_name, const glm::mat4& a_value);
+	//Read the uniform block a_name from buffer binding point a_binding, GLSL 4.0 can not set it in the shader.
+	void SetUniformBlockBinding(const char* a_name, unsigned int a_binding);
+
+private:
+	//Copying would double delete the program.
+	ShaderProgram(const ShaderProgram&) = delete;
+	ShaderProgram& operator=(const ShaderProgram&) = delete;
+
+	typedef struct Uniform
+	{
+		std::string name;
+		int location;
+		bool valueKnown; //False until the first upload.
+		float value[16]; //Last value uploaded, ints are stored bit for bit.
+	}Uniform;
+
+	//Query the active uniforms of m_program.
+	void ReflectUniforms();
+	//The uniform to upload a_size bytes to, or null when a_value is what it already holds.
+	Uniform* PrepareUpload(std::string_view a_name, const void* a_value, size_t a_size);
+
+	unsigned int m_program;
+	std::vector<Uniform> m_uniforms;
+	//Keys view the names in m_uniforms.
+	std::unordered_map<std::string_view, unsigned int> m_uniformsByName;
+};
@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <glm/fwd.hpp>
+#include "ShaderProgram.h"
 
 class CubeMap;
 class Skybox
@@ -26,7 +27,7 @@ private:
 	//Skybox Functions.
 
 	//Skybox Variables.
-	unsigned int m_SkyboxShader;
+	ShaderProgram m_SkyboxShader;
 	unsigned int m_skyboxVAO;
 	unsigned int m_skyboxVBO;
 };
\ No newline at end of file
@@ -3,6 +3,14 @@
 smooth in vec4 vertPos;
 smooth in vec4 vertNormal;
 smooth in vec2 vertUV;
+smooth in vec4 vertTangent;
+//Material values passed through by the vertex shader.
+flat in vec4 vertKA;
+flat in vec4 vertKD;
+flat in vec4 vertKS;
+flat in int vertTextureUsed;
+//Whether the mesh has tangents, only meshes with a normal map are given them.
+flat in int vertHasTangents;
 
 out vec4 outputColour;
 
@@ -10,13 +18,6 @@ uniform float lightStrength;
 
 uniform vec4 camPos;
 
-uniform vec4 kA;
-uniform vec4 kD;
-uniform vec4 kS;
-
-//Uniform for whether or not textures are used.
-uniform int textureUsed;
-
 //Uniforms for texture data.
 uniform sampler2D DiffuseTexture;
 uniform sampler2D SpecularTexture;
@@ -31,6 +32,10 @@ vec4 lightDir = normalize(vec4(0.0f) - vec4(10.0f, 8.0f, 1.0f, 0.0f));
 //TODO:: FIGURE OUT HOW TO MAKE THE TEXTURE DATA HIGHER WEIGHTED.
 void main()
 {
+	vec4 kA = vertKA;
+	vec4 kD = vertKD;
+	vec4 kS = vertKS;
+	int textureUsed = vertTextureUsed;
 	//Calculate Correct Normal Value From passed in value.
 	float nDl = max(0.0f, dot(normalize(vertNormal), -lightDir));
 	vec3 R = (reflect(lightDir, normalize(vertNormal)).xyz); //Reflect light vector.
@@ -44,9 +49,17 @@ void main()
 		//Get texture data from UV coords.
 		vec4 diffuseTextureData = texture(DiffuseTexture, vertUV);
 		vec4 specularTextureData =  texture(SpecularTexture, vertUV);
-		vec4 normalTextureData = texture(NormalTexture, vertUV);
-		nDl = max(0.0f, dot(normalize(normalTextureData), -lightDir));
-		R = (reflect(lightDir, normalize(normalTextureData)).xyz); //Reflect light vector.
+		//The normal map is in tangent space, bring it into the same space as the vertex normal.
+		vec4 surfaceNormal = normalize(vertNormal);
+		if(vertHasTangents != 0){
+			vec3 normalTextureData = texture(NormalTexture, vertUV).xyz * 2.0f - 1.0f;
+			vec3 N = surfaceNormal.xyz;
+			vec3 T = vertTangent.xyz;
+			vec3 B = vertTangent.w * cross(N, T); //Bitangent rebuilt per pixel as MikkTSpace expects.
+			surfaceNormal = vec4(normalize(normalTextureData.x * T + normalTextureData.y * B + normalTextureData.z * N), 0.0f);
+		}
+		nDl = max(0.0f, dot(surfaceNormal, -lightDir));
+		R = (reflect(lightDir, surfaceNormal).xyz); //Reflect light vector.
 		Ambient = diffuseTextureData.rgb + kA.xyz * iA; //Ambient light.
 		Ambient = Ambient / 2.0f;
 		//Get lambertian Term.
@@ -1,20 +1,72 @@
 #version 400
 
-layout(location = 0) in vec4 position;
-layout(location = 1) in vec4 normal;
+//Positions and normals are read as vec3 so both interleaved vec4 data and packed vec3 streams can be bound.
+//Quantized meshes bind normalised 16 bit positions and an octahedral normal in normal.xy instead.
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
 layout(location = 2) in vec2 uvCoord;
+//Tangent in xyz and bitangent sign in w, all zero for meshes without tangents.
+layout(location = 3) in vec4 tangent;
 
 smooth out vec4 vertPos;
 smooth out vec4 vertNormal;
 smooth out vec2 vertUV;
+smooth out vec4 vertTangent;
+//Material values, read from the uniform buffer here and from the per draw storage buffers in obj_vertex_indirect.glsl.
+flat out vec4 vertKA;
+flat out vec4 vertKD;
+flat out vec4 vertKS;
+flat out int vertTextureUsed;
+flat out int vertHasTangents;
 
 uniform mat4 ProjectionViewMatrix;
 uniform mat4 ModelMatrix;
 
+//Position decode, identity unless the mesh is quantized.
+uniform vec3 PositionScale;
+uniform vec3 PositionOffset;
+uniform int OctahedralNormals;
+
+//Matches GPUMaterialRecord, std140 rounds it up to the same 64 byte stride.
+struct MaterialRecord
+{
+	vec4 kA;
+	vec4 kD;
+	vec4 kS;
+	int textureUsed;
+};
+
+//The window of the model's materials GPUMaterialBuffer has bound, uploaded once when the model loaded.
+layout(std140) uniform Materials
+{
+	MaterialRecord materialRecords[256];
+};
+//The mesh's material within the window.
+uniform int MaterialIndex;
+//Whether the mesh has tangents, only meshes with a normal map are given them.
+uniform int HasTangents;
+
+vec3 DecodeOctahedral(vec2 e)
+{
+	vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+	if (n.z < 0.0f)
+	{
+		n.xy = (1.0f - abs(n.yx)) * vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return normalize(n);
+}
+
 void main()
 {
+	MaterialRecord material = materialRecords[MaterialIndex];
+	vertKA = material.kA;
+	vertKD = material.kD;
+	vertKS = material.kS;
+	vertTextureUsed = material.textureUsed;
+	vertHasTangents = HasTangents;
 	vertUV = uvCoord;
-	vertNormal = normal;
-	vertPos = ModelMatrix * position; //World space position.
-	gl_Position = ProjectionViewMatrix * ModelMatrix * position;
+	vertTangent = tangent;
+	vertNormal = vec4((OctahedralNormals != 0) ? DecodeOctahedral(normal.xy) : normal, 0.0f);
+	vertPos = ModelMatrix * vec4(position * PositionScale + PositionOffset, 1.0f); //World space position.
+	gl_Position = ProjectionViewMatrix * vertPos;
 }
\ No newline at end of file
@@ -0,0 +1,81 @@
+#version 460
+
+//obj_vertex.glsl for meshes drawn from the shared geometry arena with glMultiDrawElementsIndirect. Each draw command's
+//base instance is the index of its mesh's record, which replaces the per mesh uniforms.
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 uvCoord;
+layout(location = 3) in vec4 tangent;
+
+smooth out vec4 vertPos;
+smooth out vec4 vertNormal;
+smooth out vec2 vertUV;
+smooth out vec4 vertTangent;
+flat out vec4 vertKA;
+flat out vec4 vertKD;
+flat out vec4 vertKS;
+flat out int vertTextureUsed;
+flat out int vertHasTangents;
+
+//Matches GPUDrawRecord.
+struct DrawRecord
+{
+	vec4 positionScale;
+	vec4 positionOffset;
+	int materialIndex;
+	int hasTangents;
+	int padding0;
+	int padding1;
+};
+
+//Matches GPUMaterialRecord.
+struct MaterialRecord
+{
+	vec4 kA;
+	vec4 kD;
+	vec4 kS;
+	int textureUsed;
+	int padding0;
+	int padding1;
+	int padding2;
+};
+
+layout(std430, binding = 0) readonly buffer DrawRecords
+{
+	DrawRecord drawRecords[];
+};
+
+layout(std430, binding = 1) readonly buffer MaterialRecords
+{
+	MaterialRecord materialRecords[];
+};
+
+uniform mat4 ProjectionViewMatrix;
+uniform mat4 ModelMatrix;
+uniform int OctahedralNormals;
+
+vec3 DecodeOctahedral(vec2 e)
+{
+	vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+	if (n.z < 0.0f)
+	{
+		n.xy = (1.0f - abs(n.yx)) * vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return normalize(n);
+}
+
+void main()
+{
+	DrawRecord record = drawRecords[gl_BaseInstance];
+	MaterialRecord material = materialRecords[record.materialIndex];
+	vertKA = material.kA;
+	vertKD = material.kD;
+	vertKS = material.kS;
+	vertTextureUsed = material.textureUsed;
+	vertHasTangents = record.hasTangents;
+	vertUV = uvCoord;
+	vertTangent = tangent;
+	vertNormal = vec4((OctahedralNormals != 0) ? DecodeOctahedral(normal.xy) : normal, 0.0f);
+	vertPos = ModelMatrix * vec4(position * record.positionScale.xyz + record.positionOffset.xyz, 1.0f); //World space position.
+	gl_Position = ProjectionViewMatrix * vertPos;
+}
@@ -1,5 +1,6 @@
 #include "3DRenderingFramework.h"
 #include "ShaderUtil.h"
+#include "GLStateCache.h"
 #include "Utilities.h"
 #include "Dispatcher.h"
 #include <glad/glad.h>
@@ -35,6 +36,7 @@ void GlobalWindowResizeEventHandler(WindowResizeEvent* e)
 bool _3DRenderingFramework::OnCreate(std::string a_modelToLoad, float a_modelScale)
 {
 	m_lightStrength = 100.0f;
+	m_lodPixelError = 1.0f;
 	Dispatcher* dp = Dispatcher::GetInstance();
 	if (dp)
 	{
@@ -67,7 +69,7 @@ bool _3DRenderingFramework::OnCreate(std::string a_modelToLoad, float a_modelSca
 	m_skybox = new Skybox();
 	m_skybox->SetUpSkybox();
 
-	//Load the model data for specified obj file.
+	//Start loading the model data for specified obj file.
 	LoadObjModelData(a_modelToLoad, a_modelScale);
 
 	//Set default model colour.
@@ -80,9 +82,25 @@ void _3DRenderingFramework::Update(float deltaTime)
 {
 	Utility::FreeMovement(m_cameraMatrix, deltaTime, 4.0f);
 
+	//Pick up the model once the background load has finished, until then show how far along it is.
+	if (m_objModelLoad.IsValid())
+	{
+		if (m_objModelLoad.IsReady())
+		{
+			FinishObjModelLoad();
+		}
+		else
+		{
+			ShowModelLoadProgress();
+		}
+	}
+
 	//Set up an imgui window to control default material colour.
 	ImGuiIO& io = ImGui::GetIO();
-	ImVec2 window_size = ImVec2(600.0f, 100.0f);
+	//Pick the triangle under the mouse cursor unless the cursor is over an imgui window.
+	OBJRayHit pick;
+	bool picked = m_objModelReady && ImGui::IsMousePosValid() && !io.WantCaptureMouse && PickOBJModel(glm::vec2(io.MousePos.x, io.MousePos.y), pick);
+	ImVec2 window_size = ImVec2(600.0f, 165.0f);
 	ImVec2 window_pos = ImVec2((io.DisplaySize.x * 0.99f) - window_size.x, io.DisplaySize.y * 0.01f);
 	ImGui::SetNextWindowPos(window_pos, ImGuiCond_Always);
 	ImGui::SetNextWindowSize(window_size, ImGuiCond_Always);
@@ -90,12 +108,27 @@ void _3DRenderingFramework::Update(float deltaTime)
 	{
 		ImGui::ColorEdit3("Default Material Colour: ", glm::value_ptr(m_defaultMaterialColour));
 		ImGui::SliderFloat("Scene Lightin%", &m_lightStrength, 10.0f, 100.0f);
+		ImGui::SliderFloat("LOD Pixel Error", &m_lodPixelError, 0.0f, 8.0f);
+		if (m_objIndirectProgram.IsValid())
+		{
+			ImGui::Checkbox("Multi-Draw Indirect", &m_useIndirectDraw);
+		}
+		if (picked)
+		{
+			ImGui::Text("Under Cursor: %s, triangle %u (%.2f, %.2f)", m_objModel->GetMeshByIndex(pick.mesh)->m_name.c_str(), pick.triangle, pick.barycentrics.x, pick.barycentrics.y);
+		}
+		else
+		{
+			ImGui::Text("Under Cursor: <nothing>");
+		}
 	}
 	ImGui::End();
 }
 
 void _3DRenderingFramework::Draw()
 {
+	//Texture loading and imgui change bindings behind the state cache's back, start each frame from scratch.
+	GLStateCache::Invalidate();
 	//Clear the back buffer.
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	//Draw code goes here.
@@ -109,184 +142,231 @@ void _3DRenderingFramework::Draw()
 	//Render the grid lines.
 	RenderGridLines(projectionViewMatrix);
 
-	//Render the obj model.
-	RenderOBJModel(m_objModel, projectionViewMatrix);
-
-	glDisableVertexAttribArray(0);
-	glDisableVertexAttribArray(1);
-	glDisableVertexAttribArray(2);
+	//Render the obj model once it has finished loading.
+	if (m_objModelReady)
+	{
+		//Each way of drawing uploads the model the first time it is used, the arena only takes meshes of one layout.
+		if (m_useIndirectDraw && !m_geometryArena.HasModel(m_objModel))
+		{
+			if (!m_geometryArena.IsCreated())
+			{
+				bool withTangents = false;
+				for (unsigned int i = 0; i < m_objModel->GetMeshCount(); i++)
+				{
+					withTangents = withTangents || m_objModel->GetMeshByIndex(i)->HasTangents();
+				}
+				m_geometryArena.Create(m_objModel->GetMeshCount() > 0 ? m_objModel->GetMeshByIndex(0)->GetVertexLayout() : OBJMesh::LAYOUT_INTERLEAVED, withTangents);
+			}
+			if (!m_geometryArena.AddModel(m_objModel))
+			{
+				std::cout << "Model meshes have mixed vertex layouts, drawing them one at a time." << std::endl;
+				m_useIndirectDraw = false;
+			}
+		}
+		if (m_useIndirectDraw)
+		{
+			RenderOBJModelIndirect(m_objModel, projectionViewMatrix);
+		}
+		else
+		{
+			if (m_objMeshCache.GetMeshCount() != m_objModel->GetMeshCount())
+			{
+				m_objMeshCache.Upload(m_objModel);
+				std::cout << "Uploaded " << m_objMeshCache.GetBytesUploaded() / (1024.0f * 1024.0f) << "MB of mesh data." << std::endl;
+			}
+			if (!m_objMaterialBuffer.IsUploaded())
+			{
+				m_objMaterialBuffer.Upload(m_objModel);
+			}
+			RenderOBJModel(m_objModel, projectionViewMatrix);
+		}
+	}
 
-	glUseProgram(0);
+	GLStateCache::UseProgram(0);
 }
 
 void _3DRenderingFramework::RenderOBJModel(OBJModel* a_model, glm::mat4 a_projectionViewMatrix)
 {
-	//Enable obj model shader.
-	glUseProgram(m_objProgram);
+	//Enable obj model shader, its uniform locations were looked up when it was linked and a value that has not
+	//changed since it was last set is not sent to GL again.
+	m_objProgram.Use();
 	//Set the light level for this shader.
-	int lightLevelUniformLocation = glGetUniformLocation(m_objProgram, "lightStrength");
-	glUniform1f(lightLevelUniformLocation, m_lightStrength);
+	m_objProgram.SetUniform("lightStrength", m_lightStrength);
 	//Set the projection view matrix for this shader.
-	int projectionViewUniformLocation = glGetUniformLocation(m_objProgram, "ProjectionViewMatrix");
-	//Send this location a pointer to our glm::mat4 (send across float data).
-	glUniformMatrix4fv(projectionViewUniformLocation, 1, false, glm::value_ptr(a_projectionViewMatrix));
-	OBJMaterial* lastOkMaterial = nullptr;
-	for (int i = 0; i < a_model->GetMeshCount(); i++)
+	m_objProgram.SetUniform("ProjectionViewMatrix", a_projectionViewMatrix);
+	//Send the OBJ Model's world matrix data across to the shader program.
+	m_objProgram.SetUniform("ModelMatrix", a_model->GetWorldMatrix());
+	m_objProgram.SetUniform("camPos", m_cameraMatrix[3]);
+	//Texture units are fixed, only the textures bound to them change.
+	m_objProgram.SetUniform("DiffuseTexture", 0);
+	m_objProgram.SetUniform("SpecularTexture", 1);
+	m_objProgram.SetUniform("NormalTexture", 2);
+	//Value read by meshes whose VAO has no tangent stream.
+	glVertexAttrib4f(3, 0.0f, 0.0f, 0.0f, 0.0f);
+	//Material values were uploaded with the model, only the default material's follow the colour picker.
+	m_objMaterialBuffer.SetDefaultMaterial(m_defaultMaterialColour,
+		glm::vec4(m_defaultMaterialColour.x * 4, m_defaultMaterialColour.y * 4, m_defaultMaterialColour.z * 4, 1.0f),
+		glm::vec4(1.0f, 1.0f, 1.0f, 64.0f));
+	m_objMaterialBuffer.BeginFrame();
+	//Visible meshes sorted by textures and material then front to back, the state cache and uniform cache skip
+	//everything that is the same as the previous mesh's.
+	glm::mat4 worldMatrix = a_model->GetWorldMatrix();
+	glm::vec3 modelCameraPosition = glm::vec3(glm::inverse(worldMatrix) * m_cameraMatrix[3]);
+	float pixelsPerUnit = m_projectionMatrix[1][1] * m_windowHeight * 0.5f;
+	m_objDrawList.Build(a_model, 0, a_projectionViewMatrix * worldMatrix, modelCameraPosition);
+	for (const DrawItem& item : m_objDrawList.GetItems())
 	{
-		//Get the model matrix location from the shader program.
-		int modelMatrixUniformLocation = glGetUniformLocation(m_objProgram, "ModelMatrix");
-		//Send the OBJ Model's world matrix data across to the shader program.
-		glUniformMatrix4fv(modelMatrixUniformLocation, 1, false, glm::value_ptr(a_model->GetWorldMatrix()));
-
-		int cameraPositionUniformLocation = glGetUniformLocation(m_objProgram, "camPos");
-		glUniform4fv(cameraPositionUniformLocation, 1, glm::value_ptr(m_cameraMatrix[3]));
-
-		OBJMesh* pMesh = nullptr;
-		pMesh = a_model->GetMeshByIndex(i);
-		//pMesh->CalculateFaceNormals();
-		//Send material data to shader.
-		int kA_location = glGetUniformLocation(m_objProgram, "kA");
-		int kD_location = glGetUniformLocation(m_objProgram, "kD");;
-		int kS_location = glGetUniformLocation(m_objProgram, "kS");
-		int okTexLoc = glGetUniformLocation(m_objProgram, "textureUsed");
-
-
-		OBJMaterial* p_material = nullptr;
-		if (pMesh != nullptr)
+		unsigned int i = item.mesh;
+		OBJMesh* pMesh = a_model->GetMeshByIndex(i);
+		//Meshes without a material use the last one seen in file order, or the default material when there has not been one.
+		//Either way the shader only needs the material's index, meshes sharing a material skip the upload.
+		m_objProgram.SetUniform("MaterialIndex", (int)m_objMaterialBuffer.Bind(item.materialId));
+		const OBJMaterial* lastOkMaterial = item.material;
+		if (lastOkMaterial != nullptr)
 		{
-			p_material = pMesh->m_material;
+			//Bind the material's diffuse, specular and normal textures to units 0, 1 and 2, meshes sharing a material skip the binds.
+			GLStateCache::BindTexture(0, GL_TEXTURE_2D, lastOkMaterial->textureIDs[OBJMaterial::TextureTypes::DiffuseTexture]);
+			GLStateCache::BindTexture(1, GL_TEXTURE_2D, lastOkMaterial->textureIDs[OBJMaterial::TextureTypes::SpecularTexture]);
+			GLStateCache::BindTexture(2, GL_TEXTURE_2D, lastOkMaterial->textureIDs[OBJMaterial::TextureTypes::NormalTexture]);
 		}
-		if (p_material != nullptr)
+		//Tell the shader how to decode this mesh's vertices, only quantized meshes need anything other than the identity.
+		m_objProgram.SetUniform("PositionScale", pMesh->m_positionScale);
+		m_objProgram.SetUniform("PositionOffset", pMesh->m_positionOffset);
+		m_objProgram.SetUniform("OctahedralNormals", pMesh->GetVertexLayout() == OBJMesh::LAYOUT_QUANTIZED ? 1 : 0);
+		//Meshes without tangents get a zero tangent and no normal mapping.
+		m_objProgram.SetUniform("HasTangents", pMesh->HasTangents() ? 1 : 0);
+		//The mesh's buffers were uploaded once when the model finished loading, its VAO holds the whole layout.
+		const GPUMesh& gpuMesh = m_objMeshCache.GetMesh(i);
+		glBindVertexArray(gpuMesh.vao);
+
+		//Pick the coarsest level of detail whose error stays under m_lodPixelError pixels on screen.
+		unsigned int lod = pMesh->SelectLod(modelCameraPosition, pixelsPerUnit, m_lodPixelError);
+		if (lod > 0)
 		{
-			//Tell the shader there is an ok material.
-			glUniform1i(okTexLoc, 1);
-
-			lastOkMaterial = p_material;
-			//Send the OBJ Model's world matrix data across to the shader program.
-			glUniform4fv(kA_location, 1, glm::value_ptr(p_material->kA));
-			glUniform4fv(kD_location, 1, glm::value_ptr(p_material->kD));
-			glUniform4fv(kS_location, 1, glm::value_ptr(p_material->kS));
-
-			//Get the location of the diffuse texture.
-			int texUniformLoc = glGetUniformLocation(m_objProgram, "DiffuseTexture");
-			glUniform1i(texUniformLoc, 0); //Set diffuse texture to be GL_Texture0.
-
-			glActiveTexture(GL_TEXTURE0);//Set the active texture unity to texture0.
-			//Bind the texture for diffuse for this material to the texture0.
-			glBindTexture(GL_TEXTURE_2D, p_material->textureIDs[OBJMaterial::TextureTypes::DiffuseTexture]);
-
-			//Get the location of the diffuse texture.
-			texUniformLoc = glGetUniformLocation(m_objProgram, "SpecularTexture");
-			glUniform1i(texUniformLoc, 1); //Set diffuse texture to be GL_Texture1.
-
-			glActiveTexture(GL_TEXTURE1); //Set the active texture unity to texture1.
-			//Bind the texture for diffuse for this material to the texture0.
-			glBindTexture(GL_TEXTURE_2D, p_material->textureIDs[OBJMaterial::TextureTypes::SpecularTexture]);
-
-			//Get the location of the diffuse texture.
-			texUniformLoc = glGetUniformLocation(m_objProgram, "NormalTexture");
-			glUniform1i(texUniformLoc, 2); //Set diffuse texture to be GL_Texture2.
-
-			glActiveTexture(GL_TEXTURE2); //Set the active texture unit to texture2.
-			//Bind the texture for diffuse for this material to the texture0.
-			glBindTexture(GL_TEXTURE_2D, p_material->textureIDs[OBJMaterial::TextureTypes::NormalTexture]);
+			//Levels index the mesh's vertices directly with 32 bit indices, stored after the mesh's own indices.
+			const OBJLodLevel& level = pMesh->m_lodLevels[lod - 1];
+			glDrawElements(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT, ((char*)0) + gpuMesh.lodIndexOffset + level.indexStart * sizeof(unsigned int));
 		}
-		else //No material to obtain lighting information from, use defaults.
+		else if (!pMesh->m_meshlets.empty())
 		{
-			//Check previous material to see if we can apply that texture data to the mesh instead.
-			if (lastOkMaterial != nullptr)
+			//Cull meshlets against the frustum and their normal cones, then draw the survivors with neighbouring
+			//meshlets merged into one draw since they are contiguous in the index buffer.
+			m_visibleMeshlets.clear();
+			pMesh->CullMeshlets(a_projectionViewMatrix * worldMatrix, modelCameraPosition, m_visibleMeshlets);
+			size_t indexSize = pMesh->HasShortIndices() ? sizeof(uint16_t) : sizeof(unsigned int);
+			m_meshletDrawCounts.clear();
+			m_meshletDrawOffsets.clear();
+			m_meshletDrawBaseVertices.clear();
+			unsigned int drawEnd = 0;
+			for (unsigned int m : m_visibleMeshlets)
 			{
-				//Tell the shader there is an ok material.
-				glUniform1i(okTexLoc, 1);
-
-				//Send the OBJ Model's world matrix data across to the shader program.
-				glUniform4fv(kA_location, 1, glm::value_ptr(lastOkMaterial->kA));
-				glUniform4fv(kD_location, 1, glm::value_ptr(lastOkMaterial->kD));
-				glUniform4fv(kS_location, 1, glm::value_ptr(lastOkMaterial->kS));
-
-				//Get the location of the diffuse texture.
-				int texUniformLoc = glGetUniformLocation(m_objProgram, "DiffuseTexture");
-				glUniform1i(texUniformLoc, 0); //Set diffuse texture to be GL_Texture0.
-
-				glActiveTexture(GL_TEXTURE0);//Set the active texture unity to texture0.
-				//Bind the texture for diffuse for this material to the texture0.
-				glBindTexture(GL_TEXTURE_2D, lastOkMaterial->textureIDs[OBJMaterial::TextureTypes::DiffuseTexture]);
-
-				//Get the location of the diffuse texture.
-				texUniformLoc = glGetUniformLocation(m_objProgram, "SpecularTexture");
-				glUniform1i(texUniformLoc, 1); //Set diffuse texture to be GL_Texture1.
-
-				glActiveTexture(GL_TEXTURE1); //Set the active texture unity to texture1.
-				//Bind the texture for diffuse for this material to the texture0.
-				glBindTexture(GL_TEXTURE_2D, lastOkMaterial->textureIDs[OBJMaterial::TextureTypes::SpecularTexture]);
-
-				//Get the location of the diffuse texture.
-				texUniformLoc = glGetUniformLocation(m_objProgram, "NormalTexture");
-				glUniform1i(texUniformLoc, 2); //Set diffuse texture to be GL_Texture2.
-
-				glActiveTexture(GL_TEXTURE2); //Set the active texture unit to texture2.
-				//Bind the texture for diffuse for this material to the texture0.
-				glBindTexture(GL_TEXTURE_2D, lastOkMaterial->textureIDs[OBJMaterial::TextureTypes::NormalTexture]);
+				const OBJMeshlet& meshlet = pMesh->m_meshlets[m];
+				if (!m_meshletDrawCounts.empty() && meshlet.indexStart == drawEnd && meshlet.baseVertex == (unsigned int)m_meshletDrawBaseVertices.back())
+				{
+					m_meshletDrawCounts.back() += meshlet.triangleCount * 3;
+				}
+				else
+				{
+					m_meshletDrawCounts.push_back(meshlet.triangleCount * 3);
+					m_meshletDrawOffsets.push_back(((char*)0) + meshlet.indexStart * indexSize);
+					m_meshletDrawBaseVertices.push_back(meshlet.baseVertex);
+				}
+				drawEnd = meshlet.indexStart + meshlet.triangleCount * 3;
 			}
-			else //If there's been no texture data to apply at all apply default material to the mesh.
+			if (!m_meshletDrawCounts.empty())
 			{
-				//Tell the shader there is not an ok material.
-				glUniform1i(okTexLoc, 0);
-
-				//Send the OBJ Model's world matrix data across to the shader program.
-				glUniform4fv(kA_location, 1, glm::value_ptr(m_defaultMaterialColour));
-				glUniform4fv(kD_location, 1, glm::value_ptr(glm::vec4(m_defaultMaterialColour.x * 4, m_defaultMaterialColour.y * 4, m_defaultMaterialColour.z * 4, 1.0f)));
-				glUniform4fv(kS_location, 1, glm::value_ptr(glm::vec4(1.0f, 1.0f, 1.0f, 64.0f)));
+				glMultiDrawElementsBaseVertex(GL_TRIANGLES, m_meshletDrawCounts.data(), gpuMesh.indexType,
+					m_meshletDrawOffsets.data(), (GLsizei)m_meshletDrawCounts.size(), m_meshletDrawBaseVertices.data());
+			}
+		}
+		else if (pMesh->HasShortIndices())
+		{
+			//16 bit indices, drawn one range at a time as each range's indices are relative to its base vertex.
+			for (const OBJIndexRange& range : pMesh->m_indexRanges)
+			{
+				glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_SHORT, ((char*)0) + range.indexStart * sizeof(uint16_t), range.baseVertex);
 			}
+		}
+		else
+		{
+			glDrawElements(GL_TRIANGLES, pMesh->m_indices.size(), GL_UNSIGNED_INT, 0);
+		}
+	}
+	glBindVertexArray(0);
+}
 
+void _3DRenderingFramework::RenderOBJModelIndirect(OBJModel* a_model, glm::mat4 a_projectionViewMatrix)
+{
+	//Everything that differs between meshes comes from the arena's storage buffers, so only per frame uniforms are set.
+	m_objIndirectProgram.Use();
+	m_objIndirectProgram.SetUniform("lightStrength", m_lightStrength);
+	m_objIndirectProgram.SetUniform("ProjectionViewMatrix", a_projectionViewMatrix);
+	m_objIndirectProgram.SetUniform("ModelMatrix", a_model->GetWorldMatrix());
+	m_objIndirectProgram.SetUniform("camPos", m_cameraMatrix[3]);
+	m_objIndirectProgram.SetUniform("OctahedralNormals", a_model->GetMeshCount() > 0 && a_model->GetMeshByIndex(0)->GetVertexLayout() == OBJMesh::LAYOUT_QUANTIZED ? 1 : 0);
+	m_objIndirectProgram.SetUniform("DiffuseTexture", 0);
+	m_objIndirectProgram.SetUniform("SpecularTexture", 1);
+	m_objIndirectProgram.SetUniform("NormalTexture", 2);
+	//Value read when the arena has no tangent stream.
+	glVertexAttrib4f(3, 0.0f, 0.0f, 0.0f, 0.0f);
+	//Meshes with no material to fall back on use the default colour from the imgui window.
+	m_geometryArena.SetDefaultMaterial(m_defaultMaterialColour, glm::vec4(m_defaultMaterialColour.x * 4, m_defaultMaterialColour.y * 4, m_defaultMaterialColour.z * 4, 1.0f), glm::vec4(1.0f, 1.0f, 1.0f, 64.0f));
+
+	//Cull whole meshes and pick their level of detail on the CPU, the survivors become one command each.
+	glm::mat4 worldMatrix = a_model->GetWorldMatrix();
+	glm::vec3 modelCameraPosition = glm::vec3(glm::inverse(worldMatrix) * m_cameraMatrix[3]);
+	float pixelsPerUnit = m_projectionMatrix[1][1] * m_windowHeight * 0.5f;
+	m_geometryArena.BeginFrame();
+	m_geometryArena.RecordDraws(a_model, a_projectionViewMatrix * worldMatrix, modelCameraPosition, pixelsPerUnit, m_lodPixelError);
+
+	//Textures can only change between draw calls, so there is one call per texture set.
+	m_geometryArena.BeginSubmit();
+	const std::vector<GPUDrawBatch>& batches = m_geometryArena.GetBatches();
+	for (unsigned int b = 0; b < batches.size(); b++)
+	{
+		if (batches[b].material != nullptr)
+		{
+			for (unsigned int t = 0; t < OBJMaterial::TextureTypes::TextureTypes_Count; t++)
+			{
+				GLStateCache::BindTexture(t, GL_TEXTURE_2D, batches[b].material->textureIDs[t]);
+			}
 		}
-		glBindBuffer(GL_ARRAY_BUFFER, m_objModelBuffer[0]);
-		glBufferData(GL_ARRAY_BUFFER, pMesh->m_vertices.size() * sizeof(OBJVertex), pMesh->m_vertices.data(), GL_STATIC_DRAW);
-
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_objModelBuffer[1]);
-		glEnableVertexAttribArray(0); //Position.
-		glEnableVertexAttribArray(1); //Normal.
-		glEnableVertexAttribArray(2); //UV coord.
-
-		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(OBJVertex), ((char*)0) + OBJVertex::PositionOffset);
-		glVertexAttribPointer(1, 4, GL_FLOAT, GL_TRUE, sizeof(OBJVertex), ((char*)0) + OBJVertex::NormalOffset);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_TRUE, sizeof(OBJVertex), ((char*)0) + OBJVertex::UVCoordOffset);
-
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, pMesh->m_indices.size() * sizeof(unsigned int), pMesh->m_indices.data(), GL_STATIC_DRAW);
-		glDrawElements(GL_TRIANGLES, pMesh->m_indices.size(), GL_UNSIGNED_INT, 0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		m_geometryArena.SubmitBatch(b);
+	}
+	m_geometryArena.EndSubmit();
+}
+
+bool _3DRenderingFramework::PickOBJModel(glm::vec2 a_windowPosition, OBJRayHit& a_hit)
+{
+	const OBJBvh* bvh = m_objModel->GetBvh();
+	ImGuiIO& io = ImGui::GetIO();
+	if (bvh == nullptr || io.DisplaySize.x <= 0.0f || io.DisplaySize.y <= 0.0f)
+	{
+		return false;
 	}
+	//Take the cursor to normalised device coordinates and back through the camera onto the near and far planes,
+	//the hierarchy is in model space so the ray is too.
+	glm::vec2 ndc = glm::vec2(a_windowPosition.x / io.DisplaySize.x * 2.0f - 1.0f, 1.0f - a_windowPosition.y / io.DisplaySize.y * 2.0f);
+	glm::mat4 modelFromClip = glm::inverse(m_projectionMatrix * glm::inverse(m_cameraMatrix) * m_objModel->GetWorldMatrix());
+	glm::vec4 nearPoint = modelFromClip * glm::vec4(ndc, -1.0f, 1.0f);
+	glm::vec4 farPoint = modelFromClip * glm::vec4(ndc, 1.0f, 1.0f);
+	glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+	glm::vec3 direction = glm::vec3(farPoint) / farPoint.w - origin;
+	return bvh->Intersect(origin, direction, a_hit, 1.0f);
 }
 
 void _3DRenderingFramework::RenderGridLines(glm::mat4 a_projectionViewMatrix)
 {
 	//Enable grid line shaders.
-	glUseProgram(m_uiProgram);
+	m_uiProgram.Use();
 
 	//Send the projection matrix to the vertex shader.
-	//Ask the shader program for the location of the projection-view-matrix uniform variable.
-	int projectionViewUniformLocation = glGetUniformLocation(m_uiProgram, "ProjectionViewMatrix");
-
-	//Send this location a pointer to our glm::mat4 (send across float data).
-	glUniformMatrix4fv(projectionViewUniformLocation, 1, false, glm::value_ptr(a_projectionViewMatrix));
-
-	glBindBuffer(GL_ARRAY_BUFFER, m_lineVBO);
-	glBufferData(GL_ARRAY_BUFFER, 42 * sizeof(Line), m_lines, GL_STATIC_DRAW);
-
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-
-	//Specify where our vertex array is, how many components each vertex has,
-	//The data type of each component and whether the data is normalised or not.
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), ((char*)0) + 16);
+	m_uiProgram.SetUniform("ProjectionViewMatrix", a_projectionViewMatrix);
 
+	//The grid never changes, its buffer and layout were set up once in SetUpGridLines.
+	glBindVertexArray(m_lineVAO);
 	glDrawArrays(GL_LINES, 0, 42 * 2);
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-	glUseProgram(0);
+	glBindVertexArray(0);
 }
 
 bool _3DRenderingFramework::LoadObjModelData(std::string a_sFilename, float a_fModelScale)
@@ -309,10 +389,19 @@ bool _3DRenderingFramework::LoadObjModelData(std::string a_sFilename, float a_fM
 
 	filename = CheckFilenameForOBJPrefix(filename); //Add obj prefix to filename if required.
 
-	//Create a new obj model and load it.
+	//Create a new obj model and start loading it, the window keeps rendering while it loads.
 	m_objModel = new OBJModel(filename, filePath.c_str());
+	m_objModelName = a_sFilename;
 	filePath = filePath + filename;
-	if (m_objModel->Load(filePath.c_str(), a_fModelScale))
+	m_objModelLoad = m_objModel->LoadAsync(filePath.c_str(), a_fModelScale, OBJModel::LOAD_MEMORY_MAPPED | OBJModel::LOAD_PARALLEL | OBJModel::LOAD_WELD_VERTICES | OBJModel::LOAD_USE_CACHE | OBJModel::LOAD_QUANTIZE_VERTICES |
+		OBJModel::LOAD_SHORT_INDICES | OBJModel::LOAD_SPLIT_LARGE_MESHES | OBJModel::LOAD_OPTIMIZE_OVERDRAW | OBJModel::LOAD_OPTIMIZE_VERTEX_FETCH |
+		OBJModel::LOAD_BUILD_MESHLETS | OBJModel::LOAD_BUILD_LODS | OBJModel::LOAD_GENERATE_TANGENTS | OBJModel::LOAD_BUILD_BVH | OBJModel::LOAD_HUGE_PAGES);
+	return true;
+}
+
+void _3DRenderingFramework::FinishObjModelLoad()
+{
+	if (m_objModelLoad.GetResult())
 	{
 		TextureManager* pTM = TextureManager::GetInstance();
 		//Load in texture for model if any are present.
@@ -332,24 +421,67 @@ bool _3DRenderingFramework::LoadObjModelData(std::string a_sFilename, float a_fM
 		//Create obj shader program.
 		unsigned int obj_vertexShader = ShaderUtil::LoadShader("resource/shaders/obj_vertex.glsl", GL_VERTEX_SHADER);
 		unsigned int obj_fragmentShader = ShaderUtil::LoadShader("resource/shaders/obj_fragment.glsl", GL_FRAGMENT_SHADER);
-		m_objProgram = ShaderUtil::CreateProgram(obj_vertexShader, obj_fragmentShader);
-		//Set up vertex and index buffer for obj rendering.
-		glGenBuffers(2, m_objModelBuffer);
-		//Set up vertex buffer data.
-		glBindBuffer(GL_ARRAY_BUFFER, m_objModelBuffer[0]);
-
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		m_objProgram.Create(obj_vertexShader, obj_fragmentShader);
+		m_objProgram.SetUniformBlockBinding("Materials", GPUMaterialBuffer::BLOCK_BINDING);
+		//Multi-draw indirect rendering reads gl_BaseInstance, which needs GL 4.6. It is the default where available,
+		//the meshes are uploaded by whichever way of drawing is used first.
+		if (GLAD_GL_VERSION_4_6)
+		{
+			unsigned int obj_indirectVertexShader = ShaderUtil::LoadShader("resource/shaders/obj_vertex_indirect.glsl", GL_VERTEX_SHADER);
+			m_objIndirectProgram.Create(obj_indirectVertexShader, obj_fragmentShader);
+			glDeleteShader(obj_indirectVertexShader);
+		}
+		m_useIndirectDraw = m_objIndirectProgram.IsValid();
 		glDeleteShader(obj_vertexShader);
 		glDeleteShader(obj_fragmentShader);
+		m_objModelReady = true;
 	}
 	else
 	{
-		std::cout << "\nFailed to load model: " << a_sFilename << std::endl;
+		std::cout << "\nFailed to load model: " << m_objModelName << std::endl;
 		std::cout << "Check that the filename was entered correctly." << std::endl;
-		return false;
 	}
 }
 
+void _3DRenderingFramework::ShowModelLoadProgress()
+{
+	const OBJLoadProgress* progress = m_objModelLoad.GetProgress();
+	uint64_t bytesTotal = progress->bytesTotal;
+	float fraction = (bytesTotal > 0) ? (float)progress->bytesProcessed / (float)bytesTotal : 0.0f;
+	//Once the file is read the bar follows the post-processing passes over the meshes instead.
+	bool postProcessing = progress->phase == OBJLoadProgress::PHASE_POSTPROCESSING;
+	uint64_t stepsTotal = progress->stepsTotal;
+	if (postProcessing)
+	{
+		fraction = (stepsTotal > 0) ? (float)progress->stepsProcessed / (float)stepsTotal : 0.0f;
+	}
+
+	//Set up an imgui window in the middle of the screen showing the load progress.
+	ImGuiIO& io = ImGui::GetIO();
+	ImVec2 window_size = ImVec2(400.0f, 110.0f);
+	ImVec2 window_pos = ImVec2((io.DisplaySize.x - window_size.x) * 0.5f, (io.DisplaySize.y - window_size.y) * 0.5f);
+	ImGui::SetNextWindowPos(window_pos, ImGuiCond_Always);
+	ImGui::SetNextWindowSize(window_size, ImGuiCond_Always);
+	if (ImGui::Begin("Loading Model", nullptr, ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoCollapse))
+	{
+		ImGui::Text("%s: %s", OBJLoadProgress::GetPhaseName(progress->phase), m_objModelName.c_str());
+		ImGui::ProgressBar(fraction, ImVec2(-1.0f, 0.0f));
+		if (postProcessing)
+		{
+			ImGui::Text("%llu / %llu mesh passes, %llu faces", (unsigned long long)progress->stepsProcessed, (unsigned long long)stepsTotal, (unsigned long long)progress->facesParsed);
+		}
+		else
+		{
+			ImGui::Text("%.1f / %.1f MB, %llu faces", progress->bytesProcessed / (1024.0f * 1024.0f), bytesTotal / (1024.0f * 1024.0f), (unsigned long long)progress->facesParsed);
+		}
+		if (ImGui::Button("Cancel"))
+		{
+			m_objModelLoad.Cancel();
+		}
+	}
+	ImGui::End();
+}
+
 std::string _3DRenderingFramework::CheckFilenameForOBJPrefix(std::string a_sFilename)
 {
 	//Initialise return variables.
@@ -423,12 +555,7 @@ std::vector<std::string> _3DRenderingFramework::CheckFileNameForSubFolder(std::s
 void _3DRenderingFramework::SetUpGridLines()
 {
 	//Create shader program.
-	unsigned int vertexShader = ShaderUtil::LoadShader("resource/shaders/vertex.glsl", GL_VERTEX_SHADER);
-	unsigned int fragmentShader = ShaderUtil::LoadShader("resource/shaders/fragment.glsl", GL_FRAGMENT_SHADER);
-	m_uiProgram = ShaderUtil::CreateProgram(vertexShader, fragmentShader);
-
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+	m_uiProgram.Create("resource/shaders/vertex.glsl", "resource/shaders/fragment.glsl");
 
 	//Create a grid of lines to be drawn during our update.
 	//Create a 10x10 square grid.
@@ -446,7 +573,9 @@ void _3DRenderingFramework::SetUpGridLines()
 		m_lines[j + 1].v1.position = glm::vec4(-10.0f, 0.0f, -10.0f + i, 1.0f);
 		m_lines[j + 1].v1.colour = (i == 10) ? glm::vec4(1.0f, 1.0f, 1.0f, 1.0f) : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
 	}
-	//Create a vertex buffer to hold our line data.
+	//Create a vertex array to remember the layout and a vertex buffer to hold our line data.
+	glGenVertexArrays(1, &m_lineVAO);
+	glBindVertexArray(m_lineVAO);
 	glGenBuffers(1, &m_lineVBO);
 	glBindBuffer(GL_ARRAY_BUFFER, m_lineVBO);
 	//Fill vertex buffer with line data.
@@ -462,6 +591,7 @@ void _3DRenderingFramework::SetUpGridLines()
 	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
 	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), ((char*)0) + 16);
 
+	glBindVertexArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
@@ -496,11 +626,23 @@ void _3DRenderingFramework::HandleWindowResize(WindowResizeEvent* e)
 
 void _3DRenderingFramework::Destroy()
 {
+	//Stop a load that is still running before the model it is filling is deleted.
+	if (m_objModelLoad.IsValid())
+	{
+		m_objModelLoad.Cancel();
+		m_objModelLoad.GetResult();
+	}
+	m_objMeshCache.Clear();
+	m_objMaterialBuffer.Clear();
+	m_geometryArena.Destroy();
+	m_objDrawList.Clear();
 	delete m_objModel;
 	delete[] m_lines;
 	glDeleteBuffers(1, &m_lineVBO);
-	ShaderUtil::DeleteProgram(m_uiProgram);
-	ShaderUtil::DeleteProgram(m_objProgram);
+	glDeleteVertexArrays(1, &m_lineVAO);
+	m_uiProgram.Destroy();
+	m_objProgram.Destroy();
+	m_objIndirectProgram.Destroy();
 	TextureManager::DestroyInstance();
 	ShaderUtil::DestroyInstance();
 }
\ No newline at end of file
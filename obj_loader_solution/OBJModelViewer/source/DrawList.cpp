@@ -0,0 +1,158 @@
+#include "DrawList.h"
+#include "obj_loader.h"
+#include <algorithm>
+#include <unordered_map>
+
+static const unsigned int s_depthShift = 0;
+static const unsigned int s_materialShift = s_depthShift + DrawList::DEPTH_BITS;
+static const unsigned int s_textureSetShift = s_materialShift + DrawList::MATERIAL_BITS;
+static const unsigned int s_programShift = s_textureSetShift + DrawList::TEXTURE_SET_BITS;
+
+//Largest value a field of a_bits bits holds, ids past it share the last value and are only sorted less well.
+static uint64_t ClampToBits(uint64_t a_value, unsigned int a_bits)
+{
+	return std::min(a_value, ((uint64_t)1 << a_bits) - 1);
+}
+
+DrawList::DrawList() : m_model(nullptr), m_meshKeys(), m_meshMaterials(), m_meshMaterialIds(), m_meshDepths(), m_items(), m_scratch()
+{
+
+}
+
+void DrawList::Clear()
+{
+	m_model = nullptr;
+	m_meshKeys.clear();
+	m_meshMaterials.clear();
+	m_meshMaterialIds.clear();
+	m_items.clear();
+}
+
+void DrawList::SetModel(OBJModel* a_model)
+{
+	m_model = a_model;
+	m_meshKeys.resize(a_model->GetMeshCount());
+	m_meshMaterials.resize(a_model->GetMeshCount());
+	m_meshMaterialIds.resize(a_model->GetMeshCount());
+	//Material ids follow the model's material order, 0 is the default material.
+	std::unordered_map<const OBJMaterial*, uint64_t> materialIds;
+	for (unsigned int i = 0; i < a_model->GetMaterialCount(); i++)
+	{
+		materialIds.emplace(a_model->GetMaterialByIndex(i), i + 1);
+	}
+	//Materials with the same three textures share a texture set id, 0 is no textures bound.
+	std::vector<const OBJMaterial*> textureSets;
+	const OBJMaterial* lastOkMaterial = nullptr;
+	for (unsigned int i = 0; i < a_model->GetMeshCount(); i++)
+	{
+		OBJMesh* pMesh = a_model->GetMeshByIndex(i);
+		//Meshes without a material use the last one seen, as they did when drawn in file order.
+		lastOkMaterial = (pMesh->m_material != nullptr) ? pMesh->m_material : lastOkMaterial;
+		m_meshMaterials[i] = lastOkMaterial;
+		uint64_t materialId = 0;
+		uint64_t textureSetId = 0;
+		if (lastOkMaterial != nullptr)
+		{
+			auto material = materialIds.find(lastOkMaterial);
+			materialId = (material != materialIds.end()) ? material->second : 0;
+			auto textureSet = std::find_if(textureSets.begin(), textureSets.end(), [lastOkMaterial](const OBJMaterial* a_material)
+			{
+				return std::equal(std::begin(a_material->textureIDs), std::end(a_material->textureIDs), std::begin(lastOkMaterial->textureIDs));
+			});
+			if (textureSet == textureSets.end())
+			{
+				textureSet = textureSets.insert(textureSets.end(), lastOkMaterial);
+			}
+			textureSetId = (textureSet - textureSets.begin()) + 1;
+		}
+		m_meshMaterialIds[i] = (unsigned int)materialId;
+		m_meshKeys[i] = (ClampToBits(textureSetId, TEXTURE_SET_BITS) << s_textureSetShift) | (ClampToBits(materialId, MATERIAL_BITS) << s_materialShift);
+	}
+}
+
+void DrawList::Build(OBJModel* a_model, unsigned int a_program, const glm::mat4& a_clipFromModel, const glm::vec3& a_modelCameraPosition)
+{
+	if (m_model != a_model || m_meshKeys.size() != a_model->GetMeshCount())
+	{
+		SetModel(a_model);
+	}
+	//Frustum planes in model space, taken from the rows of the clip matrix and normalised so sphere tests use real distances.
+	glm::vec4 planes[6];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		glm::vec4 row = glm::vec4(a_clipFromModel[0][axis], a_clipFromModel[1][axis], a_clipFromModel[2][axis], a_clipFromModel[3][axis]);
+		glm::vec4 w = glm::vec4(a_clipFromModel[0][3], a_clipFromModel[1][3], a_clipFromModel[2][3], a_clipFromModel[3][3]);
+		planes[axis * 2] = w + row;
+		planes[axis * 2 + 1] = w - row;
+	}
+	for (glm::vec4& plane : planes)
+	{
+		float length = glm::length(glm::vec3(plane));
+		plane = (length > 0.0f) ? plane / length : plane;
+	}
+
+	//Distance to the nearest point of each visible mesh's bounding sphere, scaled by the furthest into the depth bits.
+	m_items.clear();
+	m_meshDepths.clear();
+	float maxDepth = 0.0f;
+	for (unsigned int i = 0; i < a_model->GetMeshCount(); i++)
+	{
+		const OBJBounds& bounds = a_model->GetMeshByIndex(i)->GetBounds();
+		glm::vec3 center = bounds.GetCenter();
+		float radius = bounds.GetRadius();
+		bool visible = true;
+		for (const glm::vec4& plane : planes)
+		{
+			if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+			{
+				visible = false;
+				break;
+			}
+		}
+		if (visible)
+		{
+			float depth = std::max(0.0f, glm::length(center - a_modelCameraPosition) - radius);
+			maxDepth = std::max(maxDepth, depth);
+			m_items.push_back({ m_meshKeys[i], i, m_meshMaterials[i], m_meshMaterialIds[i] });
+			m_meshDepths.push_back(depth);
+		}
+	}
+	uint64_t programBits = ClampToBits(a_program, PROGRAM_BITS) << s_programShift;
+	float depthScale = (maxDepth > 0.0f) ? (float)((1u << DEPTH_BITS) - 1) / maxDepth : 0.0f;
+	for (unsigned int i = 0; i < m_items.size(); i++)
+	{
+		m_items[i].key |= programBits | (ClampToBits((uint64_t)(m_meshDepths[i] * depthScale), DEPTH_BITS) << s_depthShift);
+	}
+	RadixSort(m_items, m_scratch);
+}
+
+void DrawList::RadixSort(std::vector<DrawItem>& a_items, std::vector<DrawItem>& a_scratch)
+{
+	a_scratch.resize(a_items.size());
+	for (unsigned int shift = 0; shift < 64; shift += 8)
+	{
+		unsigned int counts[256] = {};
+		for (const DrawItem& item : a_items)
+		{
+			counts[(item.key >> shift) & 0xFF]++;
+		}
+		//Every key has the same byte here, the pass would not move anything.
+		if (a_items.empty() || counts[(a_items[0].key >> shift) & 0xFF] == a_items.size())
+		{
+			continue;
+		}
+		unsigned int offset = 0;
+		for (unsigned int& count : counts)
+		{
+			unsigned int bucketSize = count;
+			count = offset;
+			offset += bucketSize;
+		}
+		//Stable, so the order from the lower bytes is kept within each bucket.
+		for (const DrawItem& item : a_items)
+		{
+			a_scratch[counts[(item.key >> shift) & 0xFF]++] = item;
+		}
+		a_items.swap(a_scratch);
+	}
+}
@@ -0,0 +1,70 @@
+#include "GLStateCache.h"
+#include <glad/glad.h>
+
+//Texture units and targets tracked, binds outside them always reach GL.
+static const unsigned int s_textureUnitCount = 16;
+enum TrackedTarget
+{
+	TARGET_2D = 0,
+	TARGET_CUBE_MAP,
+	TrackedTarget_Count
+};
+//Never a valid object name, so the first call after Invalidate always binds.
+static const unsigned int s_unknown = 0xFFFFFFFFu;
+
+static unsigned int s_program = s_unknown;
+static unsigned int s_activeUnit = s_unknown;
+static unsigned int s_textures[s_textureUnitCount][TrackedTarget_Count] = {};
+static bool s_texturesKnown = false;
+
+void GLStateCache::UseProgram(unsigned int a_program)
+{
+	if (s_program != a_program)
+	{
+		glUseProgram(a_program);
+		s_program = a_program;
+	}
+}
+
+unsigned int GLStateCache::GetProgram()
+{
+	return s_program;
+}
+
+void GLStateCache::BindTexture(unsigned int a_unit, unsigned int a_target, unsigned int a_texture)
+{
+	int target = (a_target == GL_TEXTURE_2D) ? TARGET_2D : (a_target == GL_TEXTURE_CUBE_MAP) ? TARGET_CUBE_MAP : -1;
+	if (!s_texturesKnown)
+	{
+		for (unsigned int unit = 0; unit < s_textureUnitCount; unit++)
+		{
+			for (unsigned int t = 0; t < TrackedTarget_Count; t++)
+			{
+				s_textures[unit][t] = s_unknown;
+			}
+		}
+		s_texturesKnown = true;
+	}
+	bool tracked = target >= 0 && a_unit < s_textureUnitCount;
+	if (tracked && s_textures[a_unit][target] == a_texture)
+	{
+		return;
+	}
+	if (s_activeUnit != a_unit)
+	{
+		glActiveTexture(GL_TEXTURE0 + a_unit);
+		s_activeUnit = a_unit;
+	}
+	glBindTexture(a_target, a_texture);
+	if (tracked)
+	{
+		s_textures[a_unit][target] = a_texture;
+	}
+}
+
+void GLStateCache::Invalidate()
+{
+	s_program = s_unknown;
+	s_activeUnit = s_unknown;
+	s_texturesKnown = false;
+}
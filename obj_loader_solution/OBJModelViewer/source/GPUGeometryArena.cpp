@@ -0,0 +1,572 @@
+#include "GPUGeometryArena.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <unordered_map>
+
+//Binding points of the storage buffers, they match obj_vertex_indirect.glsl.
+static const unsigned int s_drawRecordBinding = 0;
+static const unsigned int s_materialBinding = 1;
+
+bool GPURangeAllocator::Allocate(size_t a_count, size_t& a_offset)
+{
+	for (auto it = m_freeRanges.begin(); it != m_freeRanges.end(); ++it)
+	{
+		if (it->second >= a_count)
+		{
+			a_offset = it->first;
+			size_t remaining = it->second - a_count;
+			m_freeRanges.erase(it);
+			if (remaining > 0)
+			{
+				m_freeRanges[a_offset + a_count] = remaining;
+			}
+			m_freeCount -= a_count;
+			return true;
+		}
+	}
+	return false;
+}
+
+void GPURangeAllocator::Free(size_t a_offset, size_t a_count)
+{
+	if (a_count == 0)
+	{
+		return;
+	}
+	m_freeCount += a_count;
+	auto next = m_freeRanges.lower_bound(a_offset);
+	//Merge with the free range that starts where this one ends.
+	if (next != m_freeRanges.end() && next->first == a_offset + a_count)
+	{
+		a_count += next->second;
+		next = m_freeRanges.erase(next);
+	}
+	//And with the one that ends where this one starts.
+	if (next != m_freeRanges.begin())
+	{
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == a_offset)
+		{
+			previous->second += a_count;
+			return;
+		}
+	}
+	m_freeRanges[a_offset] = a_count;
+}
+
+void GPURangeAllocator::Grow(size_t a_capacity)
+{
+	if (a_capacity > m_capacity)
+	{
+		size_t oldCapacity = m_capacity;
+		m_capacity = a_capacity;
+		Free(oldCapacity, a_capacity - oldCapacity);
+	}
+}
+
+void GPURangeAllocator::Reset()
+{
+	m_freeRanges.clear();
+	m_capacity = 0;
+	m_freeCount = 0;
+}
+
+GPUGeometryArena::GPUGeometryArena() : m_layout(OBJMesh::LAYOUT_INTERLEAVED), m_vao(0), m_vertexBuffers(), m_vertexStrides(), m_indexBuffer(0),
+	m_indirectBuffer(0), m_drawRecordBuffer(0), m_materialBuffer(0), m_vertexAllocator(), m_indexAllocator(), m_models(),
+	m_drawRecords(), m_materialRecords(), m_commands(), m_batches()
+{
+	//Entry 0 is the default material until SetDefaultMaterial is called.
+	GPUMaterialRecord defaultMaterial = GPUMaterialRecord();
+	defaultMaterial.kA = glm::vec4(0.25f, 0.25f, 0.25f, 1.0f);
+	defaultMaterial.kD = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+	defaultMaterial.kS = glm::vec4(1.0f, 1.0f, 1.0f, 64.0f);
+	m_materialRecords.push_back(defaultMaterial);
+}
+
+GPUGeometryArena::~GPUGeometryArena()
+{
+	Destroy();
+}
+
+void GPUGeometryArena::Create(OBJMesh::VertexLayout a_layout, bool a_withTangents)
+{
+	Destroy();
+	m_layout = a_layout;
+	//Vertex streams are sized in vertices, so each buffer only needs its stride.
+	if (a_layout == OBJMesh::LAYOUT_QUANTIZED)
+	{
+		m_vertexStrides[0] = sizeof(OBJQuantizedVertex);
+	}
+	else if (a_layout == OBJMesh::LAYOUT_STREAMS)
+	{
+		m_vertexStrides[0] = sizeof(glm::vec3);
+		m_vertexStrides[1] = sizeof(glm::vec3);
+		m_vertexStrides[2] = sizeof(glm::vec2);
+	}
+	else
+	{
+		m_vertexStrides[0] = sizeof(OBJVertex);
+	}
+	m_vertexStrides[3] = a_withTangents ? sizeof(glm::vec4) : 0;
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		if (m_vertexStrides[i] > 0)
+		{
+			glGenBuffers(1, &m_vertexBuffers[i]);
+		}
+	}
+	glGenBuffers(1, &m_indexBuffer);
+	glGenBuffers(1, &m_indirectBuffer);
+	glGenBuffers(1, &m_drawRecordBuffer);
+	glGenBuffers(1, &m_materialBuffer);
+	glGenVertexArrays(1, &m_vao);
+	SetUpVertexArray();
+	UpdateRecords();
+}
+
+void GPUGeometryArena::Destroy()
+{
+	if (m_vao == 0)
+	{
+		return;
+	}
+	glDeleteVertexArrays(1, &m_vao);
+	for (unsigned int& buffer : m_vertexBuffers)
+	{
+		if (buffer != 0)
+		{
+			glDeleteBuffers(1, &buffer);
+		}
+		buffer = 0;
+	}
+	glDeleteBuffers(1, &m_indexBuffer);
+	glDeleteBuffers(1, &m_indirectBuffer);
+	glDeleteBuffers(1, &m_drawRecordBuffer);
+	glDeleteBuffers(1, &m_materialBuffer);
+	m_vao = 0;
+	m_indexBuffer = m_indirectBuffer = m_drawRecordBuffer = m_materialBuffer = 0;
+	for (size_t& stride : m_vertexStrides)
+	{
+		stride = 0;
+	}
+	m_vertexAllocator.Reset();
+	m_indexAllocator.Reset();
+	m_models.clear();
+	m_drawRecords.clear();
+	m_materialRecords.resize(1);
+	m_commands.clear();
+	m_batches.clear();
+}
+
+//Make a copy of a_buffer a_newSize bytes long, holding its first a_oldSize bytes.
+static void ResizeBuffer(unsigned int& a_buffer, size_t a_oldSize, size_t a_newSize)
+{
+	unsigned int buffer = 0;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, a_newSize, nullptr, GL_STATIC_DRAW);
+	if (a_oldSize > 0)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, a_buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, a_oldSize);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glDeleteBuffers(1, &a_buffer);
+	a_buffer = buffer;
+}
+
+void GPUGeometryArena::GrowVertices(size_t a_capacity)
+{
+	size_t oldCapacity = m_vertexAllocator.GetCapacity();
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		if (m_vertexBuffers[i] != 0)
+		{
+			ResizeBuffer(m_vertexBuffers[i], oldCapacity * m_vertexStrides[i], a_capacity * m_vertexStrides[i]);
+		}
+	}
+	m_vertexAllocator.Grow(a_capacity);
+	SetUpVertexArray();
+}
+
+void GPUGeometryArena::GrowIndices(size_t a_capacity)
+{
+	ResizeBuffer(m_indexBuffer, m_indexAllocator.GetCapacity() * sizeof(unsigned int), a_capacity * sizeof(unsigned int));
+	m_indexAllocator.Grow(a_capacity);
+	SetUpVertexArray();
+}
+
+void GPUGeometryArena::SetUpVertexArray()
+{
+	glBindVertexArray(m_vao);
+	glEnableVertexAttribArray(0); //Position.
+	glEnableVertexAttribArray(1); //Normal.
+	glEnableVertexAttribArray(2); //UV coord.
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffers[0]);
+	if (m_layout == OBJMesh::LAYOUT_QUANTIZED)
+	{
+		glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(OBJQuantizedVertex), ((char*)0) + OBJQuantizedVertex::PositionOffset);
+		glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(OBJQuantizedVertex), ((char*)0) + OBJQuantizedVertex::NormalOffset);
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(OBJQuantizedVertex), ((char*)0) + OBJQuantizedVertex::UVCoordOffset);
+	}
+	else if (m_layout == OBJMesh::LAYOUT_STREAMS)
+	{
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), 0);
+		glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffers[1]);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_TRUE, sizeof(glm::vec3), 0);
+		glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffers[2]);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_TRUE, sizeof(glm::vec2), 0);
+	}
+	else
+	{
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(OBJVertex), ((char*)0) + OBJVertex::PositionOffset);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_TRUE, sizeof(OBJVertex), ((char*)0) + OBJVertex::NormalOffset);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_TRUE, sizeof(OBJVertex), ((char*)0) + OBJVertex::UVCoordOffset);
+	}
+	if (m_vertexBuffers[3] != 0)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffers[3]);
+		glEnableVertexAttribArray(3); //Tangent and bitangent sign.
+		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), 0);
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+//Number of vertices in a mesh's current layout.
+static size_t GetVertexCount(const OBJMesh* a_mesh)
+{
+	switch (a_mesh->GetVertexLayout())
+	{
+	case OBJMesh::LAYOUT_QUANTIZED: return a_mesh->m_quantizedVertices.size();
+	case OBJMesh::LAYOUT_STREAMS: return a_mesh->m_positions.size();
+	default: return a_mesh->m_vertices.size();
+	}
+}
+
+bool GPUGeometryArena::AddModel(OBJModel* a_model)
+{
+	if (m_vao == 0 || HasModel(a_model))
+	{
+		return false;
+	}
+	//Check everything fits before touching the buffers so a mismatch adds nothing.
+	size_t vertexTotal = 0;
+	size_t indexTotal = 0;
+	for (unsigned int i = 0; i < a_model->GetMeshCount(); i++)
+	{
+		OBJMesh* pMesh = a_model->GetMeshByIndex(i);
+		if (pMesh->GetVertexLayout() != m_layout)
+		{
+			return false;
+		}
+		vertexTotal += GetVertexCount(pMesh);
+		indexTotal += pMesh->GetIndexCount() + pMesh->m_lodIndices.size();
+	}
+	//Grow once up front for the whole model, fragmented free space is caught per mesh below.
+	if (m_vertexAllocator.GetFreeCount() < vertexTotal)
+	{
+		GrowVertices(m_vertexAllocator.GetCapacity() + vertexTotal - m_vertexAllocator.GetFreeCount());
+	}
+	if (m_indexAllocator.GetFreeCount() < indexTotal)
+	{
+		GrowIndices(m_indexAllocator.GetCapacity() + indexTotal - m_indexAllocator.GetFreeCount());
+	}
+
+	ArenaModel model;
+	model.model = a_model;
+	model.meshes.resize(a_model->GetMeshCount());
+	std::vector<unsigned int> indices;
+	const OBJMaterial* lastOkMaterial = nullptr;
+	for (unsigned int i = 0; i < a_model->GetMeshCount(); i++)
+	{
+		OBJMesh* pMesh = a_model->GetMeshByIndex(i);
+		ArenaMesh& mesh = model.meshes[i];
+		mesh = ArenaMesh();
+		mesh.mesh = pMesh;
+		//Meshes without a material borrow the last one seen, as the per mesh renderer does.
+		lastOkMaterial = (pMesh->m_material != nullptr) ? pMesh->m_material : lastOkMaterial;
+		mesh.material = lastOkMaterial;
+		mesh.vertexCount = GetVertexCount(pMesh);
+		mesh.indexCount = pMesh->GetIndexCount();
+		mesh.lodIndexCount = pMesh->m_lodIndices.size();
+		while (!m_vertexAllocator.Allocate(mesh.vertexCount, mesh.vertexOffset))
+		{
+			GrowVertices(std::max(m_vertexAllocator.GetCapacity() * 2, m_vertexAllocator.GetCapacity() + mesh.vertexCount));
+		}
+		size_t indexAllocation = mesh.indexCount + mesh.lodIndexCount;
+		while (!m_indexAllocator.Allocate(indexAllocation, mesh.indexOffset))
+		{
+			GrowIndices(std::max(m_indexAllocator.GetCapacity() * 2, m_indexAllocator.GetCapacity() + indexAllocation));
+		}
+
+		//Copy the vertex streams in.
+		const void* streams[3] = { nullptr, nullptr, nullptr };
+		if (m_layout == OBJMesh::LAYOUT_QUANTIZED)
+		{
+			streams[0] = pMesh->m_quantizedVertices.data();
+		}
+		else if (m_layout == OBJMesh::LAYOUT_STREAMS)
+		{
+			streams[0] = pMesh->m_positions.data();
+			streams[1] = pMesh->m_normals.data();
+			streams[2] = pMesh->m_uvcoords.data();
+		}
+		else
+		{
+			streams[0] = pMesh->m_vertices.data();
+		}
+		for (unsigned int s = 0; s < 3; s++)
+		{
+			if (streams[s] != nullptr && mesh.vertexCount > 0)
+			{
+				glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffers[s]);
+				glBufferSubData(GL_ARRAY_BUFFER, mesh.vertexOffset * m_vertexStrides[s], mesh.vertexCount * m_vertexStrides[s], streams[s]);
+			}
+		}
+		if (m_vertexBuffers[3] != 0 && mesh.vertexCount > 0)
+		{
+			//Meshes without tangents read zeros, the shader ignores them anyway.
+			glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffers[3]);
+			if (pMesh->HasTangents())
+			{
+				glBufferSubData(GL_ARRAY_BUFFER, mesh.vertexOffset * sizeof(glm::vec4), mesh.vertexCount * sizeof(glm::vec4), pMesh->m_tangents.data());
+			}
+			else
+			{
+				glClearBufferSubData(GL_ARRAY_BUFFER, GL_RGBA32F, mesh.vertexOffset * sizeof(glm::vec4), mesh.vertexCount * sizeof(glm::vec4), GL_RGBA, GL_FLOAT, nullptr);
+			}
+		}
+
+		//Indices are all 32 bit so every command can share one index type. 16 bit indices keep their values, the base
+		//vertex of their range is added by the draw command instead.
+		indices.clear();
+		if (pMesh->HasShortIndices())
+		{
+			indices.assign(pMesh->m_shortIndices.begin(), pMesh->m_shortIndices.end());
+		}
+		else
+		{
+			indices.assign(pMesh->m_indices.begin(), pMesh->m_indices.end());
+		}
+		indices.insert(indices.end(), pMesh->m_lodIndices.begin(), pMesh->m_lodIndices.end());
+		if (!indices.empty())
+		{
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, mesh.indexOffset * sizeof(unsigned int), indices.size() * sizeof(unsigned int), indices.data());
+		}
+
+		//Group the mesh with the others drawn with the same textures.
+		const OBJMaterial* material = mesh.material;
+		auto batch = std::find_if(model.batches.begin(), model.batches.end(), [material](const ArenaBatch& a_batch)
+		{
+			if (a_batch.material == nullptr || material == nullptr)
+			{
+				return a_batch.material == material;
+			}
+			return std::equal(std::begin(a_batch.material->textureIDs), std::end(a_batch.material->textureIDs), std::begin(material->textureIDs));
+		});
+		if (batch == model.batches.end())
+		{
+			model.batches.push_back({ material, {} });
+			batch = model.batches.end() - 1;
+		}
+		batch->meshes.push_back(i);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	m_models.push_back(std::move(model));
+	UpdateRecords();
+	return true;
+}
+
+void GPUGeometryArena::RemoveModel(const OBJModel* a_model)
+{
+	auto model = std::find_if(m_models.begin(), m_models.end(), [a_model](const ArenaModel& a_arenaModel) { return a_arenaModel.model == a_model; });
+	if (model == m_models.end())
+	{
+		return;
+	}
+	for (const ArenaMesh& mesh : model->meshes)
+	{
+		m_vertexAllocator.Free(mesh.vertexOffset, mesh.vertexCount);
+		m_indexAllocator.Free(mesh.indexOffset, mesh.indexCount + mesh.lodIndexCount);
+	}
+	m_models.erase(model);
+	UpdateRecords();
+}
+
+bool GPUGeometryArena::HasModel(const OBJModel* a_model) const
+{
+	return std::any_of(m_models.begin(), m_models.end(), [a_model](const ArenaModel& a_arenaModel) { return a_arenaModel.model == a_model; });
+}
+
+void GPUGeometryArena::SetDefaultMaterial(const glm::vec4& a_kA, const glm::vec4& a_kD, const glm::vec4& a_kS)
+{
+	GPUMaterialRecord& defaultMaterial = m_materialRecords[0];
+	if (defaultMaterial.kA == a_kA && defaultMaterial.kD == a_kD && defaultMaterial.kS == a_kS)
+	{
+		return;
+	}
+	defaultMaterial.kA = a_kA;
+	defaultMaterial.kD = a_kD;
+	defaultMaterial.kS = a_kS;
+	if (m_materialBuffer != 0)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_materialBuffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GPUMaterialRecord), &defaultMaterial);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+}
+
+void GPUGeometryArena::UpdateRecords()
+{
+	m_drawRecords.clear();
+	m_materialRecords.resize(1);
+	std::unordered_map<const OBJMaterial*, int> materialIndices;
+	for (ArenaModel& model : m_models)
+	{
+		for (ArenaMesh& mesh : model.meshes)
+		{
+			GPUDrawRecord record = GPUDrawRecord();
+			record.positionScale = glm::vec4(mesh.mesh->m_positionScale, 0.0f);
+			record.positionOffset = glm::vec4(mesh.mesh->m_positionOffset, 0.0f);
+			record.hasTangents = (mesh.mesh->HasTangents() && m_vertexBuffers[3] != 0) ? 1 : 0;
+			record.materialIndex = 0;
+			if (mesh.material != nullptr)
+			{
+				auto found = materialIndices.emplace(mesh.material, (int)m_materialRecords.size());
+				if (found.second)
+				{
+					GPUMaterialRecord material = GPUMaterialRecord();
+					material.kA = mesh.material->kA;
+					material.kD = mesh.material->kD;
+					material.kS = mesh.material->kS;
+					material.textureUsed = 1;
+					m_materialRecords.push_back(material);
+				}
+				record.materialIndex = found.first->second;
+			}
+			mesh.drawRecord = (unsigned int)m_drawRecords.size();
+			m_drawRecords.push_back(record);
+		}
+	}
+	//Storage buffers can not be empty, keep at least one record in each.
+	if (m_drawRecords.empty())
+	{
+		m_drawRecords.push_back(GPUDrawRecord());
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_drawRecordBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_drawRecords.size() * sizeof(GPUDrawRecord), m_drawRecords.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_materialBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_materialRecords.size() * sizeof(GPUMaterialRecord), m_materialRecords.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void GPUGeometryArena::BeginFrame()
+{
+	m_commands.clear();
+	m_batches.clear();
+}
+
+void GPUGeometryArena::RecordDraws(const OBJModel* a_model, const glm::mat4& a_clipFromModel, const glm::vec3& a_modelCameraPosition, float a_pixelsPerUnit, float a_maxPixelError)
+{
+	auto model = std::find_if(m_models.begin(), m_models.end(), [a_model](const ArenaModel& a_arenaModel) { return a_arenaModel.model == a_model; });
+	if (model == m_models.end())
+	{
+		return;
+	}
+	//Frustum planes in model space, taken from the rows of the clip matrix and normalised so sphere tests use real distances.
+	glm::vec4 planes[6];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		glm::vec4 row = glm::vec4(a_clipFromModel[0][axis], a_clipFromModel[1][axis], a_clipFromModel[2][axis], a_clipFromModel[3][axis]);
+		glm::vec4 w = glm::vec4(a_clipFromModel[0][3], a_clipFromModel[1][3], a_clipFromModel[2][3], a_clipFromModel[3][3]);
+		planes[axis * 2] = w + row;
+		planes[axis * 2 + 1] = w - row;
+	}
+	for (glm::vec4& plane : planes)
+	{
+		float length = glm::length(glm::vec3(plane));
+		plane = (length > 0.0f) ? plane / length : plane;
+	}
+	for (const ArenaBatch& batch : model->batches)
+	{
+		GPUDrawBatch drawBatch = { batch.material, (unsigned int)m_commands.size(), 0 };
+		for (unsigned int meshIndex : batch.meshes)
+		{
+			const ArenaMesh& mesh = model->meshes[meshIndex];
+			const OBJMesh* pMesh = mesh.mesh;
+			glm::vec3 center = pMesh->GetBounds().GetCenter();
+			float radius = pMesh->GetBounds().GetRadius();
+			bool visible = true;
+			for (const glm::vec4& plane : planes)
+			{
+				if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+				{
+					visible = false;
+					break;
+				}
+			}
+			if (!visible)
+			{
+				continue;
+			}
+			GPUDrawCommand command = { 0, 1, 0, (int)mesh.vertexOffset, mesh.drawRecord };
+			unsigned int lod = pMesh->SelectLod(a_modelCameraPosition, a_pixelsPerUnit, a_maxPixelError);
+			if (lod > 0)
+			{
+				//Levels index the mesh's vertices directly and are stored after the mesh's own indices.
+				const OBJLodLevel& level = pMesh->m_lodLevels[lod - 1];
+				command.count = level.indexCount;
+				command.firstIndex = (unsigned int)(mesh.indexOffset + mesh.indexCount + level.indexStart);
+				m_commands.push_back(command);
+			}
+			else if (pMesh->HasShortIndices())
+			{
+				for (const OBJIndexRange& range : pMesh->m_indexRanges)
+				{
+					command.count = range.indexCount;
+					command.firstIndex = (unsigned int)(mesh.indexOffset + range.indexStart);
+					command.baseVertex = (int)(mesh.vertexOffset + range.baseVertex);
+					m_commands.push_back(command);
+				}
+			}
+			else
+			{
+				command.count = (unsigned int)mesh.indexCount;
+				command.firstIndex = (unsigned int)mesh.indexOffset;
+				m_commands.push_back(command);
+			}
+		}
+		drawBatch.commandCount = (unsigned int)m_commands.size() - drawBatch.firstCommand;
+		if (drawBatch.commandCount > 0)
+		{
+			m_batches.push_back(drawBatch);
+		}
+	}
+}
+
+void GPUGeometryArena::BeginSubmit()
+{
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, m_commands.size() * sizeof(GPUDrawCommand), m_commands.data(), GL_STREAM_DRAW);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, s_drawRecordBinding, m_drawRecordBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, s_materialBinding, m_materialBuffer);
+	glBindVertexArray(m_vao);
+}
+
+void GPUGeometryArena::SubmitBatch(unsigned int a_batch) const
+{
+	const GPUDrawBatch& batch = m_batches[a_batch];
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, ((char*)0) + batch.firstCommand * sizeof(GPUDrawCommand), batch.commandCount, 0);
+}
+
+void GPUGeometryArena::EndSubmit() const
+{
+	glBindVertexArray(0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
@@ -0,0 +1,87 @@
+#include "GPUMaterialBuffer.h"
+#include "GPUGeometryArena.h"
+#include "obj_loader.h"
+#include <glad/glad.h>
+#include <vector>
+
+GPUMaterialBuffer::GPUMaterialBuffer() : m_buffer(0), m_windowCount(0), m_boundWindow(-1)
+{
+	//The default material until SetDefaultMaterial is called.
+	m_defaultMaterial[0] = glm::vec4(0.25f, 0.25f, 0.25f, 1.0f);
+	m_defaultMaterial[1] = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+	m_defaultMaterial[2] = glm::vec4(1.0f, 1.0f, 1.0f, 64.0f);
+}
+
+GPUMaterialBuffer::~GPUMaterialBuffer()
+{
+	Clear();
+}
+
+void GPUMaterialBuffer::Upload(OBJModel* a_model)
+{
+	Clear();
+	//GPUMaterialRecord's 64 bytes are also its std140 array stride, so the arena's record type is reused.
+	unsigned int entryCount = a_model->GetMaterialCount() + 1;
+	m_windowCount = (entryCount + WINDOW_SIZE - 1) / WINDOW_SIZE;
+	std::vector<GPUMaterialRecord> records(m_windowCount * WINDOW_SIZE, GPUMaterialRecord());
+	records[0].kA = m_defaultMaterial[0];
+	records[0].kD = m_defaultMaterial[1];
+	records[0].kS = m_defaultMaterial[2];
+	for (unsigned int i = 0; i < a_model->GetMaterialCount(); i++)
+	{
+		OBJMaterial* material = a_model->GetMaterialByIndex(i);
+		GPUMaterialRecord& record = records[i + 1];
+		record.kA = material->kA;
+		record.kD = material->kD;
+		record.kS = material->kS;
+		record.textureUsed = 1;
+	}
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+	glBufferData(GL_UNIFORM_BUFFER, records.size() * sizeof(GPUMaterialRecord), records.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void GPUMaterialBuffer::Clear()
+{
+	if (m_buffer != 0)
+	{
+		glDeleteBuffers(1, &m_buffer);
+	}
+	m_buffer = 0;
+	m_windowCount = 0;
+	m_boundWindow = -1;
+}
+
+void GPUMaterialBuffer::SetDefaultMaterial(const glm::vec4& a_kA, const glm::vec4& a_kD, const glm::vec4& a_kS)
+{
+	if (m_defaultMaterial[0] == a_kA && m_defaultMaterial[1] == a_kD && m_defaultMaterial[2] == a_kS)
+	{
+		return;
+	}
+	m_defaultMaterial[0] = a_kA;
+	m_defaultMaterial[1] = a_kD;
+	m_defaultMaterial[2] = a_kS;
+	if (m_buffer != 0)
+	{
+		GPUMaterialRecord record = GPUMaterialRecord();
+		record.kA = a_kA;
+		record.kD = a_kD;
+		record.kS = a_kS;
+		glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(GPUMaterialRecord), &record);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+}
+
+unsigned int GPUMaterialBuffer::Bind(unsigned int a_materialId)
+{
+	int window = (int)(a_materialId / WINDOW_SIZE);
+	if (m_buffer != 0 && window != m_boundWindow && (unsigned int)window < m_windowCount)
+	{
+		//Windows start at multiples of 16KB, which meets any uniform buffer offset alignment.
+		glBindBufferRange(GL_UNIFORM_BUFFER, BLOCK_BINDING, m_buffer, (size_t)window * WINDOW_SIZE * sizeof(GPUMaterialRecord), WINDOW_SIZE * sizeof(GPUMaterialRecord));
+		m_boundWindow = window;
+	}
+	return a_materialId % WINDOW_SIZE;
+}
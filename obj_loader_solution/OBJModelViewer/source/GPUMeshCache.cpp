@@ -0,0 +1,109 @@
+#include "GPUMeshCache.h"
+#include "obj_loader.h"
+#include <glad/glad.h>
+
+GPUMeshCache::GPUMeshCache() : m_meshes(), m_bytesUploaded(0)
+{
+
+}
+
+GPUMeshCache::~GPUMeshCache()
+{
+	Clear();
+}
+
+//Create a buffer, fill it with a_size bytes of a_data and return it, leaving it bound to a_target.
+static unsigned int CreateBuffer(unsigned int a_target, size_t a_size, const void* a_data, size_t& a_bytesUploaded)
+{
+	unsigned int buffer = 0;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(a_target, buffer);
+	glBufferData(a_target, a_size, a_data, GL_STATIC_DRAW);
+	a_bytesUploaded += a_size;
+	return buffer;
+}
+
+void GPUMeshCache::Upload(OBJModel* a_model)
+{
+	Clear();
+	m_meshes.resize(a_model->GetMeshCount());
+	for (unsigned int i = 0; i < a_model->GetMeshCount(); i++)
+	{
+		OBJMesh* pMesh = a_model->GetMeshByIndex(i);
+		GPUMesh& gpuMesh = m_meshes[i];
+		gpuMesh = GPUMesh();
+		glGenVertexArrays(1, &gpuMesh.vao);
+		glBindVertexArray(gpuMesh.vao);
+		glEnableVertexAttribArray(0); //Position.
+		glEnableVertexAttribArray(1); //Normal.
+		glEnableVertexAttribArray(2); //UV coord.
+		if (pMesh->GetVertexLayout() == OBJMesh::LAYOUT_QUANTIZED)
+		{
+			//Normalised integer attributes, the shader turns them back into positions and normals.
+			gpuMesh.vertexBuffers[0] = CreateBuffer(GL_ARRAY_BUFFER, pMesh->m_quantizedVertices.size() * sizeof(OBJQuantizedVertex), pMesh->m_quantizedVertices.data(), m_bytesUploaded);
+			glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(OBJQuantizedVertex), ((char*)0) + OBJQuantizedVertex::PositionOffset);
+			glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(OBJQuantizedVertex), ((char*)0) + OBJQuantizedVertex::NormalOffset);
+			glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(OBJQuantizedVertex), ((char*)0) + OBJQuantizedVertex::UVCoordOffset);
+		}
+		else if (pMesh->GetVertexLayout() == OBJMesh::LAYOUT_STREAMS)
+		{
+			//Each attribute comes from its own tightly packed buffer.
+			gpuMesh.vertexBuffers[0] = CreateBuffer(GL_ARRAY_BUFFER, pMesh->m_positions.size() * sizeof(glm::vec3), pMesh->m_positions.data(), m_bytesUploaded);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), 0);
+			gpuMesh.vertexBuffers[1] = CreateBuffer(GL_ARRAY_BUFFER, pMesh->m_normals.size() * sizeof(glm::vec3), pMesh->m_normals.data(), m_bytesUploaded);
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_TRUE, sizeof(glm::vec3), 0);
+			gpuMesh.vertexBuffers[2] = CreateBuffer(GL_ARRAY_BUFFER, pMesh->m_uvcoords.size() * sizeof(glm::vec2), pMesh->m_uvcoords.data(), m_bytesUploaded);
+			glVertexAttribPointer(2, 2, GL_FLOAT, GL_TRUE, sizeof(glm::vec2), 0);
+		}
+		else
+		{
+			gpuMesh.vertexBuffers[0] = CreateBuffer(GL_ARRAY_BUFFER, pMesh->m_vertices.size() * sizeof(OBJVertex), pMesh->m_vertices.data(), m_bytesUploaded);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(OBJVertex), ((char*)0) + OBJVertex::PositionOffset);
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_TRUE, sizeof(OBJVertex), ((char*)0) + OBJVertex::NormalOffset);
+			glVertexAttribPointer(2, 2, GL_FLOAT, GL_TRUE, sizeof(OBJVertex), ((char*)0) + OBJVertex::UVCoordOffset);
+		}
+		//Tangents are their own stream whatever the layout, meshes without them leave attribute 3 disabled so it reads
+		//the constant set with glVertexAttrib4f.
+		if (pMesh->HasTangents())
+		{
+			gpuMesh.vertexBuffers[3] = CreateBuffer(GL_ARRAY_BUFFER, pMesh->m_tangents.size() * sizeof(glm::vec4), pMesh->m_tangents.data(), m_bytesUploaded);
+			glEnableVertexAttribArray(3); //Tangent and bitangent sign.
+			glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), 0);
+		}
+
+		//One element buffer per mesh so the VAO's binding never changes, level of detail indices follow the mesh's own
+		//(kept 4 byte aligned) and are drawn from an offset.
+		const void* indexData = pMesh->HasShortIndices() ? (const void*)pMesh->m_shortIndices.data() : (const void*)pMesh->m_indices.data();
+		size_t indexBytes = pMesh->HasShortIndices() ? pMesh->m_shortIndices.size() * sizeof(uint16_t) : pMesh->m_indices.size() * sizeof(unsigned int);
+		size_t lodBytes = pMesh->m_lodIndices.size() * sizeof(unsigned int);
+		gpuMesh.indexType = pMesh->HasShortIndices() ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		gpuMesh.lodIndexOffset = (indexBytes + 3) & ~(size_t)3;
+		gpuMesh.indexBuffer = CreateBuffer(GL_ELEMENT_ARRAY_BUFFER, gpuMesh.lodIndexOffset + lodBytes, nullptr, m_bytesUploaded);
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indexBytes, indexData);
+		if (lodBytes > 0)
+		{
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, gpuMesh.lodIndexOffset, lodBytes, pMesh->m_lodIndices.data());
+		}
+		glBindVertexArray(0);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void GPUMeshCache::Clear()
+{
+	for (GPUMesh& gpuMesh : m_meshes)
+	{
+		glDeleteVertexArrays(1, &gpuMesh.vao);
+		for (unsigned int buffer : gpuMesh.vertexBuffers)
+		{
+			if (buffer != 0)
+			{
+				glDeleteBuffers(1, &buffer);
+			}
+		}
+		glDeleteBuffers(1, &gpuMesh.indexBuffer);
+	}
+	m_meshes.clear();
+	m_bytesUploaded = 0;
+}
@@ -0,0 +1,173 @@
+#include "ShaderProgram.h"
+#include "ShaderUtil.h"
+#include "GLStateCache.h"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <cstring>
+
+ShaderProgram::ShaderProgram() : m_program(0), m_uniforms(), m_uniformsByName()
+{
+
+}
+
+ShaderProgram::~ShaderProgram()
+{
+	//The GL objects are deleted in Destroy, while the context still exists.
+}
+
+bool ShaderProgram::Create(unsigned int a_vertexShader, unsigned int a_fragmentShader)
+{
+	Destroy();
+	if (a_vertexShader == 0 || a_fragmentShader == 0)
+	{
+		return false;
+	}
+	m_program = ShaderUtil::CreateProgram(a_vertexShader, a_fragmentShader);
+	if (m_program == 0)
+	{
+		return false;
+	}
+	ReflectUniforms();
+	return true;
+}
+
+bool ShaderProgram::Create(const char* a_vertexFilename, const char* a_fragmentFilename)
+{
+	unsigned int vertexShader = ShaderUtil::LoadShader(a_vertexFilename, GL_VERTEX_SHADER);
+	unsigned int fragmentShader = ShaderUtil::LoadShader(a_fragmentFilename, GL_FRAGMENT_SHADER);
+	bool created = Create(vertexShader, fragmentShader);
+	ShaderUtil::DeleteShader(vertexShader);
+	ShaderUtil::DeleteShader(fragmentShader);
+	return created;
+}
+
+void ShaderProgram::Destroy()
+{
+	if (m_program != 0)
+	{
+		if (GLStateCache::GetProgram() == m_program)
+		{
+			GLStateCache::UseProgram(0);
+		}
+		ShaderUtil::DeleteProgram(m_program);
+		m_program = 0;
+	}
+	m_uniformsByName.clear();
+	m_uniforms.clear();
+}
+
+void ShaderProgram::ReflectUniforms()
+{
+	int uniformCount = 0;
+	int maxNameLength = 0;
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+	std::vector<char> name(maxNameLength + 1);
+	m_uniforms.reserve(uniformCount);
+	for (int i = 0; i < uniformCount; i++)
+	{
+		int nameLength = 0;
+		int size = 0;
+		unsigned int type = 0;
+		glGetActiveUniform(m_program, i, (int)name.size(), &nameLength, &size, &type, name.data());
+		Uniform uniform;
+		uniform.name.assign(name.data(), nameLength);
+		//Arrays are reported as their first element, they are set by their plain name.
+		if (uniform.name.size() > 3 && uniform.name.compare(uniform.name.size() - 3, 3, "[0]") == 0)
+		{
+			uniform.name.resize(uniform.name.size() - 3);
+		}
+		uniform.location = glGetUniformLocation(m_program, name.data());
+		uniform.valueKnown = false;
+		//Members of uniform blocks have no location.
+		if (uniform.location >= 0)
+		{
+			m_uniforms.push_back(uniform);
+		}
+	}
+	//Built after m_uniforms stops growing so the keys stay valid.
+	for (unsigned int i = 0; i < m_uniforms.size(); i++)
+	{
+		m_uniformsByName.emplace(m_uniforms[i].name, i);
+	}
+}
+
+void ShaderProgram::Use() const
+{
+	GLStateCache::UseProgram(m_program);
+}
+
+int ShaderProgram::GetUniformLocation(std::string_view a_name) const
+{
+	auto found = m_uniformsByName.find(a_name);
+	return (found != m_uniformsByName.end()) ? m_uniforms[found->second].location : -1;
+}
+
+ShaderProgram::Uniform* ShaderProgram::PrepareUpload(std::string_view a_name, const void* a_value, size_t a_size)
+{
+	auto found = m_uniformsByName.find(a_name);
+	if (found == m_uniformsByName.end())
+	{
+		return nullptr;
+	}
+	Uniform& uniform = m_uniforms[found->second];
+	if (uniform.valueKnown && memcmp(uniform.value, a_value, a_size) == 0)
+	{
+		return nullptr;
+	}
+	memcpy(uniform.value, a_value, a_size);
+	uniform.valueKnown = true;
+	//glUniform works on the current program.
+	Use();
+	return &uniform;
+}
+
+void ShaderProgram::SetUniformBlockBinding(const char* a_name, unsigned int a_binding)
+{
+	unsigned int blockIndex = glGetUniformBlockIndex(m_program, a_name);
+	if (blockIndex != GL_INVALID_INDEX)
+	{
+		glUniformBlockBinding(m_program, blockIndex, a_binding);
+	}
+}
+
+void ShaderProgram::SetUniform(std::string_view a_name, int a_value)
+{
+	if (Uniform* uniform = PrepareUpload(a_name, &a_value, sizeof(a_value)))
+	{
+		glUniform1i(uniform->location, a_value);
+	}
+}
+
+void ShaderProgram::SetUniform(std::string_view a_name, float a_value)
+{
+	if (Uniform* uniform = PrepareUpload(a_name, &a_value, sizeof(a_value)))
+	{
+		glUniform1f(uniform->location, a_value);
+	}
+}
+
+void ShaderProgram::SetUniform(std::string_view a_name, const glm::vec3& a_value)
+{
+	if (Uniform* uniform = PrepareUpload(a_name, glm::value_ptr(a_value), sizeof(a_value)))
+	{
+		glUniform3fv(uniform->location, 1, glm::value_ptr(a_value));
+	}
+}
+
+void ShaderProgram::SetUniform(std::string_view a_name, const glm::vec4& a_value)
+{
+	if (Uniform* uniform = PrepareUpload(a_name, glm::value_ptr(a_value), sizeof(a_value)))
+	{
+		glUniform4fv(uniform->location, 1, glm::value_ptr(a_value));
+	}
+}
+
+void ShaderProgram::SetUniform(std::string_view a_name, const glm::mat4& a_value)
+{
+	if (Uniform* uniform = PrepareUpload(a_name, glm::value_ptr(a_value), sizeof(a_value)))
+	{
+		glUniformMatrix4fv(uniform->location, 1, GL_FALSE, glm::value_ptr(a_value));
+	}
+}
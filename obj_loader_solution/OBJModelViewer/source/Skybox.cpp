@@ -11,6 +11,7 @@
 //Custom includes.
 #include "Texture.h"
 #include "ShaderUtil.h"
+#include "GLStateCache.h"
 
 Skybox::Skybox()
 {
@@ -28,11 +29,7 @@ void Skybox::SetUpSkybox()
 	ShaderUtil* shaderUtilInstance = ShaderUtil::GetInstance();
 
 	//Create shader program.
-	unsigned int vertexShader = ShaderUtil::LoadShader("resource/shaders/skybox_vertex.glsl", GL_VERTEX_SHADER);
-	unsigned int fragmentShader = ShaderUtil::LoadShader("resource/shaders/skybox_fragment.glsl", GL_FRAGMENT_SHADER);
-	m_SkyboxShader = ShaderUtil::CreateProgram(vertexShader, fragmentShader);
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+	m_SkyboxShader.Create("resource/shaders/skybox_vertex.glsl", "resource/shaders/skybox_fragment.glsl");
 
 	//Set up skybox model.
 	//Set up skybox variables.
@@ -93,30 +90,23 @@ void Skybox::RenderSkybox(glm::mat4 viewMatrix, glm::mat4 projectionMatrix, floa
 {
 	// draw skybox as last
 	glDepthMask(GL_FALSE);
-	glUseProgram(m_SkyboxShader);
-	int skyboxLocation = glGetUniformLocation(m_SkyboxShader, "skybox");
-	glUniform1i(skyboxLocation, 0);
+	//Uniform locations were looked up when the program was linked, unchanged values are not sent again.
+	m_SkyboxShader.Use();
+	m_SkyboxShader.SetUniform("skybox", 0);
 
 	glm::mat4 viewMat = glm::mat4(glm::mat3(viewMatrix));//Remove translation from view matrix.
 
 	//Pass the view and projection matices to the skybox shader.
-	int projectionLocation = glGetUniformLocation(m_SkyboxShader, "projection");
-	glUniformMatrix4fv(projectionLocation, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
-
-	int viewLocation = glGetUniformLocation(m_SkyboxShader, "view");
-	glUniformMatrix4fv(viewLocation, 1, GL_FALSE, glm::value_ptr(viewMat));
+	m_SkyboxShader.SetUniform("projection", projectionMatrix);
+	m_SkyboxShader.SetUniform("view", viewMat);
 
 	//Set the light level for this shader.
-	int lightLevelUniformLocation = glGetUniformLocation(m_SkyboxShader, "lightStrength");
-	glUniform1f(lightLevelUniformLocation, lightStrength);
+	m_SkyboxShader.SetUniform("lightStrength", lightStrength);
 
 	//Skybox cube.
 	glBindVertexArray(m_skyboxVAO);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, m_SkyboxTexture->GetCubeMapTexture());
+	GLStateCache::BindTexture(0, GL_TEXTURE_CUBE_MAP, m_SkyboxTexture->GetCubeMapTexture());
 	glDrawArrays(GL_TRIANGLES, 0, 36);
 	glBindVertexArray(0);
 	glDepthMask(GL_TRUE); // set depth function back to default
-
-	glUseProgram(0);
 }
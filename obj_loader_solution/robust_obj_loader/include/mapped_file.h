@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+//A read only view of a file's contents.
+//The file is memory mapped where possible so that the loader can parse directly over the
+//mapped bytes, if mapping is not requested (or fails) the file is read into an owned buffer instead.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	//Open a file, a_useMapping selects memory mapping over a single buffered read.
+	bool Open(const char* a_filename, bool a_useMapping = true);
+	//Release the mapping/buffer and close any open handles.
+	void Close();
+
+	const char* GetData() const { return m_data; }
+	size_t      GetSize() const { return m_size; }
+	bool        IsOpen()  const { return m_data != nullptr; }
+	bool        IsMapped() const { return m_mapped; }
+
+private:
+	//Copying would double release the mapping.
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool MapFile(const char* a_filename);
+	bool ReadIntoBuffer(const char* a_filename);
+
+	const char* m_data;
+	size_t m_size;
+	bool m_mapped;
+	//Storage used when the file has been read rather than mapped.
+	std::vector<char> m_buffer;
+#ifdef _WIN32
+	void* m_fileHandle;
+	void* m_mappingHandle;
+#else
+	int m_fileDescriptor;
+#endif
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <climits>
+#include <cstdint>
+
+//A locale free number parser for the text based model formats.
+//Numbers are parsed straight out of the file buffer with no allocation, the common short
+//decimal case is handled with a single exact floating point operation and anything else falls back
+//to std::from_chars, so every value round-trips exactly.
+class NumberParser
+{
+public:
+	//Parse a float from [a_first, a_last), returns one past the last character consumed
+	//or a_first if no number could be parsed (a_value is left untouched in that case).
+	static const char* ParseFloat(const char* a_first, const char* a_last, float& a_value);
+	//Parse a signed decimal integer, same return convention as ParseFloat.
+	//Values too large for an int saturate to +/-INT_MAX so callers' range checks reject them.
+	static const char* ParseInt(const char* a_first, const char* a_last, int& a_value);
+	//Skip spaces and tabs, returns the first character that is not whitespace.
+	static const char* SkipWhitespace(const char* a_first, const char* a_last);
+};
+
+inline const char* NumberParser::ParseInt(const char* a_first, const char* a_last, int& a_value)
+{
+	const char* p = a_first;
+	bool negative = false;
+	if (p < a_last && (*p == '-' || *p == '+'))
+	{
+		negative = (*p == '-');
+		++p;
+	}
+	const char* digitsStart = p;
+	int64_t value = 0;
+	while (p < a_last && (unsigned char)(*p - '0') < 10)
+	{
+		//Keep consuming digits once saturated so the whole number is skipped.
+		if (value <= INT_MAX)
+		{
+			value = value * 10 + (*p - '0');
+		}
+		++p;
+	}
+	if (value > INT_MAX)
+	{
+		value = INT_MAX;
+	}
+	if (p == digitsStart)
+	{
+		return a_first;
+	}
+	a_value = (int)(negative ? -value : value);
+	return p;
+}
+
+inline const char* NumberParser::SkipWhitespace(const char* a_first, const char* a_last)
+{
+	while (a_first < a_last && (*a_first == ' ' || *a_first == '\t'))
+	{
+		++a_first;
+	}
+	return a_first;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+//Monotonic memory arena, allocations are carved from large blocks taken straight from the OS and are only given
+//back all at once. A model keeps its meshes, materials, names and finished vertex/index arrays in one, so unloading
+//is a handful of block frees however many meshes there were, and reloading reuses the same memory without
+//fragmenting the heap. Blocks can be backed by huge pages to cut TLB misses when walking large meshes.
+class OBJArena
+{
+public:
+	OBJArena();
+	~OBJArena();
+
+	//Memory aligned to a_alignment (a power of two) from the current block, a new block is started when it does not fit.
+	void* Allocate(size_t a_size, size_t a_alignment);
+	//Hand memory back, it is only reclaimed when it was the latest allocation (a growing vector) and is otherwise
+	//kept until Reset.
+	void Free(void* a_memory, size_t a_size);
+	//Construct an object in the arena, the arena never runs its destructor.
+	template<typename T, typename... Args>
+	T* New(Args&&... a_args);
+	//Forget every allocation but keep the largest block, so a model of a similar size reloads without new blocks.
+	void Reset();
+	//Return every block to the OS.
+	void Release();
+
+	//Only affects blocks allocated afterwards, blocks fall back to normal pages where the OS refuses huge ones.
+	void SetUseHugePages(bool a_useHugePages) { m_useHugePages = a_useHugePages; }
+	bool GetUseHugePages() const { return m_useHugePages; }
+	//Bytes handed out (including alignment padding) since the last Reset, and bytes held in blocks.
+	size_t GetBytesUsed() const { return m_bytesUsed; }
+	size_t GetBytesReserved() const { return m_bytesReserved; }
+
+private:
+	//Copying would double release the blocks.
+	OBJArena(const OBJArena&) = delete;
+	OBJArena& operator=(const OBJArena&) = delete;
+
+	//Header at the start of every block, the rest of the block is handed out front to back.
+	struct Block
+	{
+		Block* next;
+		size_t size;
+		size_t used;
+	};
+	Block* AllocateBlock(size_t a_minimumSize);
+	static void FreeBlock(Block* a_block);
+
+	//Newest block first, allocations only come from the newest.
+	Block* m_blocks;
+	size_t m_bytesUsed;
+	size_t m_bytesReserved;
+	bool m_useHugePages;
+	//Meshes may be edited from several threads once they live in the arena.
+	std::mutex m_mutex;
+};
+
+template<typename T, typename... Args>
+inline T* OBJArena::New(Args&&... a_args)
+{
+	return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(a_args)...);
+}
+
+//Standard allocator over an OBJArena, or over the heap when it has no arena (the default). Containers are filled on
+//the heap and moved into an arena once finished. The arena travels with the storage when a container is moved or
+//swapped, copies of a container always go to the heap.
+template<typename T>
+class OBJArenaAllocator
+{
+public:
+	typedef T value_type;
+	typedef std::false_type propagate_on_container_copy_assignment;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+
+	OBJArenaAllocator() noexcept : m_arena(nullptr) {};
+	explicit OBJArenaAllocator(OBJArena* a_arena) noexcept : m_arena(a_arena) {};
+	template<typename U>
+	OBJArenaAllocator(const OBJArenaAllocator<U>& a_other) noexcept : m_arena(a_other.GetArena()) {};
+
+	T* allocate(size_t a_count)
+	{
+		if (m_arena == nullptr)
+		{
+			return std::allocator<T>().allocate(a_count);
+		}
+		return static_cast<T*>(m_arena->Allocate(a_count * sizeof(T), alignof(T)));
+	}
+	void deallocate(T* a_memory, size_t a_count)
+	{
+		if (m_arena == nullptr)
+		{
+			std::allocator<T>().deallocate(a_memory, a_count);
+			return;
+		}
+		m_arena->Free(a_memory, a_count * sizeof(T));
+	}
+	OBJArenaAllocator select_on_container_copy_construction() const { return OBJArenaAllocator(); }
+	OBJArena* GetArena() const { return m_arena; }
+
+private:
+	OBJArena* m_arena;
+};
+
+template<typename T, typename U>
+inline bool operator==(const OBJArenaAllocator<T>& a_lhs, const OBJArenaAllocator<U>& a_rhs) { return a_lhs.GetArena() == a_rhs.GetArena(); }
+template<typename T, typename U>
+inline bool operator!=(const OBJArenaAllocator<T>& a_lhs, const OBJArenaAllocator<U>& a_rhs) { return a_lhs.GetArena() != a_rhs.GetArena(); }
+
+template<typename T>
+using OBJArenaVector = std::vector<T, OBJArenaAllocator<T>>;
+
+//Move a container's contents into a_arena, one copy into storage sized exactly to fit.
+template<typename T>
+inline void MoveToArena(OBJArenaVector<T>& a_vector, OBJArena& a_arena)
+{
+	if (a_vector.empty() || a_vector.get_allocator().GetArena() == &a_arena)
+	{
+		return;
+	}
+	OBJArenaVector<T> moved(a_vector.begin(), a_vector.end(), OBJArenaAllocator<T>(&a_arena));
+	a_vector.swap(moved);
+}
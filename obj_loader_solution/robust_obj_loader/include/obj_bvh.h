@@ -0,0 +1,71 @@
+#pragma once
+
+#include "obj_loader.h"
+#include <vector>
+
+//A triangle of a model, found by an OBJBvh query.
+struct OBJTriangleRef
+{
+	unsigned int mesh;     //Index of the mesh in the model.
+	unsigned int triangle; //Its corners are indices triangle * 3 to triangle * 3 + 2 of the mesh's GetIndices.
+};
+
+//The nearest triangle along a ray.
+struct OBJRayHit
+{
+	unsigned int mesh;
+	unsigned int triangle;
+	float distance;         //Along the ray in multiples of its direction, so world units for a unit direction.
+	glm::vec2 barycentrics; //Weights of the triangle's second and third corners, the first corner's is 1 - x - y.
+};
+
+//A node of the hierarchy, leaves have a triangle count and interior nodes have their two children next to each other.
+struct OBJBvhNode
+{
+	glm::vec3 minimum;
+	unsigned int first; //First triangle of a leaf, or the left child of an interior node (the right child follows it).
+	glm::vec3 maximum;
+	unsigned int count; //Triangles in a leaf, 0 for an interior node.
+};
+
+//Bounding volume hierarchy over every triangle of a model, built with the binned surface area heuristic so queries
+//visit as few nodes and triangles as possible. Queries work in the model's own space and only read the hierarchy,
+//so any number of threads may query it at once. It is a snapshot, rebuild it after changing the meshes.
+class OBJBvh
+{
+public:
+	OBJBvh() {};
+	~OBJBvh() {};
+
+	//Build over the current triangles of every mesh in the model, the work is spread across all cores.
+	void Build(OBJModel& a_model);
+	void Clear();
+	bool IsEmpty() const { return m_nodes.empty(); }
+	unsigned int GetTriangleCount() const { return m_triangles.size(); }
+	unsigned int GetNodeCount() const { return m_nodes.size(); }
+
+	//Nearest triangle hit by the ray within a_maxDistance, both sides of a triangle count as a hit.
+	bool Intersect(const glm::vec3& a_origin, const glm::vec3& a_direction, OBJRayHit& a_hit, float a_maxDistance = FLT_MAX) const;
+	//Append every triangle whose bounds overlap a_bounds to a_triangles.
+	void Overlap(const OBJBounds& a_bounds, std::vector<OBJTriangleRef>& a_triangles) const;
+
+private:
+	//The model cache saves and restores the arrays directly.
+	friend class OBJModel;
+	//Whether arrays read back from a cache can be queried safely: children and triangles in range, children after
+	//their parent and no path deeper than the query stacks.
+	bool IsWellFormed() const;
+
+	//A triangle stored the way the ray test wants it, one corner and the two edges leaving it.
+	struct Triangle
+	{
+		glm::vec3 corner;
+		glm::vec3 edgeB;
+		glm::vec3 edgeC;
+	};
+
+	std::vector<OBJBvhNode> m_nodes;
+	//Triangles in leaf order, with the mesh triangle each one came from.
+	std::vector<Triangle> m_triangles;
+	std::vector<OBJTriangleRef> m_triangleRefs;
+};
@@ -3,6 +3,19 @@
 #include <glm/glm.hpp>
 #include <vector>
 #include <string>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+#include <cfloat>
+#include <unordered_map>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include "obj_arena.h"
+
+class OBJVertexWelder;
+class OBJBvh;
 
 /// <summary>
 /// An OBJ Material.
@@ -75,6 +88,70 @@ inline bool OBJVertex::operator<(const OBJVertex& a_rhs) const
 	return memcmp(this, &a_rhs, sizeof(OBJVertex)) < 0;
 }
 
+//A compressed vertex, 16 bytes instead of 40.
+//Positions are 16 bit fractions of the mesh bounds, normals are octahedral snorm16 and uvs are half floats.
+class OBJQuantizedVertex
+{
+public:
+	enum Offsets
+	{
+		PositionOffset = 0,
+		NormalOffset = PositionOffset + sizeof(uint16_t) * 4,
+		UVCoordOffset = NormalOffset + sizeof(int16_t) * 2,
+	};
+
+	uint16_t position[4]; //w is unused, it keeps the normal 4 byte aligned.
+	int16_t normal[2];
+	uint16_t uvcoord[2];
+};
+
+//A run of a mesh's 16 bit indices, the indices are relative to baseVertex.
+struct OBJIndexRange
+{
+	unsigned int indexStart;
+	unsigned int indexCount;
+	unsigned int baseVertex;
+};
+
+//A small cluster of a mesh's triangles, small enough to cull on its own.
+//A meshlet is a contiguous run of triangles in the mesh's index buffer so it can be drawn straight from it.
+struct OBJMeshlet
+{
+	unsigned int vertexOffset;   //First of the meshlet's vertices in m_meshletVertices.
+	unsigned int vertexCount;
+	unsigned int triangleOffset; //First of the meshlet's triangles in m_meshletTriangles, three local indices each.
+	unsigned int triangleCount;
+	unsigned int indexStart;     //First index in m_indices, or m_shortIndices with baseVertex added.
+	unsigned int baseVertex;
+	glm::vec3 center;            //Bounding sphere.
+	float radius;
+	glm::vec3 coneApex;          //Normal cone, every triangle faces away from a camera where
+	glm::vec3 coneAxis;          //dot(normalize(coneApex - camera), coneAxis) > coneCutoff.
+	float coneCutoff;            //1 when the normals are too spread out for the cone to cull anything.
+};
+
+//A simplified version of a mesh, a run of OBJMesh::m_lodIndices over the mesh's own vertices.
+struct OBJLodLevel
+{
+	unsigned int indexStart;
+	unsigned int indexCount;
+	float error; //Largest distance the simplified surface may be from the original, in model units.
+};
+
+//Axis aligned bounding box with the sphere around it, empty until the first position is added.
+struct OBJBounds
+{
+	glm::vec3 minimum = glm::vec3(FLT_MAX);
+	glm::vec3 maximum = glm::vec3(-FLT_MAX);
+
+	void Add(const glm::vec3& a_position) { minimum = glm::min(minimum, a_position); maximum = glm::max(maximum, a_position); }
+	void Add(const OBJBounds& a_bounds) { minimum = glm::min(minimum, a_bounds.minimum); maximum = glm::max(maximum, a_bounds.maximum); }
+	bool IsEmpty() const { return minimum.x > maximum.x; }
+	//Bounding sphere centred on the box, its radius is half the box diagonal.
+	glm::vec3 GetCenter() const { return IsEmpty() ? glm::vec3(0.0f) : (minimum + maximum) * 0.5f; }
+	float GetRadius() const { return IsEmpty() ? 0.0f : glm::length(maximum - minimum) * 0.5f; }
+};
+
 //An OBJ Model can be composed of many meshes. Much like any 3D model
 //lets us use a class to store individual mesh data.
 class OBJMesh
@@ -83,69 +160,328 @@ public:
 	OBJMesh();
 	~OBJMesh();
 
+	//Vertex data is held either as interleaved OBJVertex records or as separate position/normal/uv streams.
+	enum VertexLayout
+	{
+		LAYOUT_INTERLEAVED = 0, //m_vertices.
+		LAYOUT_STREAMS, //m_positions, m_normals and m_uvcoords, vec3 positions/normals with no padding.
+		LAYOUT_QUANTIZED, //m_quantizedVertices, decoded with m_positionScale/m_positionOffset.
+	};
+	//Special values in m_smoothingGroups, any other value is an OBJ "s" group number.
+	enum SmoothingGroup : unsigned int
+	{
+		SMOOTHING_OFF = 0, //Flat shaded ("s off" or "s 0").
+		SMOOTHING_FILE_NORMALS = 0xFFFFFFFFu, //The triangle's normals came from the file, GenerateNormals leaves them alone.
+	};
+
 	glm::vec4 CalculateFaceNormal(const unsigned int& a_indexA, const unsigned int& a_indexB, const unsigned int& a_indexC)const;
+	//Recalculate every vertex normal from the triangles, see GenerateNormals.
 	void CalculateFaceNormals();
+	//Area and angle weighted normals for the vertices of triangles that need them. Vertices at the same position in
+	//the same smoothing group (m_smoothingGroups, or one group for the whole mesh without it) are smoothed together,
+	//SMOOTHING_OFF triangles get flat normals as long as their vertices are not shared with other triangles.
+	void GenerateNormals();
+	//MikkTSpace compatible tangents for m_tangents, vertices shared by triangles with mirrored uvs are split.
+	//Works on m_indices so must run before UseShortIndices, BuildMeshlets and BuildLods, returns false after it.
+	bool GenerateTangents();
+	bool HasTangents() const { return !m_tangents.empty(); }
+	//Move the vertex data into the requested layout, the storage for the other layout is released.
+	void SetVertexLayout(VertexLayout a_layout);
+	VertexLayout GetVertexLayout() const { return m_layout; }
+	//Copy the vertex, index, meshlet and lod arrays into a_arena at their exact sizes. The arena stays with an array
+	//afterwards: growing it (push_back, resize) reallocates inside the arena, and only swapping it with a heap array,
+	//as the optimisation passes do, moves it back to the heap. Either way the old arena copy is kept until Reset.
+	void MoveToArena(OBJArena& a_arena);
+	unsigned int GetVertexCount() const;
+	//Reorder the vertices so that new vertex i is old vertex a_newToOld[i], vertices may be repeated or dropped.
+	//Indices are not touched, the caller is expected to rewrite them. Tangents are reordered along with the vertices.
+	void RemapVertices(const std::vector<unsigned int>& a_newToOld);
+	//Switch the mesh to 16 bit indices, returns false if it has more than 65536 vertices and a_allowSplit is false.
+	//With a_allowSplit the vertices are regrouped into ranges of at most 65536, duplicating those shared across ranges.
+	bool UseShortIndices(bool a_allowSplit);
+	bool HasShortIndices() const { return !m_indexRanges.empty(); }
+	//Position of a vertex whatever the layout, quantized positions are decoded.
+	glm::vec3 GetVertexPosition(unsigned int a_index) const;
+	//Bounds of the mesh's vertices, filled in while the mesh is parsed.
+	const OBJBounds& GetBounds() const { return m_bounds; }
+	//Recompute the bounds from the vertices, only needed after editing vertex positions by hand.
+	void CalculateBounds();
 
-	std::string                m_name;
-	std::vector<OBJVertex>     m_vertices;
-	std::vector<unsigned int>  m_indices;
+	//Triangle order optimisation, these work on m_indices so must run before UseShortIndices.
+	//Average cache miss ratio (vertices transformed per triangle) of the current order for a FIFO cache of a_cacheSize.
+	float CalculateACMR(unsigned int a_cacheSize = 16) const;
+	//Reorder triangles so that vertices are reused while they are still in the post-transform cache.
+	void OptimizeVertexCache();
+	//Reorder clusters of the cache optimised order to reduce overdraw, a_threshold is how much worse than the
+	//cache optimised ACMR the result may be (1.05 allows 5%). The cache optimised order is kept if no reorder fits.
+	void OptimizeOverdraw(float a_threshold = 1.05f);
+	//Sort triangles along a Morton (Z-order) curve through their centroids, for meshes walked by spatial queries
+	//rather than drawn. Replaces any cache optimised order.
+	void SortTrianglesSpatially();
+	//Reorder the vertices into the order the index buffer first uses them and rewrite the indices to match,
+	//vertices no triangle uses are dropped. Run after any triangle reordering.
+	void OptimizeVertexFetch();
+	//Split the mesh into meshlets of at most a_maxVertices vertices and a_maxTriangles triangles, following the
+	//current triangle order so run it after any reordering or vertex remapping. a_maxVertices is at most 256.
+	void BuildMeshlets(unsigned int a_maxVertices = 64, unsigned int a_maxTriangles = 124);
+	//Append the meshlets that are inside the frustum and not facing away from the camera to a_visible.
+	//a_clipFromModel takes model space positions to clip space, a_cameraPosition is in model space.
+	void CullMeshlets(const glm::mat4& a_clipFromModel, const glm::vec3& a_cameraPosition, std::vector<unsigned int>& a_visible) const;
+	//Build progressively simplified levels with about a_ratios of the triangles each, largest ratio first.
+	void BuildLods(const std::vector<float>& a_ratios = { 0.5f, 0.25f, 0.125f, 0.0625f });
+	//Coarsest level whose error projects to at most a_maxPixelError pixels, 0 is the full mesh and level n is
+	//m_lodLevels[n - 1]. a_cameraPosition is in model space, a_pixelsPerUnit is pixels covered by one unit at distance one.
+	unsigned int SelectLod(const glm::vec3& a_cameraPosition, float a_pixelsPerUnit, float a_maxPixelError) const;
+	//The mesh's indices as 32 bit indices into the vertices, whether or not it uses short indices.
+	void GetIndices(std::vector<unsigned int>& a_indices) const;
+	unsigned int GetIndexCount() const { return HasShortIndices() ? m_shortIndices.size() : m_indices.size(); }
+
+	std::string                        m_name;
+	OBJArenaVector<OBJVertex>          m_vertices;
+	OBJArenaVector<unsigned int>       m_indices;
+	//16 bit indices and the ranges they are drawn in, used in place of m_indices after UseShortIndices.
+	OBJArenaVector<uint16_t>           m_shortIndices;
+	OBJArenaVector<OBJIndexRange>      m_indexRanges;
+	//Smoothing group of each triangle, only filled while loading a mesh that needs its normals generated.
+	OBJArenaVector<unsigned int>       m_smoothingGroups;
+	//Meshlets from BuildMeshlets, each with its own vertex list and triangles of local (8 bit) indices into it.
+	OBJArenaVector<OBJMeshlet>         m_meshlets;
+	OBJArenaVector<unsigned int>       m_meshletVertices;
+	OBJArenaVector<uint8_t>            m_meshletTriangles;
+	//Simplified levels from BuildLods, chosen between using the bounding sphere.
+	OBJArenaVector<unsigned int>       m_lodIndices;
+	OBJArenaVector<OBJLodLevel>        m_lodLevels;
+	OBJBounds                          m_bounds;
+	//Vertex streams, used in place of m_vertices when the layout is LAYOUT_STREAMS.
+	OBJArenaVector<glm::vec3>          m_positions;
+	OBJArenaVector<glm::vec3>          m_normals;
+	OBJArenaVector<glm::vec2>          m_uvcoords;
+	//Tangents from GenerateTangents whatever the layout, xyz is the tangent and w the bitangent sign so that
+	//bitangent = w * cross(normal, tangent). Empty for meshes without them.
+	OBJArenaVector<glm::vec4>          m_tangents;
+	//Compressed vertices, used when the layout is LAYOUT_QUANTIZED, position = quantized / 65535 * scale + offset.
+	OBJArenaVector<OBJQuantizedVertex> m_quantizedVertices;
+	glm::vec3 m_positionScale = glm::vec3(1.0f);
+	glm::vec3 m_positionOffset = glm::vec3(0.0f);
 	OBJMaterial* m_material = nullptr;
+	VertexLayout m_layout = LAYOUT_INTERLEAVED;
 };
 //Inline constructor destructor -- to be expanded upon as required.
 inline OBJMesh::OBJMesh() {}
 inline OBJMesh::~OBJMesh() {}
 
+//Progress of a model load, written by the loading thread and safe to read from any other thread.
+class OBJLoadProgress
+{
+public:
+	enum Phase
+	{
+		PHASE_QUEUED = 0,
+		PHASE_READING, //Opening/mapping the file or reading the cache.
+		PHASE_PARSING, //Reading the .obj records.
+		PHASE_ASSEMBLING, //Building the meshes from the parsed records.
+		PHASE_POSTPROCESSING, //Generating normals and running the passes the load flags ask for, see stepsProcessed.
+		PHASE_CACHING, //Writing the binary cache.
+		PHASE_FINISHED,
+		PHASE_CANCELLED,
+		PHASE_FAILED,
+	};
+	OBJLoadProgress() : phase(PHASE_QUEUED), bytesProcessed(0), bytesTotal(0), facesParsed(0), stepsProcessed(0), stepsTotal(0), cancelRequested(false) {};
+
+	static const char* GetPhaseName(Phase a_phase);
+
+	std::atomic<Phase> phase;
+	std::atomic<uint64_t> bytesProcessed;
+	std::atomic<uint64_t> bytesTotal;
+	std::atomic<uint64_t> facesParsed;
+	//Post-processing progress, one step per mesh for each pass.
+	std::atomic<uint64_t> stepsProcessed;
+	std::atomic<uint64_t> stepsTotal;
+	//Set to ask the loader to stop, it is checked between blocks of lines and between meshes so it takes effect quickly.
+	std::atomic<bool> cancelRequested;
+};
+
+//Handle to a load running on a worker thread, returned by OBJModel::LoadAsync.
+//The model must not be used until IsReady() returns true, destroying a handle waits for its load to finish.
+class OBJLoadHandle
+{
+public:
+	OBJLoadHandle() : m_result(), m_progress() {};
+	~OBJLoadHandle() {};
+	OBJLoadHandle(OBJLoadHandle&&) = default;
+	OBJLoadHandle& operator=(OBJLoadHandle&&) = default;
+
+	bool IsValid() const { return m_result.valid(); }
+	bool IsReady() const { return m_result.valid() && m_result.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+	//Wait for the load and return whether it succeeded, the handle is no longer valid afterwards.
+	bool GetResult() { return m_result.get(); }
+	//Ask the load to stop, GetResult() then returns false and the model is left empty.
+	void Cancel() { if (m_progress) { m_progress->cancelRequested = true; } }
+	const OBJLoadProgress* GetProgress() const { return m_progress.get(); }
+
+private:
+	friend class OBJModel;
+	std::future<bool> m_result;
+	std::shared_ptr<OBJLoadProgress> m_progress;
+};
+
 class OBJModel
 {
 public:
-	OBJModel(std::string a_modelName, const char* a_texturePath) : m_worldMatrix(glm::mat4(1.0f)), m_path(a_texturePath), m_modelName(a_modelName), m_meshes(), m_materials() {};
+	//Flags to control how a model is read in from file.
+	enum LoadFlags
+	{
+		LOAD_DEFAULT = 0,
+		LOAD_MEMORY_MAPPED = (1 << 0), //Memory map the .obj/.mtl files and parse directly over the mapped bytes.
+		LOAD_PARALLEL = (1 << 1), //Split the .obj into chunks and parse them on all cores, meshes match the serial path.
+		LOAD_WELD_VERTICES = (1 << 2), //Share one vertex between face corners with the same v/vt/vn triplet instead of one vertex per corner.
+		LOAD_WELD_POSITIONS = (1 << 3), //Weld on the position value (snapped to the weld tolerance) rather than its index, for scanned data with duplicate v records.
+		LOAD_USE_CACHE = (1 << 4), //Reload the finished meshes from a binary <file>.objcache when it is still valid, otherwise load and write one.
+		LOAD_VERTEX_STREAMS = (1 << 5), //Store mesh vertices as separate position/normal/uv streams (OBJMesh::LAYOUT_STREAMS).
+		LOAD_QUANTIZE_VERTICES = (1 << 6), //Compress mesh vertices to 16 bytes (OBJMesh::LAYOUT_QUANTIZED), takes priority over LOAD_VERTEX_STREAMS.
+		LOAD_SHORT_INDICES = (1 << 7), //Use 16 bit indices for meshes with no more than 65536 vertices.
+		LOAD_SPLIT_LARGE_MESHES = (1 << 8), //With LOAD_SHORT_INDICES, split larger meshes into 16 bit index ranges too.
+		LOAD_OPTIMIZE_VERTEX_CACHE = (1 << 9), //Reorder triangles for the post-transform vertex cache.
+		LOAD_OPTIMIZE_OVERDRAW = (1 << 10), //Also reorder triangle clusters to reduce overdraw, implies LOAD_OPTIMIZE_VERTEX_CACHE.
+		LOAD_OPTIMIZE_VERTEX_FETCH = (1 << 11), //Reorder vertices into first use order after any triangle reordering.
+		LOAD_SPATIAL_SORT = (1 << 12), //Sort triangles in Morton order for CPU side queries, overrides the cache and overdraw flags.
+		LOAD_BUILD_MESHLETS = (1 << 13), //Split meshes into meshlets once all other processing is done.
+		LOAD_BUILD_LODS = (1 << 14), //Build a chain of simplified levels of detail for each mesh.
+		LOAD_GENERATE_TANGENTS = (1 << 15), //Generate tangents for meshes whose material has a normal map.
+		LOAD_BUILD_BVH = (1 << 16), //Build a bounding volume hierarchy over all the triangles for ray and overlap queries, see GetBvh.
+		LOAD_HUGE_PAGES = (1 << 17), //Back the model's arena with huge pages where the OS allows it.
+	};
+
+	OBJModel(std::string a_modelName, const char* a_texturePath) : m_arena(), m_worldMatrix(glm::mat4(1.0f)), m_path(a_texturePath), m_modelName(a_modelName), m_meshes(), m_materials(), m_loadFlags(LOAD_DEFAULT), m_progress(nullptr), m_weldTolerance(0.0f), m_bvh(nullptr) {};
 	~OBJModel()
 	{
 		Unload(); //Function to unload any data loaded in from file.
 	};
 
-	//Load from file function.
-	bool Load(const char* a_filename, float a_scale = 1.0f);
-	//Function to unload and free memory.
+	//Load from file function, anything already loaded is unloaded first.
+	bool Load(const char* a_filename, float a_scale = 1.0f, unsigned int a_flags = LOAD_DEFAULT);
+	//Run Load on a worker thread, the returned handle reports progress and can cancel the load.
+	OBJLoadHandle LoadAsync(const char* a_filename, float a_scale = 1.0f, unsigned int a_flags = LOAD_DEFAULT);
+	//Function to unload and free memory, the arena keeps its largest block for the next load.
 	void Unload();
 	//Functions to retrieve path, number of meshes and world matrix of model.
 	const char* GetPath()              const { return m_path.c_str(); }
 	unsigned int       GetMeshCount()         const { return m_meshes.size(); }
 	unsigned int GetMaterialCount() const { return m_materials.size(); }
 	const glm::mat4& GetWorldMatrix()       const { return m_worldMatrix; }
+	//Model space bounds of every mesh, GetBounds().GetCenter()/GetRadius() give the bounding sphere.
+	const OBJBounds& GetBounds() const { return m_bounds; }
+	//Hierarchy over the model's triangles, built by LOAD_BUILD_BVH once all other processing is done, null otherwise.
+	const OBJBvh* GetBvh() const { return m_bvh; }
 	const char* GetModelName() const { return m_modelName.c_str(); }
+	//Grid size used to snap positions when loading with LOAD_WELD_POSITIONS, 0 only welds exactly equal positions.
+	void SetWeldTolerance(float a_tolerance) { m_weldTolerance = a_tolerance; }
+	float GetWeldTolerance() const { return m_weldTolerance; }
 	//Functions to retrieve mesh by name or index for models that contain multiple meshes.
-	OBJMesh* GetMeshByName(const char* a_name);
+	//Names are looked up in a hash index, when several share a name the first one added is returned.
+	OBJMesh* GetMeshByName(std::string_view a_name);
 	OBJMesh* GetMeshByIndex(unsigned int a_index);
-	OBJMaterial* GetMaterialByName(const char* a_name);
+	OBJMaterial* GetMaterialByName(std::string_view a_name);
 	OBJMaterial* GetMaterialByIndex(unsigned int a_index);
 
 private:
-	//Function to process line data read in from file.
-	std::string LineType(const std::string& a_in);
-	std::string LineData(const std::string& a_in);
-	glm::vec4 ProcessVectorString(const std::string a_data);
-	std::vector<std::string> SplitStringAtCharacter(std::string data, char a_character);
+	//Functions to parse the contents of an .obj/.mtl file once it is in memory, the .obj parsers return false if the load was cancelled.
+	bool ParseOBJData(const char* a_data, size_t a_size, float a_scale);
+	void ParseMaterialData(const char* a_data, size_t a_size);
+	//Multi-threaded variant of ParseOBJData, see obj_loader_parallel.cpp.
+	bool ParseOBJDataParallel(const char* a_data, size_t a_size, float a_scale);
+	//Work done on the meshes once they are parsed, driven by the load flags. Returns false if the load was cancelled.
+	bool PostProcessMeshes();
+	//Progress reporting for LoadAsync, these do nothing for a plain Load.
+	void SetLoadPhase(OBJLoadProgress::Phase a_phase);
+	//Add to the processed byte/face counts, returns false once cancellation has been requested.
+	bool ReportLoadProgress(size_t a_bytes, size_t a_faces);
+	//Add to the post-processing step count.
+	void ReportProcessingProgress(size_t a_steps);
+	bool IsLoadCancelled() const { return m_progress != nullptr && m_progress->cancelRequested; }
+	static const size_t s_progressBlockSize;
+	static const size_t s_parallelNormalsTriangles;
+	struct OBJParseChunk;
+	//Binary cache of a loaded and post-processed model, see obj_loader_cache.cpp.
+	bool LoadCache(const std::string& a_cachePath, const char* a_sourcePath, float a_scale);
+	bool SaveCache(const std::string& a_cachePath, const char* a_sourcePath, float a_scale) const;
+	//Keywords recognised while parsing an .obj file.
+	enum OBJLineType
+	{
+		LINE_UNKNOWN = 0,
+		LINE_COMMENT,
+		LINE_VERTEX,
+		LINE_TEXCOORD,
+		LINE_NORMAL,
+		LINE_FACE,
+		LINE_GROUP,
+		LINE_OBJECT,
+		LINE_USEMTL,
+		LINE_MTLLIB,
+		LINE_SMOOTH,
+	};
+	//Fetch the next line from a buffer without copying it, the returned view excludes the line ending.
+	static bool NextLine(const char*& a_cursor, const char* a_end, std::string_view& a_line);
+	//Functions to process line data read in from file, these only return views into the line.
+	void SplitLine(std::string_view a_line, std::string_view& a_keyword, std::string_view& a_data);
+	OBJLineType ClassifyLine(std::string_view a_line, std::string_view& a_data);
+	std::string_view LastToken(std::string_view a_data);
+	glm::vec4 ProcessVectorString(std::string_view a_data);
+	float ProcessFloatString(std::string_view a_data);
+	//Smoothing group number of an "s" statement, "off" and anything unreadable turn smoothing off.
+	static unsigned int ProcessSmoothingGroup(std::string_view a_data);
 
-	void LoadMaterialLibrary(std::string a_mtllib);
+	void LoadMaterialLibrary(std::string_view a_mtllib);
 	//OBJ face triplet struct.
 	typedef struct obj_face_triplet
 	{
-		unsigned int v;
-		unsigned int vt;
-		unsigned int vn;
+		int v;
+		int vt;
+		int vn;
 	}obj_face_triplet;
-	//Function to extract triplet data from OBJ file.
-	obj_face_triplet ProcessTriplet(std::string a_triplet);
+	//Function to extract triplet data from OBJ file, advances a_cursor past the triplet.
+	bool ProcessTriplet(const char*& a_cursor, const char* a_end, obj_face_triplet& a_triplet);
+	//Function to turn relative triplet indices absolute, returns false if any index is out of range.
+	bool ResolveTriplet(obj_face_triplet& a_triplet, size_t a_vertexCount, size_t a_uvCount, size_t a_normalCount);
+	static bool TripletInRange(const obj_face_triplet& a_triplet, size_t a_vertexCount, size_t a_uvCount, size_t a_normalCount);
+	//Append a face of resolved triplets to a mesh and fan triangulate it, corners are shared through a_welder when one is given.
+	void AssembleFace(OBJMesh* a_mesh, const obj_face_triplet* a_corners, size_t a_cornerCount,
+		const std::vector<glm::vec4>& a_vertexData, const std::vector<glm::vec2>& a_UVData, const std::vector<glm::vec4>& a_normalData,
+		bool a_calcNormals, unsigned int a_smoothingGroup, OBJVertexWelder* a_welder, std::vector<unsigned int>& a_faceIndices);
+	//Generate normals for the meshes that had faces without them and drop their smoothing groups, on all threads.
+	void GenerateMissingNormals();
+	//Append to m_meshes/m_materials and index the name as it is when added, every addition must go through these.
+	void AddMesh(OBJMesh* a_mesh);
+	void AddMaterial(OBJMaterial* a_material);
+	//Copy of a_name in the arena, the name indices are keyed on these so renaming a mesh or material later
+	//does not invalidate them.
+	std::string_view InternName(std::string_view a_name);
 
+	//Owns the meshes, materials, interned names and finished mesh arrays, released together by Unload.
+	OBJArena m_arena;
 	//Vector to store mesh data.
 	std::vector<OBJMesh*> m_meshes;
 	//Vector to store materials.
 	std::vector<OBJMaterial*> m_materials;
+	//Name lookups for GetMeshByName/GetMaterialByName, keyed on interned names.
+	std::unordered_map<std::string_view, OBJMesh*> m_meshesByName;
+	std::unordered_map<std::string_view, OBJMaterial*> m_materialsByName;
 	//Path to model data - useful for things like texture lookups.
 	std::string m_path;
 	//Filename.
 	std::string m_modelName;
 	//Root Mat4 (World Matrix);
 	glm::mat4 m_worldMatrix;
+	//Union of the mesh bounds.
+	OBJBounds m_bounds;
+	//Every material library read for this model, the cache checks these have not changed.
+	std::vector<std::string> m_materialLibraries;
+	//Flags passed to the current Load call.
+	unsigned int m_loadFlags;
+	//Progress of the load running in LoadAsync, null otherwise.
+	OBJLoadProgress* m_progress;
+	//Position snapping distance for LOAD_WELD_POSITIONS.
+	float m_weldTolerance;
+	//Owned, see GetBvh.
+	OBJBvh* m_bvh;
 };
\ No newline at end of file
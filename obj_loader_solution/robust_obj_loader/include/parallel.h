@@ -0,0 +1,58 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+//Small helpers for spreading loader work across the available cores.
+class Parallel
+{
+public:
+	//Number of worker threads to use, never less than one.
+	static unsigned int GetThreadCount();
+	//Call a_function(i) for every i in [0, a_count), items are handed out dynamically so uneven work balances itself.
+	template<typename Function>
+	static void For(size_t a_count, Function a_function);
+};
+
+inline unsigned int Parallel::GetThreadCount()
+{
+	//Asking the OS is a file read on some platforms, and small meshes call this many times over.
+	static const unsigned int s_threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	return s_threadCount;
+}
+
+template<typename Function>
+inline void Parallel::For(size_t a_count, Function a_function)
+{
+	size_t threadCount = std::min<size_t>(GetThreadCount(), a_count);
+	if (threadCount <= 1)
+	{
+		for (size_t i = 0; i < a_count; i++)
+		{
+			a_function(i);
+		}
+		return;
+	}
+	std::atomic<size_t> nextItem(0);
+	auto worker = [&]()
+	{
+		for (size_t i = nextItem++; i < a_count; i = nextItem++)
+		{
+			a_function(i);
+		}
+	};
+	//The calling thread does its share of the work too.
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount - 1);
+	for (size_t t = 1; t < threadCount; t++)
+	{
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+}
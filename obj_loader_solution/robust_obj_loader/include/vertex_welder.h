@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//An open addressing hash table used to collapse face corners that share the same
+//vertex data into a single mesh vertex while faces are being assembled.
+class OBJVertexWelder
+{
+public:
+	//Corners weld when their keys match, x/y/z hold either the position index or a quantized position.
+	struct Key
+	{
+		int32_t x;
+		int32_t y;
+		int32_t z;
+		int32_t vt;
+		int32_t vn;
+
+		bool operator == (const Key& a_rhs) const;
+	};
+
+	OBJVertexWelder();
+	~OBJVertexWelder() {};
+
+	//Forget every key, keeping the table's memory unless it is far larger than it needs to be.
+	void Clear();
+	//Returns true and sets a_index if the key is already in the table, otherwise stores a_newIndex for it and returns false.
+	bool FindOrInsert(const Key& a_key, unsigned int a_newIndex, unsigned int& a_index);
+	size_t GetCount() const { return m_count; }
+	//Size the table for a_count keys up front so filling it never has to rehash.
+	void Reserve(size_t a_count);
+
+private:
+	static uint64_t Hash(const Key& a_key);
+	void Grow();
+
+	std::vector<Key> m_keys;
+	std::vector<unsigned int> m_values;
+	size_t m_count;
+	size_t m_mask;
+};
+
+inline bool OBJVertexWelder::Key::operator==(const Key& a_rhs) const
+{
+	return x == a_rhs.x && y == a_rhs.y && z == a_rhs.z && vt == a_rhs.vt && vn == a_rhs.vn;
+}
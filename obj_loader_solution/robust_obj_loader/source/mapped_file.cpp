@@ -0,0 +1,163 @@
+#include "mapped_file.h"
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile() : m_data(nullptr), m_size(0), m_mapped(false), m_buffer(), m_fileHandle(INVALID_HANDLE_VALUE), m_mappingHandle(nullptr) {}
+#else
+MappedFile::MappedFile() : m_data(nullptr), m_size(0), m_mapped(false), m_buffer(), m_fileDescriptor(-1) {}
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const char* a_filename, bool a_useMapping)
+{
+	Close();
+	if (a_useMapping && MapFile(a_filename))
+	{
+		return true;
+	}
+	//Either mapping was not requested or the platform refused it, fall back to a single read.
+	return ReadIntoBuffer(a_filename);
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (m_mapped && m_data != nullptr)
+	{
+		UnmapViewOfFile(m_data);
+	}
+	if (m_mappingHandle != nullptr)
+	{
+		CloseHandle(m_mappingHandle);
+		m_mappingHandle = nullptr;
+	}
+	if (m_fileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_fileHandle);
+		m_fileHandle = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (m_mapped && m_data != nullptr)
+	{
+		munmap(const_cast<char*>(m_data), m_size);
+	}
+	if (m_fileDescriptor != -1)
+	{
+		close(m_fileDescriptor);
+		m_fileDescriptor = -1;
+	}
+#endif
+	m_buffer.clear();
+	m_buffer.shrink_to_fit();
+	m_data = nullptr;
+	m_size = 0;
+	m_mapped = false;
+}
+
+bool MappedFile::MapFile(const char* a_filename)
+{
+#ifdef _WIN32
+	//FILE_FLAG_SEQUENTIAL_SCAN tells the cache manager to read ahead aggressively and drop pages behind us.
+	m_fileHandle = CreateFileA(a_filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_fileHandle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	//Zero length files cannot be mapped, let the caller handle them through the read path.
+	if (!GetFileSizeEx(m_fileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+	m_mappingHandle = CreateFileMappingA(m_fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mappingHandle == nullptr)
+	{
+		Close();
+		return false;
+	}
+	const void* view = MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr)
+	{
+		Close();
+		return false;
+	}
+	m_data = static_cast<const char*>(view);
+	m_size = static_cast<size_t>(fileSize.QuadPart);
+#else
+	m_fileDescriptor = open(a_filename, O_RDONLY);
+	if (m_fileDescriptor == -1)
+	{
+		return false;
+	}
+	struct stat fileStat;
+	//Directories open fine with O_RDONLY but cannot be mapped or read as a model.
+	if (fstat(m_fileDescriptor, &fileStat) != 0 || !S_ISREG(fileStat.st_mode) || fileStat.st_size == 0)
+	{
+		Close();
+		return false;
+	}
+	void* view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+	if (view == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+	//We parse front to back exactly once so ask the kernel to read ahead and not keep pages around.
+	//Advice values are not flags, each one needs its own call.
+	madvise(view, static_cast<size_t>(fileStat.st_size), MADV_SEQUENTIAL);
+	madvise(view, static_cast<size_t>(fileStat.st_size), MADV_WILLNEED);
+	m_data = static_cast<const char*>(view);
+	m_size = static_cast<size_t>(fileStat.st_size);
+#endif
+	m_mapped = true;
+	return true;
+}
+
+bool MappedFile::ReadIntoBuffer(const char* a_filename)
+{
+	//An ifstream will happily open a directory and report a nonsense size for it, only accept real files.
+	std::error_code error;
+	if (!std::filesystem::is_regular_file(a_filename, error))
+	{
+		return false;
+	}
+	std::ifstream file(a_filename, std::ios_base::in | std::ios_base::binary | std::ios_base::ate);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	//Opened at the end so tellg gives us the file size without reading through the file.
+	std::streamoff fileSize = file.tellg();
+	if (fileSize <= 0 || !file.seekg(0, std::ios_base::beg))
+	{
+		return false;
+	}
+	m_buffer.resize(static_cast<size_t>(fileSize));
+	//A short read is fine (the file may have shrunk), anything else is a read error.
+	if (!file.read(m_buffer.data(), fileSize) && !file.eof())
+	{
+		m_buffer.clear();
+		return false;
+	}
+	m_data = m_buffer.data();
+	m_size = static_cast<size_t>(file.gcount());
+	return true;
+}
@@ -0,0 +1,118 @@
+#include "number_parser.h"
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+//Powers of ten that are exactly representable as a double.
+static const double s_exactPowersOfTen[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+//Largest integer a double mantissa can hold without rounding (2^53).
+static const uint64_t s_maxExactMantissa = uint64_t(1) << 53;
+
+const char* NumberParser::ParseFloat(const char* a_first, const char* a_last, float& a_value)
+{
+	const char* p = a_first;
+	bool negative = false;
+	if (p < a_last && (*p == '-' || *p == '+'))
+	{
+		negative = (*p == '-');
+		++p;
+	}
+	//std::from_chars does not accept a leading '+', keep the sign for the fallback only if it is a '-'.
+	const char* fallbackStart = negative ? a_first : p;
+
+	//Gather the decimal digits into an integer mantissa and a base ten exponent.
+	uint64_t mantissa = 0;
+	int significantDigits = 0;
+	int exponent = 0;
+	bool anyDigits = false;
+	while (p < a_last && (unsigned char)(*p - '0') < 10)
+	{
+		if (mantissa != 0 || *p != '0') { significantDigits++; }
+		mantissa = mantissa * 10 + (*p - '0');
+		anyDigits = true;
+		++p;
+		if (significantDigits > 19) { break; }
+	}
+	if (p < a_last && *p == '.' && significantDigits <= 19)
+	{
+		++p;
+		while (p < a_last && (unsigned char)(*p - '0') < 10)
+		{
+			if (mantissa != 0 || *p != '0') { significantDigits++; }
+			mantissa = mantissa * 10 + (*p - '0');
+			exponent--;
+			anyDigits = true;
+			++p;
+			if (significantDigits > 19) { break; }
+		}
+	}
+	if (!anyDigits)
+	{
+		//Could be inf/nan or garbage, let the standard parser decide.
+		float value = 0.0f;
+		std::from_chars_result result = std::from_chars(fallbackStart, a_last, value);
+		if (result.ec != std::errc()) { return a_first; }
+		a_value = value;
+		return result.ptr;
+	}
+	if (significantDigits <= 19 && p < a_last && (*p == 'e' || *p == 'E'))
+	{
+		const char* e = p + 1;
+		bool negativeExponent = false;
+		if (e < a_last && (*e == '-' || *e == '+'))
+		{
+			negativeExponent = (*e == '-');
+			++e;
+		}
+		if (e < a_last && (unsigned char)(*e - '0') < 10)
+		{
+			int explicitExponent = 0;
+			while (e < a_last && (unsigned char)(*e - '0') < 10)
+			{
+				//Clamp so absurd exponents can not overflow, they will take the fallback path anyway.
+				if (explicitExponent < 10000) { explicitExponent = explicitExponent * 10 + (*e - '0'); }
+				++e;
+			}
+			exponent += negativeExponent ? -explicitExponent : explicitExponent;
+			p = e;
+		}
+	}
+
+	//Fast path (Clinger): both the mantissa and the power of ten are exact doubles, so a single
+	//multiply or divide gives the correctly rounded double. Narrowing that to float is only
+	//unsafe when the double sits exactly on a float rounding midpoint, those few take the fallback.
+	if (significantDigits <= 19 && mantissa <= s_maxExactMantissa && exponent >= -22 && exponent <= 22)
+	{
+		double value = (double)mantissa;
+		value = (exponent < 0) ? value / s_exactPowersOfTen[-exponent] : value * s_exactPowersOfTen[exponent];
+		uint64_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		//The 29 mantissa bits dropped when narrowing to float, 1 followed by zeros is a midpoint.
+		if ((bits & 0x1FFFFFFF) != 0x10000000)
+		{
+			a_value = negative ? -(float)value : (float)value;
+			return p;
+		}
+	}
+	if (mantissa == 0 && significantDigits == 0)
+	{
+		a_value = negative ? -0.0f : 0.0f;
+		return p;
+	}
+
+	//Long mantissas or large exponents, hand over to the exact standard parser.
+	float value = 0.0f;
+	std::from_chars_result result = std::from_chars(fallbackStart, a_last, value);
+	if (result.ec == std::errc::result_out_of_range)
+	{
+		//from_chars leaves the value untouched on range errors, match strtof and saturate/flush instead.
+		a_value = (exponent > 0) ? (negative ? -HUGE_VALF : HUGE_VALF) : (negative ? -0.0f : 0.0f);
+		return result.ptr;
+	}
+	if (result.ec != std::errc()) { return a_first; }
+	a_value = value;
+	return result.ptr;
+}
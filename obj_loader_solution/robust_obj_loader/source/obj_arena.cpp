@@ -0,0 +1,175 @@
+#include "obj_arena.h"
+#include <algorithm>
+#include <cstdint>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+//Smallest block taken from the OS, later blocks grow with the arena so a big model needs only a few.
+static const size_t s_minimumBlockSize = 1 << 20;
+//Huge page size blocks are rounded to, 2MB on both x64 platforms.
+static const size_t s_hugePageSize = 2 << 20;
+
+OBJArena::OBJArena() : m_blocks(nullptr), m_bytesUsed(0), m_bytesReserved(0), m_useHugePages(false), m_mutex() {}
+
+OBJArena::~OBJArena()
+{
+	Release();
+}
+
+void* OBJArena::Allocate(size_t a_size, size_t a_alignment)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Block* block = m_blocks;
+	uintptr_t base = (uintptr_t)block;
+	uintptr_t start = 0;
+	if (block != nullptr)
+	{
+		start = (base + block->used + a_alignment - 1) & ~(uintptr_t)(a_alignment - 1);
+	}
+	if (block == nullptr || start + a_size > base + block->size)
+	{
+		block = AllocateBlock(sizeof(Block) + a_size + a_alignment);
+		if (block == nullptr)
+		{
+			throw std::bad_alloc();
+		}
+		base = (uintptr_t)block;
+		start = (base + block->used + a_alignment - 1) & ~(uintptr_t)(a_alignment - 1);
+	}
+	size_t used = (size_t)(start + a_size - base);
+	m_bytesUsed += used - block->used;
+	block->used = used;
+	return (void*)start;
+}
+
+void OBJArena::Free(void* a_memory, size_t a_size)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Block* block = m_blocks;
+	if (block != nullptr && (uintptr_t)a_memory + a_size == (uintptr_t)block + block->used)
+	{
+		size_t used = (size_t)((uintptr_t)a_memory - (uintptr_t)block);
+		m_bytesUsed -= block->used - used;
+		block->used = used;
+	}
+}
+
+void OBJArena::Reset()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Block* largest = m_blocks;
+	for (Block* block = m_blocks; block != nullptr; block = block->next)
+	{
+		largest = (block->size > largest->size) ? block : largest;
+	}
+	while (m_blocks != nullptr)
+	{
+		Block* next = m_blocks->next;
+		if (m_blocks != largest)
+		{
+			m_bytesReserved -= m_blocks->size;
+			FreeBlock(m_blocks);
+		}
+		m_blocks = next;
+	}
+	m_blocks = largest;
+	if (largest != nullptr)
+	{
+		largest->next = nullptr;
+		largest->used = sizeof(Block);
+	}
+	m_bytesUsed = 0;
+}
+
+void OBJArena::Release()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	while (m_blocks != nullptr)
+	{
+		Block* next = m_blocks->next;
+		FreeBlock(m_blocks);
+		m_blocks = next;
+	}
+	m_bytesUsed = 0;
+	m_bytesReserved = 0;
+}
+
+OBJArena::Block* OBJArena::AllocateBlock(size_t a_minimumSize)
+{
+	//Grow geometrically so the block count stays logarithmic in the model size.
+	size_t size = std::max(std::max(a_minimumSize, s_minimumBlockSize), m_bytesReserved);
+	size = (size + s_hugePageSize - 1) & ~(s_hugePageSize - 1);
+	void* memory = nullptr;
+#ifdef _WIN32
+	if (m_useHugePages)
+	{
+		//Large pages need the "Lock pages in memory" privilege, without it this fails and normal pages are used.
+		size_t largePage = GetLargePageMinimum();
+		if (largePage > 0)
+		{
+			size_t largeSize = (size + largePage - 1) & ~(largePage - 1);
+			memory = VirtualAlloc(nullptr, largeSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+			if (memory != nullptr)
+			{
+				size = largeSize;
+			}
+		}
+	}
+	if (memory == nullptr)
+	{
+		memory = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	}
+#else
+	if (m_useHugePages)
+	{
+#ifdef MAP_HUGETLB
+		//Explicit huge pages only work if the system has some reserved, otherwise ask for transparent ones below.
+		memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (memory == MAP_FAILED)
+		{
+			memory = nullptr;
+		}
+#endif
+	}
+	if (memory == nullptr)
+	{
+		memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (memory == MAP_FAILED)
+		{
+			return nullptr;
+		}
+#ifdef MADV_HUGEPAGE
+		if (m_useHugePages)
+		{
+			madvise(memory, size, MADV_HUGEPAGE);
+		}
+#endif
+	}
+#endif
+	if (memory == nullptr)
+	{
+		return nullptr;
+	}
+	Block* block = (Block*)memory;
+	block->next = m_blocks;
+	block->size = size;
+	block->used = sizeof(Block);
+	m_blocks = block;
+	m_bytesReserved += size;
+	return block;
+}
+
+void OBJArena::FreeBlock(Block* a_block)
+{
+#ifdef _WIN32
+	VirtualFree(a_block, 0, MEM_RELEASE);
+#else
+	munmap(a_block, a_block->size);
+#endif
+}
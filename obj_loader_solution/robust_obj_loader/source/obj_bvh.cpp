@@ -0,0 +1,585 @@
+#include "obj_bvh.h"
+#include "parallel.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+//OBJBvh construction and queries.
+//Each node is split by binning its triangle centroids along every axis and taking the plane with the lowest
+//surface area heuristic cost. The first few levels are built one node at a time with the binning spread across
+//threads, then the remaining subtrees are built in parallel, one thread each, and appended to the node array.
+
+static const unsigned int s_binCount = 16;
+//Largest leaf, a node is only left bigger than this when its triangles cannot be told apart.
+static const unsigned int s_maxLeafTriangles = 8;
+//Cost of visiting a node relative to testing one triangle.
+static const float s_traversalCost = 1.0f;
+//Ranges with at least this many triangles are binned in blocks on all threads.
+static const size_t s_parallelBlockSize = 1 << 16;
+//Subtrees handed to threads once the top of the tree is built.
+static const size_t s_subtreesPerThread = 4;
+static const size_t s_minSubtreeTriangles = 1 << 12;
+//Only the first s_sahDepth levels use the heuristic, deeper ranges are halved, so no path from the root is longer
+//than s_maxDepth nodes and the fixed size query stacks cannot overflow.
+static const unsigned int s_sahDepth = 32;
+static const unsigned int s_maxDepth = 64;
+
+namespace
+{
+	//Triangles still to be split into nodes, first and count index the build's primitives.
+	struct OBJBvhRange
+	{
+		unsigned int node;
+		unsigned int first;
+		unsigned int count;
+		unsigned int depth;
+		OBJBounds centroids;
+	};
+
+	struct OBJBvhBin
+	{
+		OBJBounds bounds;
+		OBJBounds centroids;
+		unsigned int count = 0;
+
+		void Add(const OBJBvhBin& a_bin) { bounds.Add(a_bin.bounds); centroids.Add(a_bin.centroids); count += a_bin.count; }
+	};
+	typedef std::array<OBJBvhBin, s_binCount * 3> OBJBvhBins;
+
+	//A triangle's bounds, ranges are partitioned by moving these so each range's triangles stay together in memory.
+	struct OBJBvhPrimitive
+	{
+		glm::vec3 minimum;
+		unsigned int triangle;
+		glm::vec3 maximum;
+		unsigned int padding;
+
+		glm::vec3 GetCentroid() const { return (minimum + maximum) * 0.5f; }
+	};
+
+	struct OBJBvhBuildData
+	{
+		std::vector<OBJBvhPrimitive> primitives;
+	};
+}
+
+static float SurfaceArea(const OBJBounds& a_bounds)
+{
+	if (a_bounds.IsEmpty())
+	{
+		return 0.0f;
+	}
+	glm::vec3 size = a_bounds.maximum - a_bounds.minimum;
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static bool BoundsOverlap(const glm::vec3& a_minimumA, const glm::vec3& a_maximumA, const glm::vec3& a_minimumB, const glm::vec3& a_maximumB)
+{
+	return a_minimumA.x <= a_maximumB.x && a_minimumB.x <= a_maximumA.x &&
+		a_minimumA.y <= a_maximumB.y && a_minimumB.y <= a_maximumA.y &&
+		a_minimumA.z <= a_maximumB.z && a_minimumB.z <= a_maximumA.z;
+}
+
+//Bounds and centroid bounds of the primitives [a_first, a_first + a_count).
+static OBJBvhBin MeasureRange(const OBJBvhBuildData& a_data, unsigned int a_first, unsigned int a_count, bool a_parallel)
+{
+	size_t blockCount = a_parallel ? (a_count + s_parallelBlockSize - 1) / s_parallelBlockSize : 1;
+	std::vector<OBJBvhBin> blocks(blockCount);
+	auto measure = [&](size_t a_block)
+	{
+		size_t begin = a_first + a_block * s_parallelBlockSize;
+		size_t end = (blockCount == 1) ? a_first + a_count : std::min<size_t>(a_first + a_count, begin + s_parallelBlockSize);
+		for (size_t i = begin; i < end; i++)
+		{
+			const OBJBvhPrimitive& primitive = a_data.primitives[i];
+			blocks[a_block].bounds.Add(primitive.minimum);
+			blocks[a_block].bounds.Add(primitive.maximum);
+			blocks[a_block].centroids.Add(primitive.GetCentroid());
+		}
+		blocks[a_block].count = (unsigned int)(end - begin);
+	};
+	if (blockCount > 1)
+	{
+		Parallel::For(blockCount, measure);
+	}
+	else
+	{
+		measure(0);
+	}
+	for (size_t b = 1; b < blockCount; b++)
+	{
+		blocks[0].Add(blocks[b]);
+	}
+	return blocks[0];
+}
+
+//Split a range of triangles. On success the range is reordered so the left child's triangles come first and
+//a_left/a_right describe the children, returns false if the triangles are cheaper to test as a leaf.
+static bool SplitRange(OBJBvhBuildData& a_data, const OBJBounds& a_bounds, const OBJBvhRange& a_range, bool a_parallel,
+	OBJBvhRange& a_left, OBJBounds& a_leftBounds, OBJBvhRange& a_right, OBJBounds& a_rightBounds)
+{
+	if (a_range.count <= 1)
+	{
+		return false;
+	}
+	glm::vec3 centroidMinimum = a_range.centroids.minimum;
+	glm::vec3 extent = a_range.centroids.maximum - centroidMinimum;
+	glm::vec3 binScale = glm::vec3(0.0f);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		binScale[axis] = (extent[axis] > 0.0f) ? s_binCount / extent[axis] : 0.0f;
+	}
+	auto binOf = [&](const glm::vec3& a_centroid, int a_axis)
+	{
+		return std::min((unsigned int)((a_centroid[a_axis] - centroidMinimum[a_axis]) * binScale[a_axis]), s_binCount - 1);
+	};
+
+	int bestAxis = -1;
+	unsigned int bestBin = 0;
+	OBJBvhBin bestLeft;
+	OBJBvhBin bestRight;
+	if (a_range.depth < s_sahDepth && extent != glm::vec3(0.0f))
+	{
+		size_t blockCount = a_parallel ? (a_range.count + s_parallelBlockSize - 1) / s_parallelBlockSize : 1;
+		OBJBvhBins bins;
+		auto bin = [&](size_t a_block, OBJBvhBins& a_bins)
+		{
+			size_t begin = a_range.first + a_block * s_parallelBlockSize;
+			size_t end = (blockCount == 1) ? a_range.first + a_range.count : std::min<size_t>(a_range.first + a_range.count, begin + s_parallelBlockSize);
+			for (size_t i = begin; i < end; i++)
+			{
+				const OBJBvhPrimitive& primitive = a_data.primitives[i];
+				glm::vec3 centroid = primitive.GetCentroid();
+				//Only the bounds are binned, the children's centroid bounds are gathered while partitioning.
+				for (int axis = 0; axis < 3; axis++)
+				{
+					OBJBvhBin& target = a_bins[axis * s_binCount + binOf(centroid, axis)];
+					target.bounds.minimum = glm::min(target.bounds.minimum, primitive.minimum);
+					target.bounds.maximum = glm::max(target.bounds.maximum, primitive.maximum);
+					target.count++;
+				}
+			}
+		};
+		if (blockCount > 1)
+		{
+			std::vector<OBJBvhBins> blocks(blockCount);
+			Parallel::For(blockCount, [&](size_t a_block) { bin(a_block, blocks[a_block]); });
+			for (const OBJBvhBins& block : blocks)
+			{
+				for (size_t i = 0; i < bins.size(); i++)
+				{
+					bins[i].Add(block[i]);
+				}
+			}
+		}
+		else
+		{
+			bin(0, bins);
+		}
+
+		//Sweep the planes between bins, the right hand sides are summed first so each plane costs O(1).
+		float parentArea = std::max(SurfaceArea(a_bounds), FLT_MIN);
+		float bestCost = FLT_MAX;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (extent[axis] <= 0.0f)
+			{
+				continue;
+			}
+			const OBJBvhBin* axisBins = &bins[axis * s_binCount];
+			float rightArea[s_binCount];
+			unsigned int rightCount[s_binCount];
+			OBJBvhBin right;
+			for (unsigned int b = s_binCount - 1; b > 0; b--)
+			{
+				right.Add(axisBins[b]);
+				rightArea[b] = SurfaceArea(right.bounds);
+				rightCount[b] = right.count;
+			}
+			OBJBvhBin left;
+			for (unsigned int b = 1; b < s_binCount; b++)
+			{
+				left.Add(axisBins[b - 1]);
+				if (left.count == 0 || rightCount[b] == 0)
+				{
+					continue;
+				}
+				float cost = s_traversalCost + (SurfaceArea(left.bounds) * left.count + rightArea[b] * rightCount[b]) / parentArea;
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = b;
+				}
+			}
+		}
+		for (unsigned int b = 0; bestAxis >= 0 && b < s_binCount; b++)
+		{
+			(b < bestBin ? bestLeft : bestRight).bounds.Add(bins[bestAxis * s_binCount + b].bounds);
+		}
+		if (bestAxis >= 0 && bestCost >= a_range.count && a_range.count <= s_maxLeafTriangles)
+		{
+			return false;
+		}
+	}
+	else if (a_range.count <= s_maxLeafTriangles)
+	{
+		return false;
+	}
+
+	OBJBvhPrimitive* primitives = a_data.primitives.data() + a_range.first;
+	unsigned int leftCount = 0;
+	if (bestAxis >= 0)
+	{
+		OBJBvhPrimitive* middle = primitives;
+		OBJBvhPrimitive* end = primitives + a_range.count;
+		while (middle < end)
+		{
+			glm::vec3 centroid = middle->GetCentroid();
+			if (binOf(centroid, bestAxis) < bestBin)
+			{
+				bestLeft.centroids.Add(centroid);
+				middle++;
+			}
+			else
+			{
+				bestRight.centroids.Add(centroid);
+				std::swap(*middle, *--end);
+			}
+		}
+		leftCount = (unsigned int)(middle - primitives);
+	}
+	else
+	{
+		//Every centroid is in the same place, or the tree is too deep for the heuristic, so halve the range.
+		leftCount = a_range.count / 2;
+		bestLeft = MeasureRange(a_data, a_range.first, leftCount, a_parallel);
+		bestRight = MeasureRange(a_data, a_range.first + leftCount, a_range.count - leftCount, a_parallel);
+	}
+	a_left = { 0, a_range.first, leftCount, a_range.depth + 1, bestLeft.centroids };
+	a_right = { 0, a_range.first + leftCount, a_range.count - leftCount, a_range.depth + 1, bestRight.centroids };
+	a_leftBounds = bestLeft.bounds;
+	a_rightBounds = bestRight.bounds;
+	return true;
+}
+
+//Split the ranges on a_stack into nodes of a_nodes until only leaves are left. With a_deferred, ranges of no more
+//than a_deferCount triangles are moved there instead of being split.
+static void BuildNodes(OBJBvhBuildData& a_data, std::vector<OBJBvhNode>& a_nodes, std::vector<OBJBvhRange>& a_stack, bool a_parallel,
+	size_t a_deferCount, std::vector<OBJBvhRange>* a_deferred)
+{
+	while (!a_stack.empty())
+	{
+		OBJBvhRange range = a_stack.back();
+		a_stack.pop_back();
+		if (a_deferred != nullptr && range.count <= a_deferCount)
+		{
+			a_deferred->push_back(range);
+			continue;
+		}
+		OBJBounds bounds;
+		bounds.minimum = a_nodes[range.node].minimum;
+		bounds.maximum = a_nodes[range.node].maximum;
+		OBJBvhRange left;
+		OBJBvhRange right;
+		OBJBounds leftBounds;
+		OBJBounds rightBounds;
+		if (!SplitRange(a_data, bounds, range, a_parallel, left, leftBounds, right, rightBounds))
+		{
+			a_nodes[range.node].first = range.first;
+			a_nodes[range.node].count = range.count;
+			continue;
+		}
+		unsigned int child = (unsigned int)a_nodes.size();
+		a_nodes[range.node].first = child;
+		a_nodes[range.node].count = 0;
+		a_nodes.push_back({ leftBounds.minimum, 0, leftBounds.maximum, 0 });
+		a_nodes.push_back({ rightBounds.minimum, 0, rightBounds.maximum, 0 });
+		left.node = child;
+		right.node = child + 1;
+		//Left last so it is split next and the tree is laid out depth first.
+		a_stack.push_back(right);
+		a_stack.push_back(left);
+	}
+}
+
+void OBJBvh::Clear()
+{
+	std::vector<OBJBvhNode>().swap(m_nodes);
+	std::vector<Triangle>().swap(m_triangles);
+	std::vector<OBJTriangleRef>().swap(m_triangleRefs);
+}
+
+bool OBJBvh::IsWellFormed() const
+{
+	if (m_triangleRefs.size() != m_triangles.size())
+	{
+		return false;
+	}
+	std::vector<unsigned int> depths(m_nodes.size(), 0);
+	for (size_t n = 0; n < m_nodes.size(); n++)
+	{
+		const OBJBvhNode& node = m_nodes[n];
+		if (node.count > 0)
+		{
+			if ((size_t)node.first + node.count > m_triangles.size())
+			{
+				return false;
+			}
+		}
+		else
+		{
+			if (node.first <= n || (size_t)node.first + 1 >= m_nodes.size() || depths[n] + 1 >= s_maxDepth)
+			{
+				return false;
+			}
+			//Children come after their parent so a node's depth is final by the time it is checked.
+			depths[node.first] = std::max(depths[node.first], depths[n] + 1);
+			depths[node.first + 1] = std::max(depths[node.first + 1], depths[n] + 1);
+		}
+	}
+	return true;
+}
+
+void OBJBvh::Build(OBJModel& a_model)
+{
+	Clear();
+	unsigned int meshCount = a_model.GetMeshCount();
+	std::vector<std::vector<unsigned int>> meshIndices(meshCount);
+	Parallel::For(meshCount, [&](size_t m)
+	{
+		a_model.GetMeshByIndex((unsigned int)m)->GetIndices(meshIndices[m]);
+	});
+	std::vector<size_t> meshTriangleStart(meshCount + 1, 0);
+	for (unsigned int m = 0; m < meshCount; m++)
+	{
+		meshTriangleStart[m + 1] = meshTriangleStart[m] + meshIndices[m].size() / 3;
+	}
+	size_t triangleCount = meshTriangleStart[meshCount];
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	//Fetch every triangle once, positions are decoded here so the queries never need to know the vertex layout.
+	OBJBvhBuildData data;
+	data.primitives.resize(triangleCount);
+	std::vector<Triangle> triangles(triangleCount);
+	std::vector<OBJTriangleRef> triangleRefs(triangleCount);
+	size_t blockCount = (triangleCount + s_parallelBlockSize - 1) / s_parallelBlockSize;
+	Parallel::For(blockCount, [&](size_t a_block)
+	{
+		size_t begin = a_block * s_parallelBlockSize;
+		size_t end = std::min(triangleCount, begin + s_parallelBlockSize);
+		unsigned int m = (unsigned int)(std::upper_bound(meshTriangleStart.begin(), meshTriangleStart.end(), begin) - meshTriangleStart.begin() - 1);
+		for (size_t t = begin; t < end; t++)
+		{
+			while (t >= meshTriangleStart[m + 1])
+			{
+				m++;
+			}
+			const OBJMesh* mesh = a_model.GetMeshByIndex(m);
+			unsigned int triangle = (unsigned int)(t - meshTriangleStart[m]);
+			const unsigned int* indices = &meshIndices[m][triangle * 3];
+			glm::vec3 a = mesh->GetVertexPosition(indices[0]);
+			glm::vec3 b = mesh->GetVertexPosition(indices[1]);
+			glm::vec3 c = mesh->GetVertexPosition(indices[2]);
+			triangles[t] = { a, b - a, c - a };
+			triangleRefs[t] = { m, triangle };
+			data.primitives[t] = { glm::min(a, glm::min(b, c)), (unsigned int)t, glm::max(a, glm::max(b, c)), 0 };
+		}
+	});
+	std::vector<std::vector<unsigned int>>().swap(meshIndices);
+
+	//Build the top of the tree node by node with parallel binning, until the ranges are small enough to give each to a thread.
+	OBJBvhBin root = MeasureRange(data, 0, (unsigned int)triangleCount, true);
+	m_nodes.reserve(triangleCount * 2 / s_maxLeafTriangles + 1);
+	m_nodes.push_back({ root.bounds.minimum, 0, root.bounds.maximum, 0 });
+	size_t subtreeCount = Parallel::GetThreadCount() * s_subtreesPerThread;
+	size_t subtreeTriangles = std::max(s_minSubtreeTriangles, triangleCount / subtreeCount);
+	std::vector<OBJBvhRange> stack;
+	std::vector<OBJBvhRange> subtrees;
+	stack.push_back({ 0, 0, (unsigned int)triangleCount, 0, root.centroids });
+	BuildNodes(data, m_nodes, stack, true, subtreeTriangles, &subtrees);
+
+	//Each subtree is built into its own array with its root copied to the front, then appended to the tree.
+	std::vector<std::vector<OBJBvhNode>> subtreeNodes(subtrees.size());
+	Parallel::For(subtrees.size(), [&](size_t s)
+	{
+		std::vector<OBJBvhNode>& nodes = subtreeNodes[s];
+		nodes.push_back(m_nodes[subtrees[s].node]);
+		std::vector<OBJBvhRange> subtreeStack(1, subtrees[s]);
+		subtreeStack[0].node = 0;
+		BuildNodes(data, nodes, subtreeStack, false, 0, nullptr);
+	});
+	for (size_t s = 0; s < subtrees.size(); s++)
+	{
+		std::vector<OBJBvhNode>& nodes = subtreeNodes[s];
+		unsigned int offset = (unsigned int)m_nodes.size() - 1;
+		for (size_t n = 0; n < nodes.size(); n++)
+		{
+			OBJBvhNode node = nodes[n];
+			if (node.count == 0)
+			{
+				node.first += offset;
+			}
+			if (n == 0)
+			{
+				m_nodes[subtrees[s].node] = node;
+			}
+			else
+			{
+				m_nodes.push_back(node);
+			}
+		}
+		std::vector<OBJBvhNode>().swap(nodes);
+	}
+
+	//Store the triangles in leaf order so a leaf's triangles are contiguous.
+	m_triangles.resize(triangleCount);
+	m_triangleRefs.resize(triangleCount);
+	Parallel::For(blockCount, [&](size_t a_block)
+	{
+		size_t end = std::min(triangleCount, (a_block + 1) * s_parallelBlockSize);
+		for (size_t i = a_block * s_parallelBlockSize; i < end; i++)
+		{
+			m_triangles[i] = triangles[data.primitives[i].triangle];
+			m_triangleRefs[i] = triangleRefs[data.primitives[i].triangle];
+		}
+	});
+}
+
+//Distance along the ray to where it enters the box, FLT_MAX if it misses or only enters beyond a_maxDistance.
+static inline float RayBoxEntry(const OBJBvhNode& a_node, const glm::vec3& a_origin, const glm::vec3& a_inverseDirection, float a_maxDistance)
+{
+	glm::vec3 toMinimum = (a_node.minimum - a_origin) * a_inverseDirection;
+	glm::vec3 toMaximum = (a_node.maximum - a_origin) * a_inverseDirection;
+	glm::vec3 entry = glm::min(toMinimum, toMaximum);
+	glm::vec3 exit = glm::max(toMinimum, toMaximum);
+	float entryDistance = std::max(std::max(entry.x, entry.y), std::max(entry.z, 0.0f));
+	float exitDistance = std::min(std::min(exit.x, exit.y), std::min(exit.z, a_maxDistance));
+	return (entryDistance <= exitDistance) ? entryDistance : FLT_MAX;
+}
+
+bool OBJBvh::Intersect(const glm::vec3& a_origin, const glm::vec3& a_direction, OBJRayHit& a_hit, float a_maxDistance) const
+{
+	glm::vec3 inverseDirection = 1.0f / a_direction;
+	if (m_nodes.empty() || RayBoxEntry(m_nodes[0], a_origin, inverseDirection, a_maxDistance) == FLT_MAX)
+	{
+		return false;
+	}
+	float closest = a_maxDistance;
+	bool found = false;
+	unsigned int stack[s_maxDepth];
+	unsigned int stackSize = 0;
+	unsigned int nodeIndex = 0;
+	while (true)
+	{
+		const OBJBvhNode& node = m_nodes[nodeIndex];
+		if (node.count > 0)
+		{
+			for (unsigned int i = node.first; i < node.first + node.count; i++)
+			{
+				//Moller-Trumbore, both windings count.
+				const Triangle& triangle = m_triangles[i];
+				glm::vec3 p = glm::cross(a_direction, triangle.edgeC);
+				float determinant = glm::dot(triangle.edgeB, p);
+				if (determinant == 0.0f)
+				{
+					continue;
+				}
+				float inverseDeterminant = 1.0f / determinant;
+				glm::vec3 s = a_origin - triangle.corner;
+				float u = glm::dot(s, p) * inverseDeterminant;
+				if (u < 0.0f || u > 1.0f)
+				{
+					continue;
+				}
+				glm::vec3 q = glm::cross(s, triangle.edgeB);
+				float v = glm::dot(a_direction, q) * inverseDeterminant;
+				if (v < 0.0f || u + v > 1.0f)
+				{
+					continue;
+				}
+				float distance = glm::dot(triangle.edgeC, q) * inverseDeterminant;
+				if (distance >= 0.0f && distance < closest)
+				{
+					closest = distance;
+					found = true;
+					a_hit.mesh = m_triangleRefs[i].mesh;
+					a_hit.triangle = m_triangleRefs[i].triangle;
+					a_hit.distance = distance;
+					a_hit.barycentrics = glm::vec2(u, v);
+				}
+			}
+		}
+		else
+		{
+			//Visit the nearer child first and come back for the other only if it could still hold a closer hit.
+			unsigned int nearChild = node.first;
+			unsigned int farChild = node.first + 1;
+			float nearEntry = RayBoxEntry(m_nodes[nearChild], a_origin, inverseDirection, closest);
+			float farEntry = RayBoxEntry(m_nodes[farChild], a_origin, inverseDirection, closest);
+			if (farEntry < nearEntry)
+			{
+				std::swap(nearChild, farChild);
+				std::swap(nearEntry, farEntry);
+			}
+			if (nearEntry != FLT_MAX)
+			{
+				if (farEntry != FLT_MAX)
+				{
+					stack[stackSize++] = farChild;
+				}
+				nodeIndex = nearChild;
+				continue;
+			}
+		}
+		//Pop the next node, skipping any that start beyond the closest hit found since they were pushed.
+		bool popped = false;
+		while (stackSize > 0 && !popped)
+		{
+			nodeIndex = stack[--stackSize];
+			popped = RayBoxEntry(m_nodes[nodeIndex], a_origin, inverseDirection, closest) != FLT_MAX;
+		}
+		if (!popped)
+		{
+			return found;
+		}
+	}
+}
+
+void OBJBvh::Overlap(const OBJBounds& a_bounds, std::vector<OBJTriangleRef>& a_triangles) const
+{
+	if (m_nodes.empty() || a_bounds.IsEmpty())
+	{
+		return;
+	}
+	unsigned int stack[s_maxDepth];
+	unsigned int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const OBJBvhNode& node = m_nodes[stack[--stackSize]];
+		if (!BoundsOverlap(node.minimum, node.maximum, a_bounds.minimum, a_bounds.maximum))
+		{
+			continue;
+		}
+		if (node.count == 0)
+		{
+			stack[stackSize++] = node.first;
+			stack[stackSize++] = node.first + 1;
+			continue;
+		}
+		for (unsigned int i = node.first; i < node.first + node.count; i++)
+		{
+			const Triangle& triangle = m_triangles[i];
+			glm::vec3 b = triangle.corner + triangle.edgeB;
+			glm::vec3 c = triangle.corner + triangle.edgeC;
+			if (BoundsOverlap(glm::min(triangle.corner, glm::min(b, c)), glm::max(triangle.corner, glm::max(b, c)), a_bounds.minimum, a_bounds.maximum))
+			{
+				a_triangles.push_back(m_triangleRefs[i]);
+			}
+		}
+	}
+}
@@ -1,377 +1,670 @@
 #include "obj_loader.h"
+#include "mapped_file.h"
+#include "number_parser.h"
+#include "obj_bvh.h"
+#include "parallel.h"
+#include "vertex_welder.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
-#include <fstream>
-#include <sstream>
+
+//How much of the file is parsed between progress reports.
+const size_t OBJModel::s_progressBlockSize = 256 * 1024;
+//Meshes with at least this many triangles generate their normals on all threads.
+const size_t OBJModel::s_parallelNormalsTriangles = 1 << 14;
 
 void OBJModel::Unload()
 {
+	//Meshes and materials live in the arena, run their destructors before its memory is reused.
+	for (OBJMesh* mesh : m_meshes)
+	{
+		mesh->~OBJMesh();
+	}
+	for (OBJMaterial* material : m_materials)
+	{
+		material->~OBJMaterial();
+	}
 	m_meshes.clear();
+	m_materials.clear();
+	m_meshesByName.clear();
+	m_materialsByName.clear();
+	m_materialLibraries.clear();
+	m_bounds = OBJBounds();
+	delete m_bvh;
+	m_bvh = nullptr;
+	m_arena.Reset();
 }
 
-bool OBJModel::Load(const char* a_filename, float a_scale)
+bool OBJModel::NextLine(const char*& a_cursor, const char* a_end, std::string_view& a_line)
 {
+	if (a_cursor >= a_end)
+	{
+		return false;
+	}
+	const char* lineEnd = static_cast<const char*>(memchr(a_cursor, '\n', a_end - a_cursor));
+	if (lineEnd == nullptr)
+	{
+		lineEnd = a_end;
+	}
+	a_line = std::string_view(a_cursor, lineEnd - a_cursor);
+	if (!a_line.empty() && a_line.back() == '\r')
+	{
+		a_line.remove_suffix(1);
+	}
+	a_cursor = (lineEnd < a_end) ? lineEnd + 1 : a_end;
+	return true;
+}
+
+bool OBJModel::Load(const char* a_filename, float a_scale, unsigned int a_flags)
+{
+	Unload();
+	m_loadFlags = a_flags;
+	m_arena.SetUseHugePages((m_loadFlags & LOAD_HUGE_PAGES) != 0);
+	std::string cachePath = std::string(a_filename) + ".objcache";
+	SetLoadPhase(OBJLoadProgress::PHASE_READING);
+	//The cache holds the finished meshes, there is nothing left to do with them.
+	if ((m_loadFlags & LOAD_USE_CACHE) && LoadCache(cachePath, a_filename, a_scale))
+	{
+		std::cout << "Loaded model from cache: " << cachePath << std::endl;
+		return true;
+	}
+	if (IsLoadCancelled())
+	{
+		std::cout << "Load cancelled: " << a_filename << std::endl;
+		Unload();
+		return false;
+	}
 	std::cout << "Attempting to open file: " << a_filename << std::endl;
-	//Get an fstream to read in the file data.
-	std::fstream file;
-	file.open(a_filename, std::ios_base::in | std::ios_base::binary);
-	//test to see if the file has opened in correctly.
-	if (file.is_open())
-	{
-		std::cout << "\nSuccessfully Opened file: " << a_filename << std::endl;
-		//Success file has been opened, verify contents of the file -- ie check that file is not zero length.
-		file.ignore(std::numeric_limits<std::streamsize>::max());//Attempt to read the highest number of bytes from the file.
-		std::streamsize fileSize = file.gcount(); //gCount will have reach EOF marker, letting us know number of bytes.
-		file.clear(); //Clear EOF marker from being read.
-		file.seekg(0, std::ios_base::beg); //Seek back to begging of the file.
-		if (fileSize == 0)
-		{
-			std::cout << "File contains no data, closing file!!" << std::endl;
-			file.close();
-		}
-		std::cout << "File Size: " << fileSize / (float)1024 << "KB" << std::endl;
-
-		OBJMesh* currentMesh = nullptr;
-		std::string fileLine;
-		std::vector<glm::vec4> vertexData;
-		std::vector<glm::vec4> normalData;
-		std::vector<glm::vec2> UVData;
-		//Store out material in a string as face data is not generated prior to material assignment and may not have a mesh.
-		OBJMaterial* currentMtl = nullptr;
-		//Set up reading in chunks of a file at a time.
-		std::cout << "\nPlease wait, processing file may take time!!!" << std::endl;
-		std::string lastDataType = "";
-		while (!file.eof())
-		{
-			if (std::getline(file, fileLine))
+	//Map (or read) the whole file in one go, the parser works directly over these bytes.
+	MappedFile file;
+	if (!file.Open(a_filename, (m_loadFlags & LOAD_MEMORY_MAPPED) != 0))
+	{
+		std::cout << "Could not open file or file contains no data: " << a_filename << std::endl;
+		return false;
+	}
+	std::cout << "\nSuccessfully Opened file: " << a_filename << (file.IsMapped() ? " (memory mapped)" : "") << std::endl;
+	std::cout << "File Size: " << file.GetSize() / (float)1024 << "KB" << std::endl;
+	//Set up reading in chunks of a file at a time.
+	std::cout << "\nPlease wait, processing file may take time!!!" << std::endl;
+	if (m_progress != nullptr)
+	{
+		m_progress->bytesTotal = file.GetSize();
+	}
+	SetLoadPhase(OBJLoadProgress::PHASE_PARSING);
+	bool parsed = (m_loadFlags & LOAD_PARALLEL) ? ParseOBJDataParallel(file.GetData(), file.GetSize(), a_scale) : ParseOBJData(file.GetData(), file.GetSize(), a_scale);
+	file.Close();
+	if (!parsed)
+	{
+		std::cout << "Load cancelled: " << a_filename << std::endl;
+		Unload();
+		return false;
+	}
+	if (!PostProcessMeshes())
+	{
+		std::cout << "Load cancelled: " << a_filename << std::endl;
+		Unload();
+		return false;
+	}
+	if (m_loadFlags & LOAD_USE_CACHE)
+	{
+		SetLoadPhase(OBJLoadProgress::PHASE_CACHING);
+		if (!SaveCache(cachePath, a_filename, a_scale))
+		{
+			std::cout << "Could not write model cache: " << cachePath << std::endl;
+		}
+	}
+	return true;
+}
+
+bool OBJModel::PostProcessMeshes()
+{
+	SetLoadPhase(OBJLoadProgress::PHASE_POSTPROCESSING);
+	//Progress is counted in meshes per pass, so the passes the load flags turn on are counted up front. Normal
+	//generation and the move into the arena always run.
+	unsigned int passCount = 2;
+	passCount += (m_loadFlags & LOAD_GENERATE_TANGENTS) ? 1 : 0;
+	passCount += (m_loadFlags & (LOAD_SPATIAL_SORT | LOAD_OPTIMIZE_VERTEX_CACHE | LOAD_OPTIMIZE_OVERDRAW)) ? 1 : 0;
+	passCount += (m_loadFlags & LOAD_OPTIMIZE_VERTEX_FETCH) ? 1 : 0;
+	passCount += (m_loadFlags & LOAD_SHORT_INDICES) ? 1 : 0;
+	passCount += (m_loadFlags & (LOAD_VERTEX_STREAMS | LOAD_QUANTIZE_VERTICES)) ? 1 : 0;
+	passCount += (m_loadFlags & LOAD_BUILD_MESHLETS) ? 1 : 0;
+	passCount += (m_loadFlags & LOAD_BUILD_LODS) ? 1 : 0;
+	passCount += (m_loadFlags & LOAD_BUILD_BVH) ? 1 : 0;
+	if (m_progress != nullptr)
+	{
+		m_progress->stepsProcessed = 0;
+		m_progress->stepsTotal = (uint64_t)passCount * m_meshes.size();
+	}
+	//Run a_process(m) for every mesh on all cores, returns false once the load has been cancelled. Meshes still
+	//waiting when it is cancelled are skipped, the model is unloaded straight afterwards.
+	auto runPass = [&](auto a_process)
+	{
+		if (IsLoadCancelled())
+		{
+			return false;
+		}
+		Parallel::For(m_meshes.size(), [&](size_t m)
+		{
+			if (!IsLoadCancelled())
 			{
-				if (fileLine.size() > 0)
-				{
-					std::string dataType = LineType(fileLine);
-					//If datatype has a 0 length then skip all tests and continue to next line.
-					if (dataType.length() == 0) { continue; }
-					std::string data = LineData(fileLine);
+				a_process(m);
+			}
+			ReportProcessingProgress(1);
+		});
+		return !IsLoadCancelled();
+	};
 
-					if (dataType == "#") //This is a comment line.
-					{
-						std::cout << data << std::endl;
-						continue;
-					}
-					if (dataType == "mtllib")
-					{
-						std::cout << "Material File: " << data << std::endl;
-						//Load in Material file so that materials can be used as required.
-						LoadMaterialLibrary(data);
-						continue;
-					}
-					if (dataType == "g" || dataType == "o")
-					{
-						std::cout << "OBJ Group Found: " << data << std::endl;
-						//We can use group tags to split our model up into smaller mesh components.
-						if (currentMesh != nullptr)
-						{
-							m_meshes.push_back(currentMesh);
-						}
-						currentMesh = new OBJMesh();
-						currentMesh->m_name = data;
-						if (currentMtl != nullptr) //If we have a material name.
-						{
-							currentMesh->m_material = currentMtl;
-							currentMtl = nullptr;
-						}
-					}
-					if (dataType == "v")
-					{
-						glm::vec4 vertex = ProcessVectorString(data);
-						vertex *= a_scale; //Multiply by passed in vector to allow scaling of the model.
-						vertex.w = 1.0f; //As this is a position data ensure the w comp is set to 1.
-						vertexData.push_back(vertex);
-						continue;
-					}
-					if (dataType == "vt")
-					{
-						glm::vec4 uvCoordv4 = ProcessVectorString(data);
-						glm::vec2 uvCoord = glm::vec2(uvCoordv4.x, uvCoordv4.y);
-						UVData.push_back(uvCoord);
-						continue;
-					}
-					if (dataType == "vn")
-					{
-						glm::vec4 normal = ProcessVectorString(data);
-						normal.w = 0.0f;
-						normalData.push_back(normal);
-						continue;
-					}
-					if (dataType == "f")
-					{
-						if (currentMesh == nullptr) //We have entered processing faces without having hit a '0' or 'g' tag.
-						{
-							currentMesh = new OBJMesh();
-							if (currentMtl != nullptr) //If we have a material name.
-							{
-								currentMesh->m_material = currentMtl;
-								currentMtl = nullptr;
-							}
-						}
-						//Process face data.
-						//Face consists of 3 -> More vertices split at ' ' then at '/' characters.
-						std::vector<std::string> faceData = SplitStringAtCharacter(data, ' ');
-						unsigned int ci = currentMesh->m_vertices.size();
-						for (auto iter = faceData.begin(); iter != faceData.end(); iter++)
-						{
-							//Process face triplet.
-							obj_face_triplet triplet = ProcessTriplet(*iter);
-							//Triplet processed now set Vertex Data from position/normal/texture data.
-							OBJVertex currentVertex;
-							currentVertex.position = vertexData[triplet.v - 1];
-							if (triplet.vn != 0)
-							{
-								currentVertex.normal = normalData[triplet.vn - 1];
-							}
-							if (triplet.vt != 0)
-							{
-								currentVertex.uvcoord = UVData[triplet.vt - 1];
-							}
-							currentMesh->m_vertices.push_back(currentVertex);
-						}
-						//All face information for the tri/quad/fan have been collected.
-						//Time to index these into the current mesh.
-						//Test to see if OBJ file contains normal data if normalData is empty then there are no normals.
-						//normalData.clear(); //ONLY TO TEST. REMOVE LATER TO FIX.
-						//std::cout << "Normal data buffer size: " << normalData.size() << std::endl;
-						bool calcNormals = normalData.empty();
-						for (unsigned int offset = 1; offset < (faceData.size() - 1); offset++)
-						{
-							currentMesh->m_indices.push_back(ci);
-							currentMesh->m_indices.push_back(ci + offset);
-							currentMesh->m_indices.push_back(ci + 1 + offset);
-							if (calcNormals)//If we need to calculate the normals we can do that here.
-							{
-								glm::vec4 normal = currentMesh->CalculateFaceNormal(
-									ci,
-									ci + offset,
-									ci + offset + 1);
-								currentMesh->m_vertices[ci].normal = normal;
-								currentMesh->m_vertices[ci + offset].normal = normal;
-								currentMesh->m_vertices[ci + offset + 1].normal = normal;
-							}
-						}
-					}
-					if (dataType == "usemtl")
-					{
-						//We have a material to use on the current mesh.
-						OBJMaterial* mtl = GetMaterialByName(data.c_str());
-						if (mtl != nullptr)
-						{
-							currentMtl = mtl;
-							if (currentMesh != nullptr)
-							{
-								currentMesh->m_material = currentMtl;
-							}
-						}
-					}
-					lastDataType = dataType;
-				}
+	//Mesh bounds were gathered as the vertices were read, so the model's are just their union.
+	m_bounds = OBJBounds();
+	for (OBJMesh* mesh : m_meshes)
+	{
+		m_bounds.Add(mesh->GetBounds());
+	}
+	if (IsLoadCancelled())
+	{
+		return false;
+	}
+	GenerateMissingNormals();
+	if (m_loadFlags & LOAD_GENERATE_TANGENTS)
+	{
+		//Only normal mapped meshes need tangents, this runs first as it can add vertices and rewrite indices.
+		bool completed = runPass([&](size_t m)
+		{
+			OBJMaterial* material = m_meshes[m]->m_material;
+			if (material != nullptr && !material->textureFileNames[OBJMaterial::NormalTexture].empty())
+			{
+				m_meshes[m]->GenerateTangents();
 			}
+		});
+		if (!completed)
+		{
+			return false;
+		}
+	}
+	if (m_loadFlags & LOAD_SPATIAL_SORT)
+	{
+		bool completed = runPass([&](size_t m)
+		{
+			m_meshes[m]->SortTrianglesSpatially();
+		});
+		if (!completed)
+		{
+			return false;
+		}
+	}
+	else if (m_loadFlags & (LOAD_OPTIMIZE_VERTEX_CACHE | LOAD_OPTIMIZE_OVERDRAW))
+	{
+		bool completed = runPass([&](size_t m)
+		{
+			m_meshes[m]->OptimizeVertexCache();
+			if (m_loadFlags & LOAD_OPTIMIZE_OVERDRAW)
+			{
+				m_meshes[m]->OptimizeOverdraw();
+			}
+		});
+		if (!completed)
+		{
+			return false;
+		}
+	}
+	if ((m_loadFlags & LOAD_OPTIMIZE_VERTEX_FETCH) && !runPass([&](size_t m) { m_meshes[m]->OptimizeVertexFetch(); }))
+	{
+		return false;
+	}
+	if ((m_loadFlags & LOAD_SHORT_INDICES) && !runPass([&](size_t m) { m_meshes[m]->UseShortIndices((m_loadFlags & LOAD_SPLIT_LARGE_MESHES) != 0); }))
+	{
+		return false;
+	}
+	if (m_loadFlags & (LOAD_VERTEX_STREAMS | LOAD_QUANTIZE_VERTICES))
+	{
+		OBJMesh::VertexLayout layout = (m_loadFlags & LOAD_QUANTIZE_VERTICES) ? OBJMesh::LAYOUT_QUANTIZED : OBJMesh::LAYOUT_STREAMS;
+		if (!runPass([&](size_t m) { m_meshes[m]->SetVertexLayout(layout); }))
+		{
+			return false;
 		}
-		if (currentMesh != nullptr)
+	}
+	if ((m_loadFlags & LOAD_BUILD_MESHLETS) && !runPass([&](size_t m) { m_meshes[m]->BuildMeshlets(); }))
+	{
+		return false;
+	}
+	if ((m_loadFlags & LOAD_BUILD_LODS) && !runPass([&](size_t m) { m_meshes[m]->BuildLods(); }))
+	{
+		return false;
+	}
+	//The arrays are final now, pack them into the arena so they are released with it.
+	if (!runPass([&](size_t m) { m_meshes[m]->MoveToArena(m_arena); }))
+	{
+		return false;
+	}
+	if (m_loadFlags & LOAD_BUILD_BVH)
+	{
+		if (IsLoadCancelled())
 		{
-			m_meshes.push_back(currentMesh);
+			return false;
 		}
-		file.close();
+		if (m_bvh == nullptr)
+		{
+			m_bvh = new OBJBvh();
+		}
+		m_bvh->Build(*this);
+		ReportProcessingProgress(m_meshes.size());
+	}
+	return true;
+}
+
+OBJLoadHandle OBJModel::LoadAsync(const char* a_filename, float a_scale, unsigned int a_flags)
+{
+	OBJLoadHandle handle;
+	handle.m_progress = std::make_shared<OBJLoadProgress>();
+	std::shared_ptr<OBJLoadProgress> progress = handle.m_progress;
+	std::string filename = a_filename;
+	handle.m_result = std::async(std::launch::async, [this, progress, filename, a_scale, a_flags]()
+	{
+		m_progress = progress.get();
+		bool loaded = Load(filename.c_str(), a_scale, a_flags);
+		m_progress = nullptr;
+		if (loaded)
+		{
+			progress->bytesProcessed = progress->bytesTotal.load();
+		}
+		progress->phase = loaded ? OBJLoadProgress::PHASE_FINISHED :
+			(progress->cancelRequested ? OBJLoadProgress::PHASE_CANCELLED : OBJLoadProgress::PHASE_FAILED);
+		return loaded;
+	});
+	return handle;
+}
+
+void OBJModel::SetLoadPhase(OBJLoadProgress::Phase a_phase)
+{
+	if (m_progress != nullptr)
+	{
+		m_progress->phase = a_phase;
+	}
+}
+
+bool OBJModel::ReportLoadProgress(size_t a_bytes, size_t a_faces)
+{
+	if (m_progress == nullptr)
+	{
 		return true;
 	}
-	return false;
+	m_progress->bytesProcessed += a_bytes;
+	m_progress->facesParsed += a_faces;
+	return !m_progress->cancelRequested;
 }
 
-glm::vec4 OBJModel::ProcessVectorString(const std::string a_data)
+void OBJModel::ReportProcessingProgress(size_t a_steps)
 {
-	//Split the line data at each space character and store this as a float value within a glm::vec4.
-	std::stringstream iss(a_data);
-	glm::vec4 vecData = glm::vec4(0.0f);
-	int i = 0;
-	for (std::string val; iss >> val; i++)
+	if (m_progress != nullptr)
 	{
-		float fVal = std::stof(val);
-		vecData[i] = fVal;
+		m_progress->stepsProcessed += a_steps;
 	}
-	return vecData;
 }
 
-std::vector<std::string> OBJModel::SplitStringAtCharacter(std::string data, char a_character)
+const char* OBJLoadProgress::GetPhaseName(Phase a_phase)
 {
-	std::vector<std::string> lineData;
-	//Split the line data at each space character and store this as a float value withing a glm::vec4.
-	std::stringstream iss(data);
-	std::string lineSegment;
-	while (std::getline(iss, lineSegment, a_character))
+	switch (a_phase)
 	{
-		lineData.push_back(lineSegment);
+	case PHASE_QUEUED: return "Queued";
+	case PHASE_READING: return "Reading";
+	case PHASE_PARSING: return "Parsing";
+	case PHASE_ASSEMBLING: return "Building meshes";
+	case PHASE_POSTPROCESSING: return "Processing meshes";
+	case PHASE_CACHING: return "Writing cache";
+	case PHASE_FINISHED: return "Finished";
+	case PHASE_CANCELLED: return "Cancelled";
+	case PHASE_FAILED: return "Failed";
+	default: return "";
 	}
-	return lineData;
 }
 
-void OBJModel::LoadMaterialLibrary(std::string a_mtllib)
+bool OBJModel::ParseOBJData(const char* a_data, size_t a_size, float a_scale)
 {
-	std::string matFile = m_path + a_mtllib;
-	std::cout << "Attempting to load material file: " << matFile << std::endl;
-	//get an fstream to read in the file data.
-	std::fstream file;
-	file.open(matFile, std::ios_base::in | std::ios_base::binary);
-	//test to see if the file has opened in correctly.
-	if (file.is_open())
+	OBJMesh* currentMesh = nullptr;
+	std::string_view fileLine;
+	std::vector<glm::vec4> vertexData;
+	std::vector<glm::vec4> normalData;
+	std::vector<glm::vec2> UVData;
+	//Store out material in a string as face data is not generated prior to material assignment and may not have a mesh.
+	OBJMaterial* currentMtl = nullptr;
+	//Scratch buffers reused by every face so the face loop does not allocate once they have grown.
+	std::vector<obj_face_triplet> faceCorners;
+	std::vector<unsigned int> faceIndices;
+	//Corner welding state, only used when loading with one of the weld flags.
+	OBJVertexWelder weldTable;
+	OBJVertexWelder* welder = (m_loadFlags & (LOAD_WELD_VERTICES | LOAD_WELD_POSITIONS)) ? &weldTable : nullptr;
+	OBJMesh* weldMesh = nullptr;
+	//Files without any "s" statements are smoothed as a single group.
+	unsigned int smoothingGroup = 1;
+	const char* cursor = a_data;
+	const char* dataEnd = a_data + a_size;
+	//Progress is published (and cancellation checked) once per block of input rather than per line.
+	const char* lastReport = a_data;
+	size_t facesSinceReport = 0;
+	while (NextLine(cursor, dataEnd, fileLine))
 	{
-		std::cout << "Material Library SuccessFully Opened!!!" << std::endl;
-		//Success file has been opened, verify contents of the file -- ie check that file is not zero length.
-		file.ignore(std::numeric_limits<std::streamsize>::max()); //Attempt to read highest num bytes.
-		std::streamsize fileSize = file.gcount(); //gCount will reach EOF marker, letting us know num bytes.
-		file.clear(); //Clear EOF marker from being read.
-		file.seekg(0, std::ios_base::beg); //Seek back to beginning of file.
-		if (fileSize == 0)
+		if ((size_t)(cursor - lastReport) >= s_progressBlockSize)
+		{
+			if (!ReportLoadProgress(cursor - lastReport, facesSinceReport))
+			{
+				if (currentMesh != nullptr)
+				{
+					AddMesh(currentMesh);
+				}
+				return false;
+			}
+			lastReport = cursor;
+			facesSinceReport = 0;
+		}
+		std::string_view data;
+		switch (ClassifyLine(fileLine, data))
+		{
+		case OBJLineType::LINE_COMMENT: //This is a comment line.
 		{
-			std::cout << "File contains no data, closing file!!" << std::endl;
-			file.close();
+			std::cout << data << std::endl;
+			break;
 		}
-		std::cout << "Material File Size: " << fileSize / (float)1024 << "KB" << std::endl;
-
-		//Variable to store file data as it is read line by line.
-		std::string fileLine;
-		OBJMaterial* currentMaterial = nullptr;
-		while (!file.eof())
+		case OBJLineType::LINE_MTLLIB:
+		{
+			std::cout << "Material File: " << data << std::endl;
+			//Load in Material file so that materials can be used as required.
+			LoadMaterialLibrary(data);
+			break;
+		}
+		case OBJLineType::LINE_GROUP:
+		case OBJLineType::LINE_OBJECT:
+		{
+			std::cout << "OBJ Group Found: " << data << std::endl;
+			//We can use group tags to split our model up into smaller mesh components.
+			if (currentMesh != nullptr)
+			{
+				AddMesh(currentMesh);
+			}
+			currentMesh = m_arena.New<OBJMesh>();
+			currentMesh->m_name = std::string(data);
+			if (currentMtl != nullptr) //If we have a material name.
+			{
+				currentMesh->m_material = currentMtl;
+				currentMtl = nullptr;
+			}
+			break;
+		}
+		case OBJLineType::LINE_VERTEX:
+		{
+			glm::vec4 vertex = ProcessVectorString(data);
+			vertex *= a_scale; //Multiply by passed in vector to allow scaling of the model.
+			vertex.w = 1.0f; //As this is a position data ensure the w comp is set to 1.
+			vertexData.push_back(vertex);
+			break;
+		}
+		case OBJLineType::LINE_TEXCOORD:
+		{
+			glm::vec4 uvCoordv4 = ProcessVectorString(data);
+			glm::vec2 uvCoord = glm::vec2(uvCoordv4.x, uvCoordv4.y);
+			UVData.push_back(uvCoord);
+			break;
+		}
+		case OBJLineType::LINE_NORMAL:
+		{
+			glm::vec4 normal = ProcessVectorString(data);
+			normal.w = 0.0f;
+			normalData.push_back(normal);
+			break;
+		}
+		case OBJLineType::LINE_FACE:
+		{
+			if (currentMesh == nullptr) //We have entered processing faces without having hit a '0' or 'g' tag.
+			{
+				currentMesh = m_arena.New<OBJMesh>();
+				if (currentMtl != nullptr) //If we have a material name.
+				{
+					currentMesh->m_material = currentMtl;
+					currentMtl = nullptr;
+				}
+			}
+			//Process face data.
+			//Face consists of 3 -> More v/vt/vn triplets, decoded in a single pass over the line.
+			faceCorners.clear();
+			const char* faceCursor = data.data();
+			const char* faceEnd = faceCursor + data.size();
+			obj_face_triplet triplet;
+			while (ProcessTriplet(faceCursor, faceEnd, triplet))
+			{
+				//Resolve relative (negative) indices, drop the whole face if any are out of range.
+				if (!ResolveTriplet(triplet, vertexData.size(), UVData.size(), normalData.size()))
+				{
+					faceCorners.clear();
+					break;
+				}
+				faceCorners.push_back(triplet);
+			}
+			//Test to see if OBJ file contains normal data if normalData is empty then there are no normals.
+			bool calcNormals = normalData.empty();
+			if (welder != nullptr)
+			{
+				//Welded indices are local to a mesh so start a fresh table whenever the mesh changes.
+				if (weldMesh != currentMesh)
+				{
+					welder->Clear();
+					weldMesh = currentMesh;
+				}
+			}
+			AssembleFace(currentMesh, faceCorners.data(), faceCorners.size(), vertexData, UVData, normalData, calcNormals, smoothingGroup, welder, faceIndices);
+			facesSinceReport++;
+			break;
+		}
+		case OBJLineType::LINE_SMOOTH:
 		{
-			if (std::getline(file, fileLine))
+			smoothingGroup = ProcessSmoothingGroup(data);
+			break;
+		}
+		case OBJLineType::LINE_USEMTL:
+		{
+			//We have a material to use on the current mesh.
+			OBJMaterial* mtl = GetMaterialByName(data);
+			if (mtl != nullptr)
 			{
-				if (fileLine.size() > 0)
+				currentMtl = mtl;
+				if (currentMesh != nullptr)
 				{
-					std::string dataType = LineType(fileLine);
-					//If datatype has a 0 length then skip all tests and continue to next line.
-					if (dataType.length() == 0) { continue; }
-					std::string data = LineData(fileLine);
+					currentMesh->m_material = currentMtl;
+				}
+			}
+			break;
+		}
+		default: //Blank lines and statements we do not support.
+			break;
+		}
+	}
+	if (currentMesh != nullptr)
+	{
+		AddMesh(currentMesh);
+	}
+	ReportLoadProgress(cursor - lastReport, facesSinceReport);
+	return true;
+}
 
-					if (dataType == "#") //This is a comment line.
-					{
-						std::cout << data << std::endl;
-						continue;
-					}
-					if (dataType == "newmtl")
-					{
-						std::cout << "New Material Found: " << data << std::endl;
-						if (currentMaterial != nullptr)
-						{
-							m_materials.push_back(currentMaterial);
-						}
-						currentMaterial = new OBJMaterial();
-						currentMaterial->name = data;
-						continue;
-					}
-					if (dataType == "Ns")
-					{
-						if (currentMaterial != nullptr)
-						{
-							//NS is guaranteed to be a single float value.
-							currentMaterial->kS.a = std::stof(data);
-						}
-						continue;
-					}
-					if (dataType == "Ka")
-					{
-						if (currentMaterial != nullptr)
-						{
-							//Process kA as vector string.
-							float kAd = currentMaterial->kA.a; //Store alpha channel as may contain refractive index.
-							currentMaterial->kA = ProcessVectorString(data);
-							currentMaterial->kA.a = kAd;
-						}
-						continue;
-					}
-					if (dataType == "Kd")
-					{
-						if (currentMaterial != nullptr)
-						{
-							//Process kD as vector string.
-							float kDa = currentMaterial->kD.a; //Store alpha channel as may contain dissolve value.
-							currentMaterial->kD = ProcessVectorString(data);
-							currentMaterial->kD.a = kDa;
-						}
-						continue;
-					}
-					if (dataType == "Ks")
-					{
-						if (currentMaterial != nullptr)
-						{
-							//Process Ks as vector string.
-							float kSa = currentMaterial->kS.a; //Store alpha as may contain specular component.
-							currentMaterial->kS = ProcessVectorString(data);
-							currentMaterial->kS.a = kSa;
-						}
-						continue;
-					}
-					if (dataType == "Ke")
-					{
-						//KE is for emissive properties.
-						//We will not need to support this for our purposes.
-						continue;
-					}
-					if (dataType == "Ni")
-					{
-						if (currentMaterial != nullptr)
-						{
-							//This is the refractive index of the mesh (how light bends as it passes through
-							//the material). We will store this in the alpha component of the ambient light (kA).
-							currentMaterial->kA.a = std::stof(data);
-						}
-						continue;
-					}
-					if (dataType == "d" || dataType == "Tr") //Transparency/Opacity Tr = 1 - d.
-					{
-						if (currentMaterial != nullptr)
-						{
-							//This is the dissolve or alpha value of the material, we will store this in the kD alpha channel.
-							currentMaterial->kD.a = std::stof(data);
-							if (dataType == "Tr")
-							{
-								currentMaterial->kD.a = 1.0f - currentMaterial->kD.a;
-							}
-						}
-						continue;
-					}
-					if (dataType == "illum")
-					{
-						//Illum describes the illumination model used to light the model.
-						//Ignore this for now as we will light the scene ourselves.
-						continue;
-					}
-					if (dataType == "map_Kd") //Diffuse texture.
-					{
-						std::vector<std::string> mapData = SplitStringAtCharacter(data, ' ');
-						currentMaterial->textureFileNames[OBJMaterial::TextureTypes::DiffuseTexture] =
-							m_path + mapData[mapData.size() - 1]; //We are only interested in the file name.
-						//and other data is hot garbage as far as our loader is concerned.
-						continue;
-					}
-					if (dataType == "map_Ks") //Specular texture.
+void OBJModel::AssembleFace(OBJMesh* a_mesh, const obj_face_triplet* a_corners, size_t a_cornerCount,
+	const std::vector<glm::vec4>& a_vertexData, const std::vector<glm::vec2>& a_UVData, const std::vector<glm::vec4>& a_normalData,
+	bool a_calcNormals, unsigned int a_smoothingGroup, OBJVertexWelder* a_welder, std::vector<unsigned int>& a_faceIndices)
+{
+	a_faceIndices.clear();
+	bool weldPositions = (m_loadFlags & LOAD_WELD_POSITIONS) != 0;
+	//Flat shaded corners need a normal of their own so they are never welded.
+	bool weld = a_welder != nullptr && !(a_calcNormals && a_smoothingGroup == OBJMesh::SMOOTHING_OFF);
+	for (size_t i = 0; i < a_cornerCount; i++)
+	{
+		const obj_face_triplet& triplet = a_corners[i];
+		unsigned int vertexIndex = (unsigned int)a_mesh->m_vertices.size();
+		if (weld)
+		{
+			OBJVertexWelder::Key key;
+			key.vt = triplet.vt;
+			//Generated normals differ between smoothing groups, keep the groups apart (file vn indices are never negative).
+			key.vn = a_calcNormals ? (int32_t)~a_smoothingGroup : triplet.vn;
+			if (weldPositions)
+			{
+				//Snap the position to the tolerance grid, or use its exact bits (with -0 folded into 0) when there is no tolerance.
+				const glm::vec4& position = a_vertexData[triplet.v - 1];
+				int32_t* keyAxis[3] = { &key.x, &key.y, &key.z };
+				for (int axis = 0; axis < 3; axis++)
+				{
+					if (m_weldTolerance > 0.0f)
 					{
-						std::vector<std::string> mapData = SplitStringAtCharacter(data, ' ');
-						currentMaterial->textureFileNames[OBJMaterial::TextureTypes::SpecularTexture] =
-							m_path + mapData[mapData.size() - 1]; //We are only interested in the file name
-						//and other data is hot garbage as far as our loader is concerned.
-						continue;
+						float cell = std::floor(position[axis] / m_weldTolerance + 0.5f);
+						cell = std::min(std::max(cell, -2147483648.0f), 2147483520.0f);
+						*keyAxis[axis] = (int32_t)cell;
 					}
-					if (dataType == "map_bump" || dataType == "bump") //Normal map texture.
+					else
 					{
-						std::vector<std::string> mapData = SplitStringAtCharacter(data, ' ');
-						currentMaterial->textureFileNames[OBJMaterial::TextureTypes::NormalTexture] =
-							m_path + mapData[mapData.size() - 1]; //We are only interested in the file name
-						//and other data is hot garbage as far as our loader is concerned.
-						continue;
+						float value = position[axis] + 0.0f;
+						memcpy(keyAxis[axis], &value, sizeof(float));
 					}
 				}
 			}
+			else
+			{
+				key.x = triplet.v;
+				key.y = 0;
+				key.z = 0;
+			}
+			if (a_welder->FindOrInsert(key, vertexIndex, vertexIndex))
+			{
+				a_faceIndices.push_back(vertexIndex);
+				continue;
+			}
+		}
+		//Triplet processed now set Vertex Data from position/normal/texture data.
+		OBJVertex currentVertex;
+		currentVertex.position = a_vertexData[triplet.v - 1];
+		if (triplet.vn != 0)
+		{
+			currentVertex.normal = a_normalData[triplet.vn - 1];
+		}
+		if (triplet.vt != 0)
+		{
+			currentVertex.uvcoord = a_UVData[triplet.vt - 1];
+		}
+		a_mesh->m_vertices.push_back(currentVertex);
+		a_mesh->m_bounds.Add(glm::vec3(currentVertex.position));
+		a_faceIndices.push_back(vertexIndex);
+	}
+	//All face information for the tri/quad/fan have been collected.
+	//Time to index these into the current mesh.
+	for (size_t offset = 1; offset + 1 < a_faceIndices.size(); offset++)
+	{
+		unsigned int a = a_faceIndices[0];
+		unsigned int b = a_faceIndices[offset];
+		unsigned int c = a_faceIndices[offset + 1];
+		a_mesh->m_indices.push_back(a);
+		a_mesh->m_indices.push_back(b);
+		a_mesh->m_indices.push_back(c);
+		//Generated normals are filled in once the whole mesh is known, remember how this triangle is smoothed.
+		if (a_calcNormals || !a_mesh->m_smoothingGroups.empty())
+		{
+			a_mesh->m_smoothingGroups.push_back(a_calcNormals ? a_smoothingGroup : (unsigned int)OBJMesh::SMOOTHING_FILE_NORMALS);
+		}
+	}
+}
+
+void OBJModel::GenerateMissingNormals()
+{
+	//Large meshes split their own passes across threads, so they are done one at a time and the rest are spread
+	//across threads a mesh each.
+	std::vector<OBJMesh*> smallMeshes;
+	std::vector<OBJMesh*> largeMeshes;
+	for (OBJMesh* mesh : m_meshes)
+	{
+		if (mesh->m_smoothingGroups.empty())
+		{
+			ReportProcessingProgress(1);
+		}
+		else
+		{
+			(mesh->GetIndexCount() / 3 >= s_parallelNormalsTriangles ? largeMeshes : smallMeshes).push_back(mesh);
+		}
+	}
+	auto generate = [&](OBJMesh* a_mesh)
+	{
+		if (!IsLoadCancelled())
+		{
+			a_mesh->GenerateNormals();
+			OBJArenaVector<unsigned int>().swap(a_mesh->m_smoothingGroups);
 		}
-		if (currentMaterial != nullptr)
+		ReportProcessingProgress(1);
+	};
+	for (OBJMesh* mesh : largeMeshes)
+	{
+		generate(mesh);
+	}
+	Parallel::For(smallMeshes.size(), [&](size_t m)
+	{
+		generate(smallMeshes[m]);
+	});
+}
+
+unsigned int OBJModel::ProcessSmoothingGroup(std::string_view a_data)
+{
+	unsigned int group = 0;
+	for (char character : a_data)
+	{
+		if (character < '0' || character > '9')
+		{
+			return OBJMesh::SMOOTHING_OFF;
+		}
+		group = group * 10 + (character - '0');
+	}
+	//Keep clear of the reserved file normals value.
+	return std::min(group, (unsigned int)OBJMesh::SMOOTHING_FILE_NORMALS - 1);
+}
+
+glm::vec4 OBJModel::ProcessVectorString(std::string_view a_data)
+{
+	//Parse up to four whitespace separated floats straight into a glm::vec4.
+	glm::vec4 vecData = glm::vec4(0.0f);
+	const char* cursor = a_data.data();
+	const char* end = cursor + a_data.size();
+	for (int i = 0; i < 4; i++)
+	{
+		cursor = NumberParser::SkipWhitespace(cursor, end);
+		const char* next = NumberParser::ParseFloat(cursor, end, vecData[i]);
+		if (next == cursor) //Nothing left that looks like a number.
 		{
-			m_materials.push_back(currentMaterial);
+			break;
 		}
-		file.close();
+		cursor = next;
+	}
+	return vecData;
+}
+
+float OBJModel::ProcessFloatString(std::string_view a_data)
+{
+	float value = 0.0f;
+	const char* cursor = NumberParser::SkipWhitespace(a_data.data(), a_data.data() + a_data.size());
+	NumberParser::ParseFloat(cursor, a_data.data() + a_data.size(), value);
+	return value;
+}
+
+std::string_view OBJModel::LastToken(std::string_view a_data)
+{
+	//Return the final space separated token of the line data.
+	size_t token_start = a_data.find_last_of(" \t");
+	return (token_start == std::string_view::npos) ? a_data : a_data.substr(token_start + 1);
+}
+
+void OBJModel::LoadMaterialLibrary(std::string_view a_mtllib)
+{
+	std::string matFile = m_path + std::string(a_mtllib);
+	std::cout << "Attempting to load material file: " << matFile << std::endl;
+	//Map (or read) the material file, the parser works directly over these bytes.
+	MappedFile file;
+	if (file.Open(matFile.c_str(), (m_loadFlags & LOAD_MEMORY_MAPPED) != 0))
+	{
+		std::cout << "Material Library SuccessFully Opened!!!" << std::endl;
+		m_materialLibraries.push_back(matFile);
+		std::cout << "Material File Size: " << file.GetSize() / (float)1024 << "KB" << std::endl;
+		ParseMaterialData(file.GetData(), file.GetSize());
+		file.Close();
 	}
 	else
 	{
@@ -379,18 +672,149 @@ void OBJModel::LoadMaterialLibrary(std::string a_mtllib)
 	}
 }
 
-OBJMaterial* OBJModel::GetMaterialByName(const char* a_name)
+void OBJModel::ParseMaterialData(const char* a_data, size_t a_size)
 {
-	for (auto iter = m_materials.begin(); iter != m_materials.end(); iter++)
+	//Variable to store file data as it is read line by line.
+	std::string_view fileLine;
+	OBJMaterial* currentMaterial = nullptr;
+	const char* cursor = a_data;
+	const char* dataEnd = a_data + a_size;
+	while (NextLine(cursor, dataEnd, fileLine))
 	{
-		OBJMaterial* mat = (*iter);
-		if (mat->name == a_name)
+		if (fileLine.size() > 0)
 		{
-			return mat;
+			std::string_view dataType;
+			std::string_view data;
+			SplitLine(fileLine, dataType, data);
+			//If datatype has a 0 length then skip all tests and continue to next line.
+			if (dataType.length() == 0) { continue; }
+
+			if (dataType == "#") //This is a comment line.
+			{
+				std::cout << data << std::endl;
+				continue;
+			}
+			if (dataType == "newmtl")
+			{
+				std::cout << "New Material Found: " << data << std::endl;
+				if (currentMaterial != nullptr)
+				{
+					AddMaterial(currentMaterial);
+				}
+				currentMaterial = m_arena.New<OBJMaterial>();
+				currentMaterial->name = std::string(data);
+				continue;
+			}
+			if (dataType == "Ns")
+			{
+				if (currentMaterial != nullptr)
+				{
+					//NS is guaranteed to be a single float value.
+					currentMaterial->kS.a = ProcessFloatString(data);
+				}
+				continue;
+			}
+			if (dataType == "Ka")
+			{
+				if (currentMaterial != nullptr)
+				{
+					//Process kA as vector string.
+					float kAd = currentMaterial->kA.a; //Store alpha channel as may contain refractive index.
+					currentMaterial->kA = ProcessVectorString(data);
+					currentMaterial->kA.a = kAd;
+				}
+				continue;
+			}
+			if (dataType == "Kd")
+			{
+				if (currentMaterial != nullptr)
+				{
+					//Process kD as vector string.
+					float kDa = currentMaterial->kD.a; //Store alpha channel as may contain dissolve value.
+					currentMaterial->kD = ProcessVectorString(data);
+					currentMaterial->kD.a = kDa;
+				}
+				continue;
+			}
+			if (dataType == "Ks")
+			{
+				if (currentMaterial != nullptr)
+				{
+					//Process Ks as vector string.
+					float kSa = currentMaterial->kS.a; //Store alpha as may contain specular component.
+					currentMaterial->kS = ProcessVectorString(data);
+					currentMaterial->kS.a = kSa;
+				}
+				continue;
+			}
+			if (dataType == "Ke")
+			{
+				//KE is for emissive properties.
+				//We will not need to support this for our purposes.
+				continue;
+			}
+			if (dataType == "Ni")
+			{
+				if (currentMaterial != nullptr)
+				{
+					//This is the refractive index of the mesh (how light bends as it passes through
+					//the material). We will store this in the alpha component of the ambient light (kA).
+					currentMaterial->kA.a = ProcessFloatString(data);
+				}
+				continue;
+			}
+			if (dataType == "d" || dataType == "Tr") //Transparency/Opacity Tr = 1 - d.
+			{
+				if (currentMaterial != nullptr)
+				{
+					//This is the dissolve or alpha value of the material, we will store this in the kD alpha channel.
+					currentMaterial->kD.a = ProcessFloatString(data);
+					if (dataType == "Tr")
+					{
+						currentMaterial->kD.a = 1.0f - currentMaterial->kD.a;
+					}
+				}
+				continue;
+			}
+			if (dataType == "illum")
+			{
+				//Illum describes the illumination model used to light the model.
+				//Ignore this for now as we will light the scene ourselves.
+				continue;
+			}
+			if (dataType == "map_Kd") //Diffuse texture.
+			{
+				currentMaterial->textureFileNames[OBJMaterial::TextureTypes::DiffuseTexture] =
+					m_path + std::string(LastToken(data)); //We are only interested in the file name.
+				//and other data is hot garbage as far as our loader is concerned.
+				continue;
+			}
+			if (dataType == "map_Ks") //Specular texture.
+			{
+				currentMaterial->textureFileNames[OBJMaterial::TextureTypes::SpecularTexture] =
+					m_path + std::string(LastToken(data)); //We are only interested in the file name
+				//and other data is hot garbage as far as our loader is concerned.
+				continue;
+			}
+			if (dataType == "map_bump" || dataType == "bump") //Normal map texture.
+			{
+				currentMaterial->textureFileNames[OBJMaterial::TextureTypes::NormalTexture] =
+					m_path + std::string(LastToken(data)); //We are only interested in the file name
+				//and other data is hot garbage as far as our loader is concerned.
+				continue;
+			}
 		}
-		return nullptr;
 	}
-	return nullptr;
+	if (currentMaterial != nullptr)
+	{
+		AddMaterial(currentMaterial);
+	}
+}
+
+OBJMaterial* OBJModel::GetMaterialByName(std::string_view a_name)
+{
+	auto found = m_materialsByName.find(a_name);
+	return (found != m_materialsByName.end()) ? found->second : nullptr;
 }
 
 OBJMaterial* OBJModel::GetMaterialByIndex(unsigned int a_index)
@@ -403,63 +827,110 @@ OBJMaterial* OBJModel::GetMaterialByIndex(unsigned int a_index)
 	return nullptr;
 }
 
-OBJModel::obj_face_triplet OBJModel::ProcessTriplet(std::string a_triplet)
+bool OBJModel::ProcessTriplet(const char*& a_cursor, const char* a_end, obj_face_triplet& a_triplet)
 {
-	std::vector<std::string> vertexIndices = SplitStringAtCharacter(a_triplet, '/');
-	obj_face_triplet ft;
-	ft.v = 0; ft.vn = 0; ft.vt = 0;
-	ft.v = std::stoi(vertexIndices[0]);
-	if (vertexIndices.size() >= 2)
+	//A triplet is v, v/vt, v//vn or v/vt/vn, parse it in place and leave the cursor after it.
+	const char* p = NumberParser::SkipWhitespace(a_cursor, a_end);
+	a_triplet.v = 0; a_triplet.vn = 0; a_triplet.vt = 0;
+	const char* next = NumberParser::ParseInt(p, a_end, a_triplet.v);
+	if (next == p)
 	{
-		if (vertexIndices[1].size() > 0)
-		{
-			ft.vt = std::stoi(vertexIndices[1]);
-		}
-		if (vertexIndices.size() >= 3)
+		return false;
+	}
+	p = next;
+	if (p < a_end && *p == '/')
+	{
+		p = NumberParser::ParseInt(p + 1, a_end, a_triplet.vt); //Empty for the v//vn form.
+		if (p < a_end && *p == '/')
 		{
-			ft.vn = std::stoi(vertexIndices[2]);
+			p = NumberParser::ParseInt(p + 1, a_end, a_triplet.vn);
 		}
 	}
-	return ft;
+	a_cursor = p;
+	return true;
 }
 
-std::string OBJModel::LineType(const std::string& a_in)
+bool OBJModel::ResolveTriplet(obj_face_triplet& a_triplet, size_t a_vertexCount, size_t a_uvCount, size_t a_normalCount)
 {
-	if (!a_in.empty())
+	//Negative indices count backwards from the most recently read element.
+	if (a_triplet.v < 0) { a_triplet.v += (int)a_vertexCount + 1; }
+	if (a_triplet.vt < 0) { a_triplet.vt += (int)a_uvCount + 1; }
+	if (a_triplet.vn < 0) { a_triplet.vn += (int)a_normalCount + 1; }
+	return TripletInRange(a_triplet, a_vertexCount, a_uvCount, a_normalCount);
+}
+
+bool OBJModel::TripletInRange(const obj_face_triplet& a_triplet, size_t a_vertexCount, size_t a_uvCount, size_t a_normalCount)
+{
+	//A position is required, uv and normal indices of 0 mean the triplet does not use them.
+	return a_triplet.v > 0 && (size_t)a_triplet.v <= a_vertexCount &&
+		a_triplet.vt >= 0 && (size_t)a_triplet.vt <= a_uvCount &&
+		a_triplet.vn >= 0 && (size_t)a_triplet.vn <= a_normalCount;
+}
+
+void OBJModel::SplitLine(std::string_view a_line, std::string_view& a_keyword, std::string_view& a_data)
+{
+	//Split a line into its leading keyword and the trimmed data following it, without copying.
+	const char* p = NumberParser::SkipWhitespace(a_line.data(), a_line.data() + a_line.size());
+	const char* end = a_line.data() + a_line.size();
+	const char* keywordStart = p;
+	while (p < end && *p != ' ' && *p != '\t')
 	{
-		size_t token_start = a_in.find_first_not_of(" \t");
-		size_t token_end = a_in.find_first_of(" \t", token_start);
-		//test to see if the start token is valid, test to see if the end token is valid.
-		if (token_start != std::string::npos && token_end != std::string::npos)
-		{
-			return a_in.substr(token_start, token_end - token_start);
-		}
-		else if (token_start != std::string::npos)
-		{
-			return a_in.substr(token_start);
-		}
+		++p;
+	}
+	a_keyword = std::string_view(keywordStart, p - keywordStart);
+	p = NumberParser::SkipWhitespace(p, end);
+	while (end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+	{
+		--end;
 	}
-	return "";
+	a_data = std::string_view(p, end - p);
 }
 
-std::string OBJModel::LineData(const std::string& a_in)
+OBJModel::OBJLineType OBJModel::ClassifyLine(std::string_view a_line, std::string_view& a_data)
 {
-	//Get the token part of the line.
-	size_t token_start = a_in.find_first_not_of(" \t");
-	size_t token_end = a_in.find_first_of(" \t", token_start);
-	//Fine the data part of the current line.
-	size_t data_start = a_in.find_first_not_of(" \t", token_end);
-	size_t data_end = a_in.find_last_not_of(" \t\n\r");
-
-	if (data_start != std::string::npos && data_end != std::string::npos)
+	std::string_view keyword;
+	SplitLine(a_line, keyword, a_data);
+	if (keyword.empty())
 	{
-		return a_in.substr(data_start, data_end - data_start + 1);
+		return OBJLineType::LINE_UNKNOWN;
 	}
-	else if (data_start != std::string::npos)
+	//Switch on the leading bytes rather than comparing whole strings, the hot v/vt/vn/f cases resolve in one or two compares.
+	switch (keyword[0])
 	{
-		return a_in.substr(data_start);
+	case '#':
+		//Comments may not have a space after the hash, keep everything after it as the comment text.
+		if (keyword.size() > 1)
+		{
+			a_data = std::string_view(keyword.data() + 1, (a_data.data() + a_data.size()) - (keyword.data() + 1));
+		}
+		return OBJLineType::LINE_COMMENT;
+	case 'v':
+		if (keyword.size() == 1) { return OBJLineType::LINE_VERTEX; }
+		if (keyword.size() == 2 && keyword[1] == 't') { return OBJLineType::LINE_TEXCOORD; }
+		if (keyword.size() == 2 && keyword[1] == 'n') { return OBJLineType::LINE_NORMAL; }
+		break;
+	case 'f':
+		if (keyword.size() == 1) { return OBJLineType::LINE_FACE; }
+		break;
+	case 'g':
+		if (keyword.size() == 1) { return OBJLineType::LINE_GROUP; }
+		break;
+	case 'o':
+		if (keyword.size() == 1) { return OBJLineType::LINE_OBJECT; }
+		break;
+	case 'u':
+		if (keyword == "usemtl") { return OBJLineType::LINE_USEMTL; }
+		break;
+	case 'm':
+		if (keyword == "mtllib") { return OBJLineType::LINE_MTLLIB; }
+		break;
+	case 's':
+		if (keyword.size() == 1) { return OBJLineType::LINE_SMOOTH; }
+		break;
+	default:
+		break;
 	}
-	return "";
+	return OBJLineType::LINE_UNKNOWN;
 }
 
 OBJMesh* OBJModel::GetMeshByIndex(unsigned int a_index)
@@ -469,47 +940,54 @@ OBJMesh* OBJModel::GetMeshByIndex(unsigned int a_index)
 	{
 		return m_meshes[a_index];
 	}
+	return nullptr;
 }
 
-OBJMesh* OBJModel::GetMeshByName(const char* a_name)
+OBJMesh* OBJModel::GetMeshByName(std::string_view a_name)
 {
-	for (int i = 0; i < m_meshes.size(); i++)
+	auto found = m_meshesByName.find(a_name);
+	return (found != m_meshesByName.end()) ? found->second : nullptr;
+}
+
+void OBJModel::AddMesh(OBJMesh* a_mesh)
+{
+	m_meshes.push_back(a_mesh);
+	//Keep the first mesh with a name, as a front to back search would. Only new names are copied into the arena.
+	if (m_meshesByName.find(a_mesh->m_name) == m_meshesByName.end())
 	{
-		if (m_meshes[i]->m_name == a_name)
-		{
-			return m_meshes[i];
-		}
+		m_meshesByName.emplace(InternName(a_mesh->m_name), a_mesh);
+	}
+}
+
+void OBJModel::AddMaterial(OBJMaterial* a_material)
+{
+	m_materials.push_back(a_material);
+	if (m_materialsByName.find(a_material->name) == m_materialsByName.end())
+	{
+		m_materialsByName.emplace(InternName(a_material->name), a_material);
 	}
 }
 
+std::string_view OBJModel::InternName(std::string_view a_name)
+{
+	char* name = static_cast<char*>(m_arena.Allocate(a_name.size(), 1));
+	memcpy(name, a_name.data(), a_name.size());
+	return std::string_view(name, a_name.size());
+}
+
 glm::vec4 OBJMesh::CalculateFaceNormal(const unsigned int& a_indexA, const unsigned int& a_indexB, const unsigned int& a_indexC) const
 {
 	glm::vec3 a = m_vertices[a_indexA].position;
 	glm::vec3 b = m_vertices[a_indexB].position;
 	glm::vec3 c = m_vertices[a_indexC].position;
 
-	glm::vec3 ab = glm::normalize(b - a);
-	glm::vec3 ac = glm::normalize(c - a);
-	return glm::vec4(glm::cross(ab, ac), 0.0f);
+	glm::vec3 normal = glm::cross(b - a, c - a);
+	float length = glm::length(normal);
+	return glm::vec4((length > 0.0f) ? normal / length : normal, 0.0f);
 }
 
 void OBJMesh::CalculateFaceNormals()
 {
-	//As our indexed triangle array contains a tri for each three points we can iterate through this vector and calculate a face normal.
-	for (int i = 0; i < m_indices.size(); i += 3)
-	{
-		if (i < m_indices.size() - 100)
-		{
-			glm::vec4 normal = CalculateFaceNormal(i, i + 1, i + 2);
-			//Set face normal to each vertex for the tri.
-			m_vertices[i].normal = m_vertices[i + 1].normal - m_vertices[i + 2].normal - normal;
-		}
-		else
-		{
-			glm::vec4 normal = CalculateFaceNormal(i, i - 1, i - 2);
-			//Set face normal to each vertex for the tri.
-			m_vertices[i].normal = m_vertices[i - 1].normal - m_vertices[i - 2].normal - normal;
-		}
-
-	}
+	//Smooth the whole mesh from its triangles, the groups recorded while loading have already been used up.
+	GenerateNormals();
 }
\ No newline at end of file
@@ -0,0 +1,478 @@
+#include "obj_loader.h"
+#include "obj_bvh.h"
+#include "mapped_file.h"
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+//Cache file layout, all values little endian in the machine's native layout:
+//  OBJCacheHeader
+//  OBJCacheDependency[dependencyCount], each followed by its path
+//  Materials: name, kA, kD, kS, texture file names
+//  Meshes: name, material index, layout, position scale/offset, bounds, then every array of the finished mesh
+//  The BVH node, triangle and triangle reference arrays when the model was loaded with LOAD_BUILD_BVH
+//The meshes are stored after all post-processing, so a cache hit only has to copy them into the model's arena.
+//Strings are a uint32 length followed by the characters, arrays are a uint64 count followed by the elements
+//starting on a s_cacheAlignment boundary so they can be copied straight out of the mapped file.
+
+static const char s_cacheMagic[8] = { 'O', 'B', 'J', 'C', 'A', 'C', 'H', 'E' };
+//Bump whenever the layout or the meaning of any stored value changes.
+static const uint32_t s_cacheVersion = 4;
+static const size_t s_cacheAlignment = 16;
+
+struct OBJCacheHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t vertexSize; //sizeof(OBJVertex) and sizeof(OBJMeshlet) when written, a layout change makes the cache stale.
+	uint32_t meshletSize;
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	float scale;
+	uint32_t flags; //Only the load flags that change the loaded data.
+	float weldTolerance;
+	uint32_t dependencyCount;
+	uint32_t materialCount;
+	uint32_t meshCount;
+};
+
+struct OBJCacheDependency
+{
+	uint64_t size;
+	int64_t time;
+};
+
+//Load flags that change what ends up in the meshes, anything else (mapping, threading, huge pages) gives identical data.
+static const unsigned int s_cachedLoadFlags = OBJModel::LOAD_WELD_VERTICES | OBJModel::LOAD_WELD_POSITIONS |
+	OBJModel::LOAD_VERTEX_STREAMS | OBJModel::LOAD_QUANTIZE_VERTICES | OBJModel::LOAD_SHORT_INDICES | OBJModel::LOAD_SPLIT_LARGE_MESHES |
+	OBJModel::LOAD_OPTIMIZE_VERTEX_CACHE | OBJModel::LOAD_OPTIMIZE_OVERDRAW | OBJModel::LOAD_OPTIMIZE_VERTEX_FETCH | OBJModel::LOAD_SPATIAL_SORT |
+	OBJModel::LOAD_BUILD_MESHLETS | OBJModel::LOAD_BUILD_LODS | OBJModel::LOAD_GENERATE_TANGENTS | OBJModel::LOAD_BUILD_BVH;
+
+//Size and modification time of a file, returns false if it cannot be read.
+static bool GetFileStamp(const std::string& a_path, OBJCacheDependency& a_stamp)
+{
+	std::error_code error;
+	std::filesystem::path path(a_path);
+	uintmax_t size = std::filesystem::file_size(path, error);
+	if (error)
+	{
+		return false;
+	}
+	std::filesystem::file_time_type time = std::filesystem::last_write_time(path, error);
+	if (error)
+	{
+		return false;
+	}
+	a_stamp.size = (uint64_t)size;
+	a_stamp.time = (int64_t)time.time_since_epoch().count();
+	return true;
+}
+
+//Appends values to the cache image held in memory.
+class OBJCacheWriter
+{
+public:
+	void Write(const void* a_data, size_t a_size)
+	{
+		const char* bytes = static_cast<const char*>(a_data);
+		m_buffer.insert(m_buffer.end(), bytes, bytes + a_size);
+	}
+	template<typename T>
+	void Write(const T& a_value) { Write(&a_value, sizeof(T)); }
+	void WriteString(const std::string& a_string)
+	{
+		Write((uint32_t)a_string.size());
+		Write(a_string.data(), a_string.size());
+	}
+	void Align()
+	{
+		m_buffer.resize((m_buffer.size() + s_cacheAlignment - 1) & ~(s_cacheAlignment - 1), 0);
+	}
+	template<typename Vector>
+	void WriteArray(const Vector& a_array)
+	{
+		Write((uint64_t)a_array.size());
+		Align();
+		Write(a_array.data(), a_array.size() * sizeof(a_array[0]));
+	}
+	const std::vector<char>& GetBuffer() const { return m_buffer; }
+
+private:
+	std::vector<char> m_buffer;
+};
+
+//Reads values back out of a mapped cache file, every read is bounds checked so a truncated file just fails.
+class OBJCacheReader
+{
+public:
+	OBJCacheReader(const char* a_data, size_t a_size) : m_begin(a_data), m_cursor(a_data), m_end(a_data + a_size) {}
+	bool Read(void* a_data, size_t a_size)
+	{
+		if ((size_t)(m_end - m_cursor) < a_size)
+		{
+			return false;
+		}
+		memcpy(a_data, m_cursor, a_size);
+		m_cursor += a_size;
+		return true;
+	}
+	template<typename T>
+	bool Read(T& a_value) { return Read(&a_value, sizeof(T)); }
+	bool ReadString(std::string& a_string)
+	{
+		uint32_t length = 0;
+		if (!Read(length) || (size_t)(m_end - m_cursor) < length)
+		{
+			return false;
+		}
+		a_string.assign(m_cursor, length);
+		m_cursor += length;
+		return true;
+	}
+	bool Align()
+	{
+		size_t offset = m_cursor - m_begin;
+		size_t padding = ((offset + s_cacheAlignment - 1) & ~(s_cacheAlignment - 1)) - offset;
+		if ((size_t)(m_end - m_cursor) < padding)
+		{
+			return false;
+		}
+		m_cursor += padding;
+		return true;
+	}
+	//Copy an array written by OBJCacheWriter::WriteArray straight from the mapping into storage from a_allocator,
+	//the one copy the data makes on a cache hit.
+	template<typename T, typename Allocator>
+	bool ReadArray(std::vector<T, Allocator>& a_array, const Allocator& a_allocator = Allocator())
+	{
+		uint64_t count = 0;
+		if (!Read(count) || !Align() || count > (uint64_t)(m_end - m_cursor) / sizeof(T))
+		{
+			return false;
+		}
+		const T* elements = reinterpret_cast<const T*>(m_cursor);
+		std::vector<T, Allocator> array(elements, elements + count, a_allocator);
+		a_array.swap(array);
+		m_cursor += count * sizeof(T);
+		return true;
+	}
+	template<typename T>
+	bool ReadArray(OBJArenaVector<T>& a_array, OBJArena& a_arena) { return ReadArray(a_array, OBJArenaAllocator<T>(&a_arena)); }
+	size_t GetOffset() const { return m_cursor - m_begin; }
+
+private:
+	const char* m_begin;
+	const char* m_cursor;
+	const char* m_end;
+};
+
+//Every index and range of a mesh read from a cache points inside its arrays, so a damaged file can not make later
+//reads go out of bounds.
+static bool IsCachedMeshValid(const OBJMesh& a_mesh)
+{
+	size_t vertexCount = a_mesh.GetVertexCount();
+	if ((a_mesh.m_layout == OBJMesh::LAYOUT_STREAMS && (a_mesh.m_normals.size() != vertexCount || a_mesh.m_uvcoords.size() != vertexCount)) ||
+		(!a_mesh.m_tangents.empty() && a_mesh.m_tangents.size() != vertexCount))
+	{
+		return false;
+	}
+	for (unsigned int index : a_mesh.m_indices)
+	{
+		if (index >= vertexCount) { return false; }
+	}
+	for (unsigned int index : a_mesh.m_lodIndices)
+	{
+		if (index >= vertexCount) { return false; }
+	}
+	for (unsigned int index : a_mesh.m_meshletVertices)
+	{
+		if (index >= vertexCount) { return false; }
+	}
+	for (const OBJIndexRange& range : a_mesh.m_indexRanges)
+	{
+		if ((size_t)range.indexStart + range.indexCount > a_mesh.m_shortIndices.size())
+		{
+			return false;
+		}
+		for (unsigned int i = range.indexStart; i < range.indexStart + range.indexCount; i++)
+		{
+			if ((size_t)a_mesh.m_shortIndices[i] + range.baseVertex >= vertexCount) { return false; }
+		}
+	}
+	for (const OBJLodLevel& level : a_mesh.m_lodLevels)
+	{
+		if ((size_t)level.indexStart + level.indexCount > a_mesh.m_lodIndices.size()) { return false; }
+	}
+	for (const OBJMeshlet& meshlet : a_mesh.m_meshlets)
+	{
+		if ((size_t)meshlet.vertexOffset + meshlet.vertexCount > a_mesh.m_meshletVertices.size() ||
+			((size_t)meshlet.triangleOffset + meshlet.triangleCount) * 3 > a_mesh.m_meshletTriangles.size() ||
+			(size_t)meshlet.indexStart + (size_t)meshlet.triangleCount * 3 > a_mesh.GetIndexCount())
+		{
+			return false;
+		}
+		for (unsigned int i = meshlet.triangleOffset * 3; i < (meshlet.triangleOffset + meshlet.triangleCount) * 3; i++)
+		{
+			if (a_mesh.m_meshletTriangles[i] >= meshlet.vertexCount) { return false; }
+		}
+	}
+	return true;
+}
+
+bool OBJModel::SaveCache(const std::string& a_cachePath, const char* a_sourcePath, float a_scale) const
+{
+	OBJCacheDependency sourceStamp;
+	if (!GetFileStamp(a_sourcePath, sourceStamp))
+	{
+		return false;
+	}
+	OBJCacheHeader header = {};
+	memcpy(header.magic, s_cacheMagic, sizeof(s_cacheMagic));
+	header.version = s_cacheVersion;
+	header.vertexSize = sizeof(OBJVertex);
+	header.meshletSize = sizeof(OBJMeshlet);
+	header.sourceSize = sourceStamp.size;
+	header.sourceTime = sourceStamp.time;
+	header.scale = a_scale;
+	header.flags = m_loadFlags & s_cachedLoadFlags;
+	header.weldTolerance = m_weldTolerance;
+	header.dependencyCount = (uint32_t)m_materialLibraries.size();
+	header.materialCount = (uint32_t)m_materials.size();
+	header.meshCount = (uint32_t)m_meshes.size();
+
+	OBJCacheWriter writer;
+	writer.Write(header);
+	for (const std::string& library : m_materialLibraries)
+	{
+		OBJCacheDependency stamp;
+		if (!GetFileStamp(library, stamp))
+		{
+			return false;
+		}
+		writer.Write(stamp);
+		writer.WriteString(library);
+	}
+	for (const OBJMaterial* material : m_materials)
+	{
+		writer.WriteString(material->name);
+		writer.Write(material->kA);
+		writer.Write(material->kD);
+		writer.Write(material->kS);
+		for (int i = 0; i < OBJMaterial::TextureTypes::TextureTypes_Count; i++)
+		{
+			writer.WriteString(material->textureFileNames[i]);
+		}
+	}
+	for (const OBJMesh* mesh : m_meshes)
+	{
+		int32_t materialIndex = -1;
+		for (size_t i = 0; i < m_materials.size(); i++)
+		{
+			if (m_materials[i] == mesh->m_material)
+			{
+				materialIndex = (int32_t)i;
+				break;
+			}
+		}
+		writer.WriteString(mesh->m_name);
+		writer.Write(materialIndex);
+		writer.Write((uint32_t)mesh->m_layout);
+		writer.Write(mesh->m_positionScale);
+		writer.Write(mesh->m_positionOffset);
+		writer.Write(mesh->m_bounds);
+		writer.WriteArray(mesh->m_vertices);
+		writer.WriteArray(mesh->m_indices);
+		writer.WriteArray(mesh->m_shortIndices);
+		writer.WriteArray(mesh->m_indexRanges);
+		writer.WriteArray(mesh->m_meshlets);
+		writer.WriteArray(mesh->m_meshletVertices);
+		writer.WriteArray(mesh->m_meshletTriangles);
+		writer.WriteArray(mesh->m_lodIndices);
+		writer.WriteArray(mesh->m_lodLevels);
+		writer.WriteArray(mesh->m_positions);
+		writer.WriteArray(mesh->m_normals);
+		writer.WriteArray(mesh->m_uvcoords);
+		writer.WriteArray(mesh->m_tangents);
+		writer.WriteArray(mesh->m_quantizedVertices);
+	}
+	if (m_loadFlags & LOAD_BUILD_BVH)
+	{
+		const OBJBvh empty;
+		const OBJBvh& bvh = (m_bvh != nullptr) ? *m_bvh : empty;
+		writer.WriteArray(bvh.m_nodes);
+		writer.WriteArray(bvh.m_triangles);
+		writer.WriteArray(bvh.m_triangleRefs);
+	}
+
+	//Write to a temporary file and swap it in so a reader never sees a half written cache.
+	std::string tempPath = a_cachePath + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+		if (!file.is_open())
+		{
+			return false;
+		}
+		file.write(writer.GetBuffer().data(), writer.GetBuffer().size());
+		file.close();
+		if (!file.good())
+		{
+			std::error_code error;
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(tempPath, a_cachePath, error);
+	if (error)
+	{
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	std::cout << "Wrote model cache: " << a_cachePath << std::endl;
+	return true;
+}
+
+bool OBJModel::LoadCache(const std::string& a_cachePath, const char* a_sourcePath, float a_scale)
+{
+	MappedFile file;
+	if (!file.Open(a_cachePath.c_str(), true))
+	{
+		return false;
+	}
+	OBJCacheReader reader(file.GetData(), file.GetSize());
+	if (m_progress != nullptr)
+	{
+		m_progress->bytesTotal = file.GetSize();
+	}
+	OBJCacheHeader header;
+	if (!reader.Read(header) ||
+		memcmp(header.magic, s_cacheMagic, sizeof(s_cacheMagic)) != 0 ||
+		header.version != s_cacheVersion ||
+		header.vertexSize != sizeof(OBJVertex) ||
+		header.meshletSize != sizeof(OBJMeshlet) ||
+		header.scale != a_scale ||
+		header.flags != (m_loadFlags & s_cachedLoadFlags) ||
+		header.weldTolerance != m_weldTolerance)
+	{
+		return false;
+	}
+	//The cache is stale if the .obj or any .mtl it used has changed since it was written.
+	OBJCacheDependency stamp;
+	if (!GetFileStamp(a_sourcePath, stamp) || stamp.size != header.sourceSize || stamp.time != header.sourceTime)
+	{
+		std::cout << "Model cache is out of date: " << a_cachePath << std::endl;
+		return false;
+	}
+	std::vector<std::string> libraries(header.dependencyCount);
+	for (std::string& library : libraries)
+	{
+		OBJCacheDependency storedStamp;
+		if (!reader.Read(storedStamp) || !reader.ReadString(library) ||
+			!GetFileStamp(library, stamp) || stamp.size != storedStamp.size || stamp.time != storedStamp.time)
+		{
+			std::cout << "Model cache is out of date: " << a_cachePath << std::endl;
+			return false;
+		}
+	}
+
+	//Build into local lists so a damaged or cancelled cache load leaves the model untouched.
+	std::vector<OBJMaterial*> materials;
+	std::vector<OBJMesh*> meshes;
+	auto discard = [&]()
+	{
+		//Their arena memory is only reused once the model is unloaded, the shells are small.
+		for (OBJMaterial* material : materials) { material->~OBJMaterial(); }
+		for (OBJMesh* mesh : meshes) { mesh->~OBJMesh(); }
+		if (!IsLoadCancelled())
+		{
+			std::cout << "Model cache is damaged: " << a_cachePath << std::endl;
+		}
+		return false;
+	};
+	size_t lastReport = reader.GetOffset();
+	for (uint32_t m = 0; m < header.materialCount; m++)
+	{
+		OBJMaterial* material = m_arena.New<OBJMaterial>();
+		materials.push_back(material);
+		if (!reader.ReadString(material->name) || !reader.Read(material->kA) || !reader.Read(material->kD) || !reader.Read(material->kS))
+		{
+			return discard();
+		}
+		for (int i = 0; i < OBJMaterial::TextureTypes::TextureTypes_Count; i++)
+		{
+			if (!reader.ReadString(material->textureFileNames[i]))
+			{
+				return discard();
+			}
+		}
+	}
+	//The arrays are copied straight into the arena, where PostProcessMeshes would have moved them.
+	for (uint32_t m = 0; m < header.meshCount; m++)
+	{
+		OBJMesh* mesh = m_arena.New<OBJMesh>();
+		meshes.push_back(mesh);
+		int32_t materialIndex = -1;
+		uint32_t layout = 0;
+		if (!reader.ReadString(mesh->m_name) || !reader.Read(materialIndex) || !reader.Read(layout) ||
+			!reader.Read(mesh->m_positionScale) || !reader.Read(mesh->m_positionOffset) || !reader.Read(mesh->m_bounds) ||
+			materialIndex >= (int32_t)materials.size() || layout > OBJMesh::LAYOUT_QUANTIZED)
+		{
+			return discard();
+		}
+		mesh->m_material = (materialIndex >= 0) ? materials[materialIndex] : nullptr;
+		mesh->m_layout = (OBJMesh::VertexLayout)layout;
+		if (!reader.ReadArray(mesh->m_vertices, m_arena) ||
+			!reader.ReadArray(mesh->m_indices, m_arena) ||
+			!reader.ReadArray(mesh->m_shortIndices, m_arena) ||
+			!reader.ReadArray(mesh->m_indexRanges, m_arena) ||
+			!reader.ReadArray(mesh->m_meshlets, m_arena) ||
+			!reader.ReadArray(mesh->m_meshletVertices, m_arena) ||
+			!reader.ReadArray(mesh->m_meshletTriangles, m_arena) ||
+			!reader.ReadArray(mesh->m_lodIndices, m_arena) ||
+			!reader.ReadArray(mesh->m_lodLevels, m_arena) ||
+			!reader.ReadArray(mesh->m_positions, m_arena) ||
+			!reader.ReadArray(mesh->m_normals, m_arena) ||
+			!reader.ReadArray(mesh->m_uvcoords, m_arena) ||
+			!reader.ReadArray(mesh->m_tangents, m_arena) ||
+			!reader.ReadArray(mesh->m_quantizedVertices, m_arena) ||
+			!IsCachedMeshValid(*mesh) ||
+			!ReportLoadProgress(reader.GetOffset() - lastReport, 0))
+		{
+			return discard();
+		}
+		lastReport = reader.GetOffset();
+	}
+	OBJBvh* bvh = nullptr;
+	if (m_loadFlags & LOAD_BUILD_BVH)
+	{
+		bvh = new OBJBvh();
+		bool valid = reader.ReadArray(bvh->m_nodes) &&
+			reader.ReadArray(bvh->m_triangles) &&
+			reader.ReadArray(bvh->m_triangleRefs) &&
+			bvh->IsWellFormed();
+		for (size_t i = 0; valid && i < bvh->m_triangleRefs.size(); i++)
+		{
+			const OBJTriangleRef& triangle = bvh->m_triangleRefs[i];
+			valid = triangle.mesh < meshes.size() && triangle.triangle < meshes[triangle.mesh]->GetIndexCount() / 3;
+		}
+		if (!valid)
+		{
+			delete bvh;
+			return discard();
+		}
+	}
+	for (OBJMaterial* material : materials)
+	{
+		AddMaterial(material);
+	}
+	for (OBJMesh* mesh : meshes)
+	{
+		AddMesh(mesh);
+		m_bounds.Add(mesh->GetBounds());
+	}
+	m_bvh = bvh;
+	m_materialLibraries = libraries;
+	file.Close();
+	return true;
+}
@@ -0,0 +1,478 @@
+#include "obj_loader.h"
+#include "parallel.h"
+#include "vertex_welder.h"
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <iostream>
+
+//The multi-threaded parse runs in four steps:
+//1. The file is split at newline boundaries and every chunk parses its v/vt/vn/f records into its own buffers.
+//2. Once each chunk's element counts are known its indices are made global and validated against the counts
+//   the serial parser would have seen at that face.
+//3. The g/o/usemtl/mtllib statements are replayed in file order to decide which faces land in which mesh.
+//4. The mesh vertex/index arrays are sized once and every chunk writes its faces straight into place.
+//   Welded loads cannot know a mesh's vertex count up front, so they assemble each whole mesh on one thread instead.
+
+//Chunks smaller than this are not worth a thread, files that would only make one chunk are parsed serially.
+static const size_t s_minChunkSize = 1 << 20;
+//Give each thread a few chunks so that uneven chunks balance out.
+static const size_t s_chunksPerThread = 4;
+//Negative face indices are stored chunk relative with this bias until the chunk's base offsets are known.
+static const int s_relativeIndexBias = 1 << 30;
+//Stands in for an index that can never be in range, TripletInRange rejects it like any other bad index.
+static const int s_invalidIndex = INT_MAX;
+
+//Make a negative index chunk relative and bias it, indices reaching back further than the bias can never resolve.
+static int BiasRelativeIndex(int a_index, size_t a_chunkCount)
+{
+	int64_t relative = (int64_t)a_index + (int64_t)a_chunkCount + 1;
+	if (relative < -(int64_t)s_relativeIndexBias)
+	{
+		return s_invalidIndex;
+	}
+	return (int)(relative - s_relativeIndexBias);
+}
+
+//Undo BiasRelativeIndex once the chunk's base offset in the whole file is known.
+static int ResolveRelativeIndex(int a_index, size_t a_base)
+{
+	int64_t index = (int64_t)a_index + s_relativeIndexBias + (int64_t)a_base;
+	return (index > INT_MAX) ? s_invalidIndex : (int)index;
+}
+
+struct OBJModel::OBJParseChunk
+{
+	//A g/o/usemtl/mtllib/comment statement and the index of the first face that follows it.
+	struct Statement
+	{
+		OBJLineType type;
+		size_t faceIndex;
+		std::string_view data;
+	};
+	//The chunk's v/vt/vn counts in effect from faceIndex onwards.
+	struct Checkpoint
+	{
+		size_t faceIndex;
+		size_t vertexCount;
+		size_t uvCount;
+		size_t normalCount;
+	};
+
+	const char* begin = nullptr;
+	const char* end = nullptr;
+
+	std::vector<glm::vec4> vertexData;
+	std::vector<glm::vec4> normalData;
+	std::vector<glm::vec2> UVData;
+	//Every face corner in the chunk, faceCornerStart[f] is where face f begins (one extra entry at the end).
+	std::vector<obj_face_triplet> corners;
+	std::vector<size_t> faceCornerStart;
+	std::vector<Statement> statements;
+	std::vector<Checkpoint> checkpoints;
+
+	//Offsets of this chunk's v/vt/vn records in the whole file.
+	size_t vertexBase = 0;
+	size_t uvBase = 0;
+	size_t normalBase = 0;
+	//Running totals of vertices/indices each face emits, faces with bad indices emit nothing.
+	std::vector<size_t> faceVertexStart;
+	std::vector<size_t> faceIndexStart;
+
+	size_t GetFaceCount() const { return faceCornerStart.size() - 1; }
+	const Checkpoint& GetCheckpoint(size_t a_faceIndex) const
+	{
+		//The first face always records a checkpoint so there is always one at or before a_faceIndex.
+		auto iter = std::upper_bound(checkpoints.begin(), checkpoints.end(), a_faceIndex,
+			[](size_t a_face, const Checkpoint& a_checkpoint) { return a_face < a_checkpoint.faceIndex; });
+		return *(iter - 1);
+	}
+};
+
+//A run of consecutive faces from one chunk that all belong to the same mesh.
+struct OBJMeshSegment
+{
+	OBJMesh* mesh;
+	size_t chunk;
+	size_t faceBegin;
+	size_t faceEnd;
+	size_t vertexOffset;
+	size_t indexOffset;
+	unsigned int smoothingGroup;
+	OBJBounds bounds; //Of the vertices the segment writes, merged into the mesh once every segment is done.
+};
+
+bool OBJModel::ParseOBJDataParallel(const char* a_data, size_t a_size, float a_scale)
+{
+	//Split the file into chunks that start and end on line boundaries.
+	size_t chunkCount = std::min<size_t>(Parallel::GetThreadCount() * s_chunksPerThread, a_size / s_minChunkSize);
+	if (chunkCount <= 1)
+	{
+		return ParseOBJData(a_data, a_size, a_scale);
+	}
+	std::vector<OBJParseChunk> chunks(chunkCount);
+	const char* dataEnd = a_data + a_size;
+	const char* chunkStart = a_data;
+	for (size_t c = 0; c < chunkCount; c++)
+	{
+		const char* chunkEnd = (c + 1 == chunkCount) ? dataEnd : a_data + (a_size / chunkCount) * (c + 1);
+		if (chunkEnd < chunkStart)
+		{
+			chunkEnd = chunkStart;
+		}
+		const char* newline = static_cast<const char*>(memchr(chunkEnd, '\n', dataEnd - chunkEnd));
+		chunkEnd = (newline != nullptr && c + 1 < chunkCount) ? newline + 1 : dataEnd;
+		chunks[c].begin = chunkStart;
+		chunks[c].end = chunkEnd;
+		chunkStart = chunkEnd;
+	}
+	std::cout << "Parsing " << chunkCount << " chunks on " << Parallel::GetThreadCount() << " threads." << std::endl;
+
+	//Step 1: parse every chunk independently.
+	Parallel::For(chunkCount, [&](size_t c)
+	{
+		OBJParseChunk& chunk = chunks[c];
+		chunk.faceCornerStart.push_back(0);
+		bool countsChanged = true;
+		const char* cursor = chunk.begin;
+		const char* lastReport = chunk.begin;
+		size_t lastReportFaces = 0;
+		std::string_view fileLine;
+		while (NextLine(cursor, chunk.end, fileLine))
+		{
+			if ((size_t)(cursor - lastReport) >= s_progressBlockSize)
+			{
+				if (!ReportLoadProgress(cursor - lastReport, chunk.GetFaceCount() - lastReportFaces))
+				{
+					return;
+				}
+				lastReport = cursor;
+				lastReportFaces = chunk.GetFaceCount();
+			}
+			std::string_view data;
+			OBJLineType lineType = ClassifyLine(fileLine, data);
+			switch (lineType)
+			{
+			case OBJLineType::LINE_VERTEX:
+			{
+				glm::vec4 vertex = ProcessVectorString(data);
+				vertex *= a_scale; //Multiply by passed in vector to allow scaling of the model.
+				vertex.w = 1.0f; //As this is a position data ensure the w comp is set to 1.
+				chunk.vertexData.push_back(vertex);
+				countsChanged = true;
+				break;
+			}
+			case OBJLineType::LINE_TEXCOORD:
+			{
+				glm::vec4 uvCoordv4 = ProcessVectorString(data);
+				chunk.UVData.push_back(glm::vec2(uvCoordv4.x, uvCoordv4.y));
+				countsChanged = true;
+				break;
+			}
+			case OBJLineType::LINE_NORMAL:
+			{
+				glm::vec4 normal = ProcessVectorString(data);
+				normal.w = 0.0f;
+				chunk.normalData.push_back(normal);
+				countsChanged = true;
+				break;
+			}
+			case OBJLineType::LINE_FACE:
+			{
+				if (countsChanged)
+				{
+					chunk.checkpoints.push_back({ chunk.GetFaceCount(), chunk.vertexData.size(), chunk.UVData.size(), chunk.normalData.size() });
+					countsChanged = false;
+				}
+				const char* faceCursor = data.data();
+				const char* faceEnd = faceCursor + data.size();
+				obj_face_triplet triplet;
+				while (ProcessTriplet(faceCursor, faceEnd, triplet))
+				{
+					//Relative indices can only be resolved against this chunk for now, bias them so step 2 can tell them apart.
+					if (triplet.v < 0) { triplet.v = BiasRelativeIndex(triplet.v, chunk.vertexData.size()); }
+					if (triplet.vt < 0) { triplet.vt = BiasRelativeIndex(triplet.vt, chunk.UVData.size()); }
+					if (triplet.vn < 0) { triplet.vn = BiasRelativeIndex(triplet.vn, chunk.normalData.size()); }
+					chunk.corners.push_back(triplet);
+				}
+				chunk.faceCornerStart.push_back(chunk.corners.size());
+				break;
+			}
+			case OBJLineType::LINE_COMMENT:
+			case OBJLineType::LINE_MTLLIB:
+			case OBJLineType::LINE_GROUP:
+			case OBJLineType::LINE_OBJECT:
+			case OBJLineType::LINE_USEMTL:
+			case OBJLineType::LINE_SMOOTH:
+				chunk.statements.push_back({ lineType, chunk.GetFaceCount(), data });
+				break;
+			default:
+				break;
+			}
+		}
+		ReportLoadProgress(cursor - lastReport, chunk.GetFaceCount() - lastReportFaces);
+	});
+	if (IsLoadCancelled())
+	{
+		return false;
+	}
+	SetLoadPhase(OBJLoadProgress::PHASE_ASSEMBLING);
+
+	//Step 2: gather the v/vt/vn records into whole-file arrays and make every face index global.
+	size_t vertexCount = 0, uvCount = 0, normalCount = 0;
+	for (OBJParseChunk& chunk : chunks)
+	{
+		chunk.vertexBase = vertexCount;
+		chunk.uvBase = uvCount;
+		chunk.normalBase = normalCount;
+		vertexCount += chunk.vertexData.size();
+		uvCount += chunk.UVData.size();
+		normalCount += chunk.normalData.size();
+	}
+	std::vector<glm::vec4> vertexData(vertexCount);
+	std::vector<glm::vec4> normalData(normalCount);
+	std::vector<glm::vec2> UVData(uvCount);
+	Parallel::For(chunkCount, [&](size_t c)
+	{
+		OBJParseChunk& chunk = chunks[c];
+		std::copy(chunk.vertexData.begin(), chunk.vertexData.end(), vertexData.begin() + chunk.vertexBase);
+		std::copy(chunk.UVData.begin(), chunk.UVData.end(), UVData.begin() + chunk.uvBase);
+		std::copy(chunk.normalData.begin(), chunk.normalData.end(), normalData.begin() + chunk.normalBase);
+		std::vector<glm::vec4>().swap(chunk.vertexData);
+		std::vector<glm::vec2>().swap(chunk.UVData);
+		std::vector<glm::vec4>().swap(chunk.normalData);
+
+		size_t faceCount = chunk.GetFaceCount();
+		chunk.faceVertexStart.resize(faceCount + 1);
+		chunk.faceIndexStart.resize(faceCount + 1);
+		chunk.faceVertexStart[0] = 0;
+		chunk.faceIndexStart[0] = 0;
+		size_t checkpoint = 0;
+		for (size_t f = 0; f < faceCount; f++)
+		{
+			while (checkpoint + 1 < chunk.checkpoints.size() && chunk.checkpoints[checkpoint + 1].faceIndex <= f)
+			{
+				checkpoint++;
+			}
+			//The counts the serial parser would have had when it reached this face.
+			const OBJParseChunk::Checkpoint& counts = chunk.checkpoints[checkpoint];
+			size_t vertexLimit = chunk.vertexBase + counts.vertexCount;
+			size_t uvLimit = chunk.uvBase + counts.uvCount;
+			size_t normalLimit = chunk.normalBase + counts.normalCount;
+			size_t cornerCount = chunk.faceCornerStart[f + 1] - chunk.faceCornerStart[f];
+			for (size_t i = chunk.faceCornerStart[f]; i < chunk.faceCornerStart[f + 1]; i++)
+			{
+				obj_face_triplet& triplet = chunk.corners[i];
+				if (triplet.v < 0) { triplet.v = ResolveRelativeIndex(triplet.v, chunk.vertexBase); }
+				if (triplet.vt < 0) { triplet.vt = ResolveRelativeIndex(triplet.vt, chunk.uvBase); }
+				if (triplet.vn < 0) { triplet.vn = ResolveRelativeIndex(triplet.vn, chunk.normalBase); }
+				if (!TripletInRange(triplet, vertexLimit, uvLimit, normalLimit))
+				{
+					cornerCount = 0;
+				}
+			}
+			size_t triangleCount = (cornerCount > 2) ? cornerCount - 2 : 0;
+			chunk.faceVertexStart[f + 1] = chunk.faceVertexStart[f] + cornerCount;
+			chunk.faceIndexStart[f + 1] = chunk.faceIndexStart[f] + triangleCount * 3;
+		}
+	});
+
+	if (IsLoadCancelled())
+	{
+		return false;
+	}
+
+	//Step 3: replay the structural statements in file order, exactly as ParseOBJData handles them.
+	std::vector<OBJMeshSegment> segments;
+	std::vector<OBJMeshSegment> meshTotals; //One entry per finished mesh, offsets hold the final sizes.
+	std::vector<size_t> meshSegmentEnd; //One past the last segment of each finished mesh, a mesh's segments are contiguous.
+	OBJMesh* currentMesh = nullptr;
+	OBJMaterial* currentMtl = nullptr;
+	size_t meshVertexCount = 0;
+	size_t meshIndexCount = 0;
+	unsigned int smoothingGroup = 1;
+	auto finishMesh = [&]()
+	{
+		if (currentMesh != nullptr)
+		{
+			meshTotals.push_back({ currentMesh, 0, 0, 0, meshVertexCount, meshIndexCount, 0, OBJBounds() });
+			meshSegmentEnd.push_back(segments.size());
+			AddMesh(currentMesh);
+		}
+	};
+	auto emitFaces = [&](size_t a_chunk, size_t a_faceBegin, size_t a_faceEnd)
+	{
+		if (a_faceBegin == a_faceEnd)
+		{
+			return;
+		}
+		if (currentMesh == nullptr) //We have entered processing faces without having hit a '0' or 'g' tag.
+		{
+			currentMesh = m_arena.New<OBJMesh>();
+			meshVertexCount = 0;
+			meshIndexCount = 0;
+			if (currentMtl != nullptr) //If we have a material name.
+			{
+				currentMesh->m_material = currentMtl;
+				currentMtl = nullptr;
+			}
+		}
+		const OBJParseChunk& chunk = chunks[a_chunk];
+		segments.push_back({ currentMesh, a_chunk, a_faceBegin, a_faceEnd, meshVertexCount, meshIndexCount, smoothingGroup, OBJBounds() });
+		meshVertexCount += chunk.faceVertexStart[a_faceEnd] - chunk.faceVertexStart[a_faceBegin];
+		meshIndexCount += chunk.faceIndexStart[a_faceEnd] - chunk.faceIndexStart[a_faceBegin];
+	};
+	for (size_t c = 0; c < chunkCount; c++)
+	{
+		size_t faceCursor = 0;
+		for (const OBJParseChunk::Statement& statement : chunks[c].statements)
+		{
+			emitFaces(c, faceCursor, statement.faceIndex);
+			faceCursor = statement.faceIndex;
+			switch (statement.type)
+			{
+			case OBJLineType::LINE_COMMENT: //This is a comment line.
+				std::cout << statement.data << std::endl;
+				break;
+			case OBJLineType::LINE_MTLLIB:
+				std::cout << "Material File: " << statement.data << std::endl;
+				//Load in Material file so that materials can be used as required.
+				LoadMaterialLibrary(statement.data);
+				break;
+			case OBJLineType::LINE_GROUP:
+			case OBJLineType::LINE_OBJECT:
+				std::cout << "OBJ Group Found: " << statement.data << std::endl;
+				finishMesh();
+				currentMesh = m_arena.New<OBJMesh>();
+				currentMesh->m_name = std::string(statement.data);
+				meshVertexCount = 0;
+				meshIndexCount = 0;
+				if (currentMtl != nullptr) //If we have a material name.
+				{
+					currentMesh->m_material = currentMtl;
+					currentMtl = nullptr;
+				}
+				break;
+			case OBJLineType::LINE_USEMTL:
+			{
+				//We have a material to use on the current mesh.
+				OBJMaterial* mtl = GetMaterialByName(statement.data);
+				if (mtl != nullptr)
+				{
+					currentMtl = mtl;
+					if (currentMesh != nullptr)
+					{
+						currentMesh->m_material = currentMtl;
+					}
+				}
+				break;
+			}
+			case OBJLineType::LINE_SMOOTH:
+				smoothingGroup = ProcessSmoothingGroup(statement.data);
+				break;
+			default:
+				break;
+			}
+		}
+		emitFaces(c, faceCursor, chunks[c].GetFaceCount());
+	}
+	finishMesh();
+
+	if (m_loadFlags & (LOAD_WELD_VERTICES | LOAD_WELD_POSITIONS))
+	{
+		//Step 4 (welded): every mesh runs its faces through its own weld table, in file order.
+		Parallel::For(meshTotals.size(), [&](size_t m)
+		{
+			if (IsLoadCancelled())
+			{
+				return;
+			}
+			OBJMesh* mesh = meshTotals[m].mesh;
+			mesh->m_indices.reserve(meshTotals[m].indexOffset);
+			OBJVertexWelder welder;
+			std::vector<unsigned int> faceIndices;
+			for (size_t s = (m > 0) ? meshSegmentEnd[m - 1] : 0; s < meshSegmentEnd[m]; s++)
+			{
+				const OBJMeshSegment& segment = segments[s];
+				const OBJParseChunk& chunk = chunks[segment.chunk];
+				for (size_t f = segment.faceBegin; f < segment.faceEnd; f++)
+				{
+					size_t faceVertexCount = chunk.faceVertexStart[f + 1] - chunk.faceVertexStart[f];
+					if (faceVertexCount == 0)
+					{
+						continue;
+					}
+					bool calcNormals = (chunk.normalBase + chunk.GetCheckpoint(f).normalCount) == 0;
+					AssembleFace(mesh, &chunk.corners[chunk.faceCornerStart[f]], faceVertexCount, vertexData, UVData, normalData, calcNormals, segment.smoothingGroup, &welder, faceIndices);
+				}
+			}
+		});
+		return !IsLoadCancelled();
+	}
+
+	//Step 4: size every mesh once, then let each segment write its faces straight into place.
+	Parallel::For(meshTotals.size(), [&](size_t m)
+	{
+		meshTotals[m].mesh->m_vertices.resize(meshTotals[m].vertexOffset);
+		meshTotals[m].mesh->m_indices.resize(meshTotals[m].indexOffset);
+		//Faces before the first vn record need generated normals, so a mesh needs smoothing groups if its first face does.
+		size_t firstSegment = (m > 0) ? meshSegmentEnd[m - 1] : 0;
+		if (firstSegment < meshSegmentEnd[m])
+		{
+			const OBJMeshSegment& segment = segments[firstSegment];
+			if (chunks[segment.chunk].normalBase + chunks[segment.chunk].GetCheckpoint(segment.faceBegin).normalCount == 0)
+			{
+				meshTotals[m].mesh->m_smoothingGroups.resize(meshTotals[m].indexOffset / 3);
+			}
+		}
+	});
+	Parallel::For(segments.size(), [&](size_t s)
+	{
+		OBJMeshSegment& segment = segments[s];
+		const OBJParseChunk& chunk = chunks[segment.chunk];
+		OBJMesh* mesh = segment.mesh;
+		for (size_t f = segment.faceBegin; f < segment.faceEnd; f++)
+		{
+			size_t faceVertexCount = chunk.faceVertexStart[f + 1] - chunk.faceVertexStart[f];
+			if (faceVertexCount == 0)
+			{
+				continue;
+			}
+			unsigned int ci = (unsigned int)(segment.vertexOffset + chunk.faceVertexStart[f] - chunk.faceVertexStart[segment.faceBegin]);
+			size_t index = segment.indexOffset + chunk.faceIndexStart[f] - chunk.faceIndexStart[segment.faceBegin];
+			const obj_face_triplet* corner = &chunk.corners[chunk.faceCornerStart[f]];
+			for (size_t i = 0; i < faceVertexCount; i++)
+			{
+				//Triplet processed now set Vertex Data from position/normal/texture data.
+				OBJVertex& currentVertex = mesh->m_vertices[ci + i];
+				currentVertex.position = vertexData[corner[i].v - 1];
+				segment.bounds.Add(glm::vec3(currentVertex.position));
+				if (corner[i].vn != 0)
+				{
+					currentVertex.normal = normalData[corner[i].vn - 1];
+				}
+				if (corner[i].vt != 0)
+				{
+					currentVertex.uvcoord = UVData[corner[i].vt - 1];
+				}
+			}
+			//Faces read before any vn record have their normals generated once the meshes are complete.
+			bool calcNormals = (chunk.normalBase + chunk.GetCheckpoint(f).normalCount) == 0;
+			for (unsigned int offset = 1; offset + 1 < faceVertexCount; offset++)
+			{
+				if (!mesh->m_smoothingGroups.empty())
+				{
+					mesh->m_smoothingGroups[index / 3] = calcNormals ? segment.smoothingGroup : (unsigned int)OBJMesh::SMOOTHING_FILE_NORMALS;
+				}
+				mesh->m_indices[index++] = ci;
+				mesh->m_indices[index++] = ci + offset;
+				mesh->m_indices[index++] = ci + 1 + offset;
+			}
+		}
+	});
+	for (const OBJMeshSegment& segment : segments)
+	{
+		segment.mesh->m_bounds.Add(segment.bounds);
+	}
+	return !IsLoadCancelled();
+}
@@ -0,0 +1,75 @@
+#include "obj_loader.h"
+
+//Index buffer processing for OBJMesh.
+
+//Vertices addressable by a 16 bit index.
+static const size_t s_shortIndexVertexLimit = 65536;
+static const unsigned int s_unassigned = 0xFFFFFFFFu;
+
+bool OBJMesh::UseShortIndices(bool a_allowSplit)
+{
+	if (HasShortIndices())
+	{
+		return true;
+	}
+	size_t vertexCount = GetVertexCount();
+	if (vertexCount <= s_shortIndexVertexLimit)
+	{
+		//Everything fits, one range covering the whole mesh.
+		m_shortIndices.assign(m_indices.begin(), m_indices.end());
+		m_indexRanges.push_back({ 0, (unsigned int)m_shortIndices.size(), 0 });
+		OBJArenaVector<unsigned int>().swap(m_indices);
+		return true;
+	}
+	if (!a_allowSplit)
+	{
+		return false;
+	}
+
+	//Walk the triangles in order, giving each vertex a slot in the current range the first time the range uses it.
+	//When a triangle would take the range past the limit a new range is started, so vertices shared between
+	//ranges are duplicated but every range's vertices are contiguous and can be drawn with a base vertex.
+	std::vector<unsigned int> newToOld;
+	newToOld.reserve(vertexCount);
+	std::vector<unsigned int> localIndex(vertexCount, s_unassigned);
+	std::vector<unsigned int> rangeVertices; //Old indices used by the current range, to reset localIndex.
+	m_shortIndices.reserve(m_indices.size());
+	OBJIndexRange range = { 0, 0, 0 };
+	for (size_t t = 0; t + 2 < m_indices.size(); t += 3)
+	{
+		unsigned int a = m_indices[t];
+		unsigned int b = m_indices[t + 1];
+		unsigned int c = m_indices[t + 2];
+		size_t newVertices = (localIndex[a] == s_unassigned ? 1 : 0) +
+			(localIndex[b] == s_unassigned && b != a ? 1 : 0) +
+			(localIndex[c] == s_unassigned && c != a && c != b ? 1 : 0);
+		if (rangeVertices.size() + newVertices > s_shortIndexVertexLimit)
+		{
+			range.indexCount = (unsigned int)m_shortIndices.size() - range.indexStart;
+			m_indexRanges.push_back(range);
+			for (unsigned int vertex : rangeVertices)
+			{
+				localIndex[vertex] = s_unassigned;
+			}
+			rangeVertices.clear();
+			range.indexStart = (unsigned int)m_shortIndices.size();
+			range.baseVertex = (unsigned int)newToOld.size();
+		}
+		for (size_t corner = 0; corner < 3; corner++)
+		{
+			unsigned int vertex = m_indices[t + corner];
+			if (localIndex[vertex] == s_unassigned)
+			{
+				localIndex[vertex] = (unsigned int)rangeVertices.size();
+				rangeVertices.push_back(vertex);
+				newToOld.push_back(vertex);
+			}
+			m_shortIndices.push_back((uint16_t)localIndex[vertex]);
+		}
+	}
+	range.indexCount = (unsigned int)m_shortIndices.size() - range.indexStart;
+	m_indexRanges.push_back(range);
+	RemapVertices(newToOld);
+	OBJArenaVector<unsigned int>().swap(m_indices);
+	return true;
+}
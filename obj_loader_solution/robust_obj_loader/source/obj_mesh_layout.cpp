@@ -0,0 +1,261 @@
+#include "obj_loader.h"
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <cmath>
+
+//Conversions between the OBJMesh vertex layouts, every conversion goes through the interleaved layout.
+
+static const float s_positionSteps = 65535.0f;
+static const float s_normalSteps = 32767.0f;
+
+//Octahedral normal encoding, the unit sphere is folded onto a square so two components are enough.
+static glm::vec2 EncodeOctahedral(glm::vec3 a_normal)
+{
+	float sum = std::abs(a_normal.x) + std::abs(a_normal.y) + std::abs(a_normal.z);
+	if (sum <= 0.0f)
+	{
+		return glm::vec2(0.0f);
+	}
+	glm::vec2 encoded = glm::vec2(a_normal.x, a_normal.y) / sum;
+	if (a_normal.z < 0.0f)
+	{
+		//Fold the lower hemisphere over the diagonals of the square.
+		glm::vec2 folded = glm::vec2(1.0f - std::abs(encoded.y), 1.0f - std::abs(encoded.x));
+		encoded.x = (encoded.x >= 0.0f) ? folded.x : -folded.x;
+		encoded.y = (encoded.y >= 0.0f) ? folded.y : -folded.y;
+	}
+	return encoded;
+}
+
+static glm::vec3 DecodeOctahedral(glm::vec2 a_encoded)
+{
+	glm::vec3 normal = glm::vec3(a_encoded.x, a_encoded.y, 1.0f - std::abs(a_encoded.x) - std::abs(a_encoded.y));
+	if (normal.z < 0.0f)
+	{
+		glm::vec2 unfolded = glm::vec2(1.0f - std::abs(normal.y), 1.0f - std::abs(normal.x));
+		normal.x = (normal.x >= 0.0f) ? unfolded.x : -unfolded.x;
+		normal.y = (normal.y >= 0.0f) ? unfolded.y : -unfolded.y;
+	}
+	float length = glm::length(normal);
+	return (length > 0.0f) ? normal / length : normal;
+}
+
+static int16_t QuantizeSnorm16(float a_value)
+{
+	return (int16_t)std::lround(std::min(std::max(a_value, -1.0f), 1.0f) * s_normalSteps);
+}
+
+static float DequantizeSnorm16(int16_t a_value)
+{
+	//Matches the GL 4.2+ snorm conversion so the shader decodes the same value.
+	return std::max(a_value / s_normalSteps, -1.0f);
+}
+
+unsigned int OBJMesh::GetVertexCount() const
+{
+	switch (m_layout)
+	{
+	case LAYOUT_STREAMS: return m_positions.size();
+	case LAYOUT_QUANTIZED: return m_quantizedVertices.size();
+	default: return m_vertices.size();
+	}
+}
+
+glm::vec3 OBJMesh::GetVertexPosition(unsigned int a_index) const
+{
+	switch (m_layout)
+	{
+	case LAYOUT_STREAMS:
+		return m_positions[a_index];
+	case LAYOUT_QUANTIZED:
+	{
+		const uint16_t* position = m_quantizedVertices[a_index].position;
+		return glm::vec3(position[0], position[1], position[2]) / s_positionSteps * m_positionScale + m_positionOffset;
+	}
+	default:
+		return glm::vec3(m_vertices[a_index].position);
+	}
+}
+
+void OBJMesh::CalculateBounds()
+{
+	m_bounds = OBJBounds();
+	unsigned int vertexCount = GetVertexCount();
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		m_bounds.Add(GetVertexPosition(i));
+	}
+}
+
+void OBJMesh::MoveToArena(OBJArena& a_arena)
+{
+	::MoveToArena(m_vertices, a_arena);
+	::MoveToArena(m_indices, a_arena);
+	::MoveToArena(m_shortIndices, a_arena);
+	::MoveToArena(m_indexRanges, a_arena);
+	::MoveToArena(m_smoothingGroups, a_arena);
+	::MoveToArena(m_meshlets, a_arena);
+	::MoveToArena(m_meshletVertices, a_arena);
+	::MoveToArena(m_meshletTriangles, a_arena);
+	::MoveToArena(m_lodIndices, a_arena);
+	::MoveToArena(m_lodLevels, a_arena);
+	::MoveToArena(m_positions, a_arena);
+	::MoveToArena(m_normals, a_arena);
+	::MoveToArena(m_uvcoords, a_arena);
+	::MoveToArena(m_tangents, a_arena);
+	::MoveToArena(m_quantizedVertices, a_arena);
+}
+
+void OBJMesh::SetVertexLayout(VertexLayout a_layout)
+{
+	if (a_layout == m_layout)
+	{
+		return;
+	}
+	if (m_layout == LAYOUT_STREAMS)
+	{
+		size_t vertexCount = m_positions.size();
+		m_vertices.resize(vertexCount);
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			m_vertices[i].position = glm::vec4(m_positions[i], 1.0f);
+			m_vertices[i].normal = glm::vec4(m_normals[i], 0.0f);
+			m_vertices[i].uvcoord = m_uvcoords[i];
+		}
+		OBJArenaVector<glm::vec3>().swap(m_positions);
+		OBJArenaVector<glm::vec3>().swap(m_normals);
+		OBJArenaVector<glm::vec2>().swap(m_uvcoords);
+	}
+	else if (m_layout == LAYOUT_QUANTIZED)
+	{
+		//Quantization is lossy, this gives back the values the shader would have rendered.
+		size_t vertexCount = m_quantizedVertices.size();
+		m_vertices.resize(vertexCount);
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			const OBJQuantizedVertex& quantized = m_quantizedVertices[i];
+			glm::vec3 position = glm::vec3(quantized.position[0], quantized.position[1], quantized.position[2]) / s_positionSteps;
+			m_vertices[i].position = glm::vec4(position * m_positionScale + m_positionOffset, 1.0f);
+			glm::vec3 normal = DecodeOctahedral(glm::vec2(DequantizeSnorm16(quantized.normal[0]), DequantizeSnorm16(quantized.normal[1])));
+			m_vertices[i].normal = glm::vec4(normal, 0.0f);
+			m_vertices[i].uvcoord = glm::vec2(glm::unpackHalf1x16(quantized.uvcoord[0]), glm::unpackHalf1x16(quantized.uvcoord[1]));
+		}
+		OBJArenaVector<OBJQuantizedVertex>().swap(m_quantizedVertices);
+		m_positionScale = glm::vec3(1.0f);
+		m_positionOffset = glm::vec3(0.0f);
+	}
+	m_layout = LAYOUT_INTERLEAVED;
+
+	if (a_layout == LAYOUT_STREAMS)
+	{
+		size_t vertexCount = m_vertices.size();
+		m_positions.resize(vertexCount);
+		m_normals.resize(vertexCount);
+		m_uvcoords.resize(vertexCount);
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			m_positions[i] = glm::vec3(m_vertices[i].position);
+			m_normals[i] = glm::vec3(m_vertices[i].normal);
+			m_uvcoords[i] = m_vertices[i].uvcoord;
+		}
+		OBJArenaVector<OBJVertex>().swap(m_vertices);
+	}
+	else if (a_layout == LAYOUT_QUANTIZED)
+	{
+		//Positions are stored as fractions of the mesh bounds.
+		glm::vec3 minimum = glm::vec3(0.0f);
+		glm::vec3 maximum = glm::vec3(0.0f);
+		if (!m_vertices.empty())
+		{
+			minimum = maximum = glm::vec3(m_vertices[0].position);
+		}
+		for (const OBJVertex& vertex : m_vertices)
+		{
+			minimum = glm::min(minimum, glm::vec3(vertex.position));
+			maximum = glm::max(maximum, glm::vec3(vertex.position));
+		}
+		m_positionOffset = minimum;
+		m_positionScale = maximum - minimum;
+		glm::vec3 toSteps = glm::vec3(0.0f);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (m_positionScale[axis] > 0.0f)
+			{
+				toSteps[axis] = s_positionSteps / m_positionScale[axis];
+			}
+		}
+
+		size_t vertexCount = m_vertices.size();
+		m_quantizedVertices.resize(vertexCount);
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			const OBJVertex& vertex = m_vertices[i];
+			OBJQuantizedVertex& quantized = m_quantizedVertices[i];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				float steps = (vertex.position[axis] - minimum[axis]) * toSteps[axis];
+				quantized.position[axis] = (uint16_t)std::lround(std::min(std::max(steps, 0.0f), s_positionSteps));
+			}
+			quantized.position[3] = 0;
+			glm::vec2 normal = EncodeOctahedral(glm::vec3(vertex.normal));
+			quantized.normal[0] = QuantizeSnorm16(normal.x);
+			quantized.normal[1] = QuantizeSnorm16(normal.y);
+			quantized.uvcoord[0] = glm::packHalf1x16(vertex.uvcoord.x);
+			quantized.uvcoord[1] = glm::packHalf1x16(vertex.uvcoord.y);
+		}
+		OBJArenaVector<OBJVertex>().swap(m_vertices);
+	}
+	m_layout = a_layout;
+}
+
+void OBJMesh::RemapVertices(const std::vector<unsigned int>& a_newToOld)
+{
+	switch (m_layout)
+	{
+	case LAYOUT_STREAMS:
+	{
+		OBJArenaVector<glm::vec3> positions(a_newToOld.size());
+		OBJArenaVector<glm::vec3> normals(a_newToOld.size());
+		OBJArenaVector<glm::vec2> uvcoords(a_newToOld.size());
+		for (size_t i = 0; i < a_newToOld.size(); i++)
+		{
+			positions[i] = m_positions[a_newToOld[i]];
+			normals[i] = m_normals[a_newToOld[i]];
+			uvcoords[i] = m_uvcoords[a_newToOld[i]];
+		}
+		m_positions.swap(positions);
+		m_normals.swap(normals);
+		m_uvcoords.swap(uvcoords);
+		break;
+	}
+	case LAYOUT_QUANTIZED:
+	{
+		OBJArenaVector<OBJQuantizedVertex> vertices(a_newToOld.size());
+		for (size_t i = 0; i < a_newToOld.size(); i++)
+		{
+			vertices[i] = m_quantizedVertices[a_newToOld[i]];
+		}
+		m_quantizedVertices.swap(vertices);
+		break;
+	}
+	default:
+	{
+		OBJArenaVector<OBJVertex> vertices(a_newToOld.size());
+		for (size_t i = 0; i < a_newToOld.size(); i++)
+		{
+			vertices[i] = m_vertices[a_newToOld[i]];
+		}
+		m_vertices.swap(vertices);
+		break;
+	}
+	}
+	if (!m_tangents.empty())
+	{
+		OBJArenaVector<glm::vec4> tangents(a_newToOld.size());
+		for (size_t i = 0; i < a_newToOld.size(); i++)
+		{
+			tangents[i] = m_tangents[a_newToOld[i]];
+		}
+		m_tangents.swap(tangents);
+	}
+}
@@ -0,0 +1,191 @@
+#include "obj_loader.h"
+#include <algorithm>
+#include <cmath>
+
+//Meshlet generation and culling for OBJMesh.
+
+static const unsigned int s_notInMeshlet = 0xFFFFFFFFu;
+//Normal cones wider than this (the smallest dot of a normal with the axis) can never cull and are disabled.
+static const float s_minConeDot = 0.1f;
+
+//Fills in the bounding sphere and normal cone of a finished meshlet.
+static void CalculateMeshletBounds(const OBJMesh& a_mesh, OBJMeshlet& a_meshlet)
+{
+	const unsigned int* vertices = &a_mesh.m_meshletVertices[a_meshlet.vertexOffset];
+	const uint8_t* triangles = &a_mesh.m_meshletTriangles[a_meshlet.triangleOffset * 3];
+	glm::vec3 minimum = a_mesh.GetVertexPosition(vertices[0]);
+	glm::vec3 maximum = minimum;
+	for (unsigned int v = 1; v < a_meshlet.vertexCount; v++)
+	{
+		glm::vec3 position = a_mesh.GetVertexPosition(vertices[v]);
+		minimum = glm::min(minimum, position);
+		maximum = glm::max(maximum, position);
+	}
+	a_meshlet.center = (minimum + maximum) * 0.5f;
+	a_meshlet.radius = 0.0f;
+	for (unsigned int v = 0; v < a_meshlet.vertexCount; v++)
+	{
+		a_meshlet.radius = std::max(a_meshlet.radius, glm::length(a_mesh.GetVertexPosition(vertices[v]) - a_meshlet.center));
+	}
+
+	//The cone axis is the average facing of the triangles, the cutoff comes from the one furthest from it.
+	std::vector<glm::vec3> normals(a_meshlet.triangleCount);
+	std::vector<glm::vec3> corners(a_meshlet.triangleCount);
+	glm::vec3 normalSum = glm::vec3(0.0f);
+	for (unsigned int t = 0; t < a_meshlet.triangleCount; t++)
+	{
+		glm::vec3 a = a_mesh.GetVertexPosition(vertices[triangles[t * 3]]);
+		glm::vec3 b = a_mesh.GetVertexPosition(vertices[triangles[t * 3 + 1]]);
+		glm::vec3 c = a_mesh.GetVertexPosition(vertices[triangles[t * 3 + 2]]);
+		glm::vec3 normal = glm::cross(b - a, c - a);
+		float length = glm::length(normal);
+		normals[t] = (length > 0.0f) ? normal / length : glm::vec3(0.0f);
+		corners[t] = a;
+		normalSum += normals[t];
+	}
+	a_meshlet.coneApex = a_meshlet.center;
+	a_meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+	a_meshlet.coneCutoff = 1.0f;
+	float sumLength = glm::length(normalSum);
+	if (sumLength <= 0.0f)
+	{
+		return;
+	}
+	glm::vec3 axis = normalSum / sumLength;
+	float minDot = 1.0f;
+	for (unsigned int t = 0; t < a_meshlet.triangleCount; t++)
+	{
+		if (normals[t] != glm::vec3(0.0f))
+		{
+			minDot = std::min(minDot, glm::dot(normals[t], axis));
+		}
+	}
+	a_meshlet.coneAxis = axis;
+	if (minDot <= s_minConeDot)
+	{
+		return;
+	}
+	//Move the apex back along the axis until every triangle's plane is in front of it, so the test holds for
+	//cameras close to the meshlet and not just far away ones.
+	float apexDistance = 0.0f;
+	for (unsigned int t = 0; t < a_meshlet.triangleCount; t++)
+	{
+		if (normals[t] != glm::vec3(0.0f))
+		{
+			float distance = glm::dot(a_meshlet.center - corners[t], normals[t]) / glm::dot(axis, normals[t]);
+			apexDistance = std::max(apexDistance, distance);
+		}
+	}
+	a_meshlet.coneApex = a_meshlet.center - axis * apexDistance;
+	a_meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+void OBJMesh::BuildMeshlets(unsigned int a_maxVertices, unsigned int a_maxTriangles)
+{
+	m_meshlets.clear();
+	m_meshletVertices.clear();
+	m_meshletTriangles.clear();
+	a_maxVertices = std::min(std::max(a_maxVertices, 3u), 256u);
+	a_maxTriangles = std::max(a_maxTriangles, 1u);
+
+	//Walk the index buffer as (start, count, base vertex) runs so 16 bit ranges and 32 bit indices are handled alike,
+	//a meshlet never crosses a run so it can always be drawn with a single base vertex.
+	std::vector<OBJIndexRange> runs(m_indexRanges.begin(), m_indexRanges.end());
+	if (!HasShortIndices())
+	{
+		runs.push_back({ 0, (unsigned int)m_indices.size(), 0 });
+	}
+	std::vector<unsigned int> localIndex(GetVertexCount(), s_notInMeshlet);
+	OBJMeshlet meshlet = {};
+	auto finishMeshlet = [&]()
+	{
+		if (meshlet.triangleCount > 0)
+		{
+			CalculateMeshletBounds(*this, meshlet);
+			m_meshlets.push_back(meshlet);
+		}
+		for (unsigned int v = 0; v < meshlet.vertexCount; v++)
+		{
+			localIndex[m_meshletVertices[meshlet.vertexOffset + v]] = s_notInMeshlet;
+		}
+		meshlet = {};
+		meshlet.vertexOffset = (unsigned int)m_meshletVertices.size();
+		meshlet.triangleOffset = (unsigned int)m_meshletTriangles.size() / 3;
+	};
+	for (const OBJIndexRange& run : runs)
+	{
+		finishMeshlet();
+		meshlet.indexStart = run.indexStart;
+		meshlet.baseVertex = run.baseVertex;
+		for (unsigned int i = run.indexStart; i + 2 < run.indexStart + run.indexCount; i += 3)
+		{
+			unsigned int triangle[3];
+			for (int corner = 0; corner < 3; corner++)
+			{
+				triangle[corner] = HasShortIndices() ? run.baseVertex + m_shortIndices[i + corner] : m_indices[i + corner];
+			}
+			unsigned int newVertices = (localIndex[triangle[0]] == s_notInMeshlet ? 1 : 0) +
+				(localIndex[triangle[1]] == s_notInMeshlet && triangle[1] != triangle[0] ? 1 : 0) +
+				(localIndex[triangle[2]] == s_notInMeshlet && triangle[2] != triangle[0] && triangle[2] != triangle[1] ? 1 : 0);
+			if (meshlet.vertexCount + newVertices > a_maxVertices || meshlet.triangleCount >= a_maxTriangles)
+			{
+				finishMeshlet();
+				meshlet.indexStart = i;
+				meshlet.baseVertex = run.baseVertex;
+			}
+			for (int corner = 0; corner < 3; corner++)
+			{
+				unsigned int vertex = triangle[corner];
+				if (localIndex[vertex] == s_notInMeshlet)
+				{
+					localIndex[vertex] = meshlet.vertexCount++;
+					m_meshletVertices.push_back(vertex);
+				}
+				m_meshletTriangles.push_back((uint8_t)localIndex[vertex]);
+			}
+			meshlet.triangleCount++;
+		}
+	}
+	finishMeshlet();
+}
+
+void OBJMesh::CullMeshlets(const glm::mat4& a_clipFromModel, const glm::vec3& a_cameraPosition, std::vector<unsigned int>& a_visible) const
+{
+	//Frustum planes in model space, taken from the rows of the clip matrix and normalised so sphere tests use real distances.
+	glm::vec4 planes[6];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		glm::vec4 row = glm::vec4(a_clipFromModel[0][axis], a_clipFromModel[1][axis], a_clipFromModel[2][axis], a_clipFromModel[3][axis]);
+		glm::vec4 w = glm::vec4(a_clipFromModel[0][3], a_clipFromModel[1][3], a_clipFromModel[2][3], a_clipFromModel[3][3]);
+		planes[axis * 2] = w + row;
+		planes[axis * 2 + 1] = w - row;
+	}
+	for (glm::vec4& plane : planes)
+	{
+		float length = glm::length(glm::vec3(plane));
+		plane = (length > 0.0f) ? plane / length : plane;
+	}
+	for (unsigned int m = 0; m < m_meshlets.size(); m++)
+	{
+		const OBJMeshlet& meshlet = m_meshlets[m];
+		bool visible = true;
+		for (const glm::vec4& plane : planes)
+		{
+			if (glm::dot(glm::vec3(plane), meshlet.center) + plane.w < -meshlet.radius)
+			{
+				visible = false;
+				break;
+			}
+		}
+		if (visible && meshlet.coneCutoff < 1.0f)
+		{
+			glm::vec3 toApex = meshlet.coneApex - a_cameraPosition;
+			float distance = glm::length(toApex);
+			visible = !(distance > 0.0f && glm::dot(toApex / distance, meshlet.coneAxis) > meshlet.coneCutoff);
+		}
+		if (visible)
+		{
+			a_visible.push_back(m);
+		}
+	}
+}
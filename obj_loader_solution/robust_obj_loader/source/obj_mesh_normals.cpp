@@ -0,0 +1,388 @@
+#include "obj_loader.h"
+#include "parallel.h"
+#include "vertex_welder.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+//SSE2 is always there on x64 and on x86 builds that target it, other platforms use the scalar face kernel.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OBJ_NORMALS_SSE2
+#include <emmintrin.h>
+#endif
+
+//Vertex normal generation for OBJMesh.
+//Every corner adds its triangle's normal, weighted by the triangle's area and the corner's angle, to all the
+//vertices at the same position in the same smoothing group, so the result does not depend on how finely a
+//surface happens to be triangulated. The face pass gathers each batch of triangles' corners into separate x/y/z
+//arrays and then runs a branch-free SSE2 kernel over four triangles at a time, and both the face and vertex passes
+//are split across threads in blocks. Vertices that may share
+//a normal are hashed to the same partition, and the shared normals are numbered and summed one partition per thread.
+
+//Triangles or vertices per work item in the parallel passes.
+static const size_t s_normalBlockSize = 1 << 14;
+static const unsigned int s_noNormalKey = 0xFFFFFFFFu;
+
+//Triangles gathered at once by the face pass, small enough that a batch stays in L1.
+static const size_t s_faceBatchSize = 256;
+
+//acos without branches or library calls so that it has a SIMD twin, Abramowitz and Stegun 4.4.46
+//(absolute error below 2e-8, under float precision).
+static inline float FastAcos(float a_x)
+{
+	float x = std::fabs(a_x);
+	float polynomial = -0.0012624911f;
+	polynomial = polynomial * x + 0.0066700901f;
+	polynomial = polynomial * x - 0.0170881256f;
+	polynomial = polynomial * x + 0.0308918810f;
+	polynomial = polynomial * x - 0.0501743046f;
+	polynomial = polynomial * x + 0.0889789874f;
+	polynomial = polynomial * x - 0.2145988016f;
+	polynomial = polynomial * x + 1.5707963050f;
+	float angle = std::sqrt(1.0f - x) * polynomial;
+	return (a_x < 0.0f) ? 3.14159265f - angle : angle;
+}
+
+//Angle between two edges given their dot product and squared lengths, 0 for degenerate edges.
+static inline float CornerAngle(float a_dot, float a_lengthSquaredA, float a_lengthSquaredB)
+{
+	float denominator = std::sqrt(a_lengthSquaredA * a_lengthSquaredB);
+	//A cosine of 1 gives the 0 angle for degenerate edges without a branch.
+	float cosine = (denominator > 0.0f) ? a_dot / std::max(denominator, 1e-30f) : 1.0f;
+	return FastAcos(std::min(std::max(cosine, -1.0f), 1.0f));
+}
+
+//Corner positions of a batch of triangles, one array per corner and axis.
+struct FaceBatch
+{
+	float ax[s_faceBatchSize], ay[s_faceBatchSize], az[s_faceBatchSize];
+	float bx[s_faceBatchSize], by[s_faceBatchSize], bz[s_faceBatchSize];
+	float cx[s_faceBatchSize], cy[s_faceBatchSize], cz[s_faceBatchSize];
+};
+
+//Results for a batch of triangles: the unnormalised cross product (twice the area along the normal) and the corner angles.
+struct FaceBatchResult
+{
+	float nx[s_faceBatchSize], ny[s_faceBatchSize], nz[s_faceBatchSize];
+	float angleA[s_faceBatchSize], angleB[s_faceBatchSize], angleC[s_faceBatchSize];
+};
+
+#ifdef OBJ_NORMALS_SSE2
+//Four wide FastAcos.
+static inline __m128 FastAcos4(__m128 a_x)
+{
+	__m128 x = _mm_and_ps(a_x, _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF)));
+	__m128 polynomial = _mm_set1_ps(-0.0012624911f);
+	polynomial = _mm_add_ps(_mm_mul_ps(polynomial, x), _mm_set1_ps(0.0066700901f));
+	polynomial = _mm_add_ps(_mm_mul_ps(polynomial, x), _mm_set1_ps(-0.0170881256f));
+	polynomial = _mm_add_ps(_mm_mul_ps(polynomial, x), _mm_set1_ps(0.0308918810f));
+	polynomial = _mm_add_ps(_mm_mul_ps(polynomial, x), _mm_set1_ps(-0.0501743046f));
+	polynomial = _mm_add_ps(_mm_mul_ps(polynomial, x), _mm_set1_ps(0.0889789874f));
+	polynomial = _mm_add_ps(_mm_mul_ps(polynomial, x), _mm_set1_ps(-0.2145988016f));
+	polynomial = _mm_add_ps(_mm_mul_ps(polynomial, x), _mm_set1_ps(1.5707963050f));
+	__m128 angle = _mm_mul_ps(_mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.0f), x)), polynomial);
+	__m128 negative = _mm_cmplt_ps(a_x, _mm_setzero_ps());
+	return _mm_or_ps(_mm_and_ps(negative, _mm_sub_ps(_mm_set1_ps(3.14159265f), angle)), _mm_andnot_ps(negative, angle));
+}
+
+//Four wide CornerAngle.
+static inline __m128 CornerAngle4(__m128 a_dot, __m128 a_lengthSquaredA, __m128 a_lengthSquaredB)
+{
+	__m128 denominator = _mm_sqrt_ps(_mm_mul_ps(a_lengthSquaredA, a_lengthSquaredB));
+	__m128 valid = _mm_cmpgt_ps(denominator, _mm_setzero_ps());
+	__m128 cosine = _mm_div_ps(a_dot, _mm_max_ps(denominator, _mm_set1_ps(1e-30f)));
+	cosine = _mm_or_ps(_mm_and_ps(valid, cosine), _mm_andnot_ps(valid, _mm_set1_ps(1.0f)));
+	return FastAcos4(_mm_min_ps(_mm_max_ps(cosine, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f)));
+}
+#endif
+
+//Runs four triangles per instruction where SSE2 is available, the scalar loop finishes the batch.
+static void ComputeFaceBatch(const FaceBatch& a_batch, size_t a_count, FaceBatchResult& a_result)
+{
+	size_t t = 0;
+#ifdef OBJ_NORMALS_SSE2
+	for (; t + 4 <= a_count; t += 4)
+	{
+		__m128 ax = _mm_loadu_ps(&a_batch.ax[t]), ay = _mm_loadu_ps(&a_batch.ay[t]), az = _mm_loadu_ps(&a_batch.az[t]);
+		__m128 bx = _mm_loadu_ps(&a_batch.bx[t]), by = _mm_loadu_ps(&a_batch.by[t]), bz = _mm_loadu_ps(&a_batch.bz[t]);
+		__m128 cx = _mm_loadu_ps(&a_batch.cx[t]), cy = _mm_loadu_ps(&a_batch.cy[t]), cz = _mm_loadu_ps(&a_batch.cz[t]);
+		__m128 abx = _mm_sub_ps(bx, ax), aby = _mm_sub_ps(by, ay), abz = _mm_sub_ps(bz, az);
+		__m128 acx = _mm_sub_ps(cx, ax), acy = _mm_sub_ps(cy, ay), acz = _mm_sub_ps(cz, az);
+		__m128 bcx = _mm_sub_ps(cx, bx), bcy = _mm_sub_ps(cy, by), bcz = _mm_sub_ps(cz, bz);
+		_mm_storeu_ps(&a_result.nx[t], _mm_sub_ps(_mm_mul_ps(aby, acz), _mm_mul_ps(abz, acy)));
+		_mm_storeu_ps(&a_result.ny[t], _mm_sub_ps(_mm_mul_ps(abz, acx), _mm_mul_ps(abx, acz)));
+		_mm_storeu_ps(&a_result.nz[t], _mm_sub_ps(_mm_mul_ps(abx, acy), _mm_mul_ps(aby, acx)));
+		auto dot = [](__m128 a_x0, __m128 a_y0, __m128 a_z0, __m128 a_x1, __m128 a_y1, __m128 a_z1)
+		{
+			return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a_x0, a_x1), _mm_mul_ps(a_y0, a_y1)), _mm_mul_ps(a_z0, a_z1));
+		};
+		__m128 ab2 = dot(abx, aby, abz, abx, aby, abz);
+		__m128 ac2 = dot(acx, acy, acz, acx, acy, acz);
+		__m128 bc2 = dot(bcx, bcy, bcz, bcx, bcy, bcz);
+		_mm_storeu_ps(&a_result.angleA[t], CornerAngle4(dot(abx, aby, abz, acx, acy, acz), ab2, ac2));
+		_mm_storeu_ps(&a_result.angleB[t], CornerAngle4(_mm_sub_ps(_mm_setzero_ps(), dot(abx, aby, abz, bcx, bcy, bcz)), ab2, bc2));
+		_mm_storeu_ps(&a_result.angleC[t], CornerAngle4(dot(acx, acy, acz, bcx, bcy, bcz), ac2, bc2));
+	}
+#endif
+	for (; t < a_count; t++)
+	{
+		float abx = a_batch.bx[t] - a_batch.ax[t], aby = a_batch.by[t] - a_batch.ay[t], abz = a_batch.bz[t] - a_batch.az[t];
+		float acx = a_batch.cx[t] - a_batch.ax[t], acy = a_batch.cy[t] - a_batch.ay[t], acz = a_batch.cz[t] - a_batch.az[t];
+		float bcx = a_batch.cx[t] - a_batch.bx[t], bcy = a_batch.cy[t] - a_batch.by[t], bcz = a_batch.cz[t] - a_batch.bz[t];
+		a_result.nx[t] = aby * acz - abz * acy;
+		a_result.ny[t] = abz * acx - abx * acz;
+		a_result.nz[t] = abx * acy - aby * acx;
+		float ab2 = abx * abx + aby * aby + abz * abz;
+		float ac2 = acx * acx + acy * acy + acz * acz;
+		float bc2 = bcx * bcx + bcy * bcy + bcz * bcz;
+		a_result.angleA[t] = CornerAngle(abx * acx + aby * acy + abz * acz, ab2, ac2);
+		a_result.angleB[t] = CornerAngle(-(abx * bcx + aby * bcy + abz * bcz), ab2, bc2);
+		a_result.angleC[t] = CornerAngle(acx * bcx + acy * bcy + acz * bcz, ac2, bc2);
+	}
+}
+
+//Group the items [0, a_count) by a_partitionOf(i), which returns a_partitionCount for items to leave out. Partition p's
+//items end up in a_items[a_starts[p]] to a_items[a_starts[p + 1]] in increasing order, so the result does not depend
+//on the thread count. Counted and then scattered in blocks on all threads.
+template<typename PartitionOf>
+static void BucketByPartition(size_t a_count, size_t a_partitionCount, PartitionOf a_partitionOf, std::vector<unsigned int>& a_starts, std::vector<unsigned int>& a_items)
+{
+	size_t blockCount = (a_count + s_normalBlockSize - 1) / s_normalBlockSize;
+	std::vector<unsigned int> blockOffsets(blockCount * a_partitionCount, 0);
+	Parallel::For(blockCount, [&](size_t a_block)
+	{
+		unsigned int* counts = &blockOffsets[a_block * a_partitionCount];
+		size_t end = std::min(a_count, (a_block + 1) * s_normalBlockSize);
+		for (size_t i = a_block * s_normalBlockSize; i < end; i++)
+		{
+			size_t partition = a_partitionOf(i);
+			if (partition < a_partitionCount)
+			{
+				counts[partition]++;
+			}
+		}
+	});
+	//Each block's items of a partition go after those of the blocks before it.
+	a_starts.assign(a_partitionCount + 1, 0);
+	unsigned int offset = 0;
+	for (size_t p = 0; p < a_partitionCount; p++)
+	{
+		a_starts[p] = offset;
+		for (size_t b = 0; b < blockCount; b++)
+		{
+			unsigned int count = blockOffsets[b * a_partitionCount + p];
+			blockOffsets[b * a_partitionCount + p] = offset;
+			offset += count;
+		}
+	}
+	a_starts[a_partitionCount] = offset;
+	a_items.resize(offset);
+	Parallel::For(blockCount, [&](size_t a_block)
+	{
+		unsigned int* offsets = &blockOffsets[a_block * a_partitionCount];
+		size_t end = std::min(a_count, (a_block + 1) * s_normalBlockSize);
+		for (size_t i = a_block * s_normalBlockSize; i < end; i++)
+		{
+			size_t partition = a_partitionOf(i);
+			if (partition < a_partitionCount)
+			{
+				a_items[offsets[partition]++] = (unsigned int)i;
+			}
+		}
+	});
+}
+
+void OBJMesh::GenerateNormals()
+{
+	VertexLayout layout = m_layout;
+	SetVertexLayout(LAYOUT_INTERLEAVED);
+	std::vector<unsigned int> indices;
+	GetIndices(indices);
+	size_t triangleCount = indices.size() / 3;
+	size_t vertexCount = m_vertices.size();
+	//Without per triangle groups the whole mesh is one smoothing group.
+	bool useGroups = m_smoothingGroups.size() == triangleCount;
+	auto groupOf = [&](size_t a_triangle) { return useGroups ? m_smoothingGroups[a_triangle] : 1u; };
+	size_t vertexBlocks = (vertexCount + s_normalBlockSize - 1) / s_normalBlockSize;
+	size_t triangleBlocks = (triangleCount + s_normalBlockSize - 1) / s_normalBlockSize;
+
+	std::vector<float> px(vertexCount);
+	std::vector<float> py(vertexCount);
+	std::vector<float> pz(vertexCount);
+	Parallel::For(vertexBlocks, [&](size_t a_block)
+	{
+		size_t end = std::min(vertexCount, (a_block + 1) * s_normalBlockSize);
+		for (size_t v = a_block * s_normalBlockSize; v < end; v++)
+		{
+			px[v] = m_vertices[v].position.x;
+			py[v] = m_vertices[v].position.y;
+			pz[v] = m_vertices[v].position.z;
+		}
+	});
+
+	//Face pass: the unnormalised cross product (twice the area along the normal) and the three corner angles.
+	//The corners are gathered through the index buffer first so that the arithmetic runs over contiguous arrays.
+	std::vector<float> nx(triangleCount);
+	std::vector<float> ny(triangleCount);
+	std::vector<float> nz(triangleCount);
+	std::vector<float> angleA(triangleCount);
+	std::vector<float> angleB(triangleCount);
+	std::vector<float> angleC(triangleCount);
+	Parallel::For(triangleBlocks, [&](size_t a_block)
+	{
+		size_t end = std::min(triangleCount, (a_block + 1) * s_normalBlockSize);
+		const unsigned int* triangles = indices.data();
+		FaceBatch batch;
+		FaceBatchResult result;
+		for (size_t first = a_block * s_normalBlockSize; first < end; first += s_faceBatchSize)
+		{
+			size_t count = std::min(s_faceBatchSize, end - first);
+			for (size_t i = 0; i < count; i++)
+			{
+				const unsigned int* triangle = &triangles[(first + i) * 3];
+				batch.ax[i] = px[triangle[0]]; batch.ay[i] = py[triangle[0]]; batch.az[i] = pz[triangle[0]];
+				batch.bx[i] = px[triangle[1]]; batch.by[i] = py[triangle[1]]; batch.bz[i] = pz[triangle[1]];
+				batch.cx[i] = px[triangle[2]]; batch.cy[i] = py[triangle[2]]; batch.cz[i] = pz[triangle[2]];
+			}
+			ComputeFaceBatch(batch, count, result);
+			memcpy(&nx[first], result.nx, count * sizeof(float));
+			memcpy(&ny[first], result.ny, count * sizeof(float));
+			memcpy(&nz[first], result.nz, count * sizeof(float));
+			memcpy(&angleA[first], result.angleA, count * sizeof(float));
+			memcpy(&angleB[first], result.angleB, count * sizeof(float));
+			memcpy(&angleC[first], result.angleC, count * sizeof(float));
+		}
+	});
+
+	//Vertices at the same position in the same smoothing group share a normal, flat shaded vertices keep their own.
+	std::vector<unsigned int> vertexGroup(vertexCount, SMOOTHING_FILE_NORMALS);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		unsigned int group = groupOf(t);
+		if (group != SMOOTHING_FILE_NORMALS)
+		{
+			vertexGroup[indices[t * 3]] = group;
+			vertexGroup[indices[t * 3 + 1]] = group;
+			vertexGroup[indices[t * 3 + 2]] = group;
+		}
+	}
+	//Vertices are split between threads by a hash of their key and each thread numbers its share with its own weld
+	//table, the numbering is made global once every thread's key count is known. Small meshes are one partition so
+	//they run on the calling thread, which lets GenerateMissingNormals spread them across threads.
+	std::vector<unsigned int> normalKey(vertexCount, s_noNormalKey);
+	size_t partitionCount = std::min<size_t>(Parallel::GetThreadCount(), std::max<size_t>(vertexBlocks, 1));
+	std::vector<unsigned int> vertexPartition(vertexCount);
+	Parallel::For(vertexBlocks, [&](size_t a_block)
+	{
+		size_t end = std::min(vertexCount, (a_block + 1) * s_normalBlockSize);
+		for (size_t v = a_block * s_normalBlockSize; v < end; v++)
+		{
+			if (vertexGroup[v] == SMOOTHING_FILE_NORMALS)
+			{
+				vertexPartition[v] = (unsigned int)partitionCount;
+				continue;
+			}
+			if (vertexGroup[v] == SMOOTHING_OFF)
+			{
+				vertexPartition[v] = (unsigned int)(v % partitionCount);
+				continue;
+			}
+			uint32_t bits[3];
+			memcpy(&bits[0], &px[v], sizeof(float));
+			memcpy(&bits[1], &py[v], sizeof(float));
+			memcpy(&bits[2], &pz[v], sizeof(float));
+			//Fold -0 into 0 so both land in the same partition.
+			for (uint32_t& axis : bits)
+			{
+				axis = (axis == 0x80000000u) ? 0 : axis;
+			}
+			uint64_t hash = (bits[0] * 0x9E3779B97F4A7C15ull) ^ (bits[1] * 0xC2B2AE3D27D4EB4Full) ^ (bits[2] * 0x165667B19E3779F9ull) ^ vertexGroup[v];
+			vertexPartition[v] = (unsigned int)((hash >> 32) % partitionCount);
+		}
+	});
+	std::vector<unsigned int> partitionVertexStart;
+	std::vector<unsigned int> partitionVertices;
+	BucketByPartition(vertexCount, partitionCount, [&](size_t a_vertex) { return vertexPartition[a_vertex]; }, partitionVertexStart, partitionVertices);
+	std::vector<unsigned int> partitionKeys(partitionCount + 1, 0);
+	Parallel::For(partitionCount, [&](size_t a_partition)
+	{
+		OBJVertexWelder welder;
+		welder.Reserve(partitionVertexStart[a_partition + 1] - partitionVertexStart[a_partition]);
+		unsigned int keyCount = 0;
+		for (unsigned int i = partitionVertexStart[a_partition]; i < partitionVertexStart[a_partition + 1]; i++)
+		{
+			unsigned int v = partitionVertices[i];
+			if (vertexGroup[v] == SMOOTHING_OFF)
+			{
+				normalKey[v] = keyCount++;
+				continue;
+			}
+			OBJVertexWelder::Key key;
+			//Exact position bits with -0 folded into 0.
+			float position[3] = { px[v] + 0.0f, py[v] + 0.0f, pz[v] + 0.0f };
+			memcpy(&key.x, &position[0], sizeof(float));
+			memcpy(&key.y, &position[1], sizeof(float));
+			memcpy(&key.z, &position[2], sizeof(float));
+			key.vt = (int32_t)vertexGroup[v];
+			key.vn = 0;
+			if (!welder.FindOrInsert(key, keyCount, normalKey[v]))
+			{
+				keyCount++;
+			}
+		}
+		partitionKeys[a_partition + 1] = keyCount;
+	});
+	for (size_t p = 0; p < partitionCount; p++)
+	{
+		partitionKeys[p + 1] += partitionKeys[p];
+	}
+	unsigned int keyCount = partitionKeys[partitionCount];
+	if (partitionCount > 1)
+	{
+		Parallel::For(vertexBlocks, [&](size_t a_block)
+		{
+			size_t end = std::min(vertexCount, (a_block + 1) * s_normalBlockSize);
+			for (size_t v = a_block * s_normalBlockSize; v < end; v++)
+			{
+				if (normalKey[v] != s_noNormalKey)
+				{
+					normalKey[v] += partitionKeys[vertexPartition[v]];
+				}
+			}
+		});
+	}
+
+	//A partition's keys are only used by its own vertices, so the corners are grouped by their vertex's partition and
+	//each thread sums into its own keys. Corners stay in triangle order, so the sums match a serial pass exactly.
+	std::vector<unsigned int> partitionCornerStart;
+	std::vector<unsigned int> partitionCorners;
+	BucketByPartition(triangleCount * 3, partitionCount, [&](size_t a_corner)
+	{
+		return (groupOf(a_corner / 3) == SMOOTHING_FILE_NORMALS) ? partitionCount : (size_t)vertexPartition[indices[a_corner]];
+	}, partitionCornerStart, partitionCorners);
+	std::vector<glm::vec3> keyNormals(keyCount, glm::vec3(0.0f));
+	const float* cornerAngles[3] = { angleA.data(), angleB.data(), angleC.data() };
+	Parallel::For(partitionCount, [&](size_t a_partition)
+	{
+		for (unsigned int i = partitionCornerStart[a_partition]; i < partitionCornerStart[a_partition + 1]; i++)
+		{
+			unsigned int corner = partitionCorners[i];
+			unsigned int t = corner / 3;
+			keyNormals[normalKey[indices[corner]]] += glm::vec3(nx[t], ny[t], nz[t]) * cornerAngles[corner % 3][t];
+		}
+	});
+	Parallel::For(vertexBlocks, [&](size_t a_block)
+	{
+		size_t end = std::min(vertexCount, (a_block + 1) * s_normalBlockSize);
+		for (size_t v = a_block * s_normalBlockSize; v < end; v++)
+		{
+			if (normalKey[v] != s_noNormalKey)
+			{
+				glm::vec3 normal = keyNormals[normalKey[v]];
+				float length = glm::length(normal);
+				m_vertices[v].normal = glm::vec4((length > 0.0f) ? normal / length : normal, 0.0f);
+			}
+		}
+	});
+	SetVertexLayout(layout);
+}
@@ -0,0 +1,414 @@
+#include "obj_loader.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+//Triangle order optimisation for OBJMesh.
+//OptimizeVertexCache is Tom Forsyth's linear-speed vertex cache optimisation, OptimizeOverdraw follows
+//Sander et al. "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" and sorts clusters
+//of the cache optimised order so that outward facing clusters are drawn first.
+//OptimizeVertexFetch and SortTrianglesSpatially improve memory locality rather than GPU cache use.
+
+//Size of the LRU cache modelled while scoring vertices.
+static const int s_forsythCacheSize = 32;
+static const float s_cacheDecayPower = 1.5f;
+static const float s_lastTriangleScore = 0.75f;
+static const float s_valenceBoostScale = 2.0f;
+static const float s_valenceBoostPower = 0.5f;
+//Meshes with no more triangles than this are too small to gain from reordering clusters.
+static const size_t s_minClusterSize = 16;
+static const unsigned int s_unusedVertex = 0xFFFFFFFFu;
+
+static float ForsythVertexScore(int a_cachePosition, unsigned int a_liveTriangles)
+{
+	if (a_liveTriangles == 0)
+	{
+		//No triangles left to draw with this vertex.
+		return -1.0f;
+	}
+	float score = 0.0f;
+	if (a_cachePosition >= 0)
+	{
+		if (a_cachePosition < 3)
+		{
+			//Used by the last triangle, a fixed score stops the same strip being favoured forever.
+			score = s_lastTriangleScore;
+		}
+		else
+		{
+			float scaler = 1.0f / (s_forsythCacheSize - 3);
+			score = std::pow(1.0f - (a_cachePosition - 3) * scaler, s_cacheDecayPower);
+		}
+	}
+	//Boost vertices with few triangles left so they get finished off rather than left as stragglers.
+	score += s_valenceBoostScale * std::pow((float)a_liveTriangles, -s_valenceBoostPower);
+	return score;
+}
+
+float OBJMesh::CalculateACMR(unsigned int a_cacheSize) const
+{
+	//Average cache miss ratio for a FIFO post-transform cache, the number of vertices transformed per triangle.
+	size_t triangleCount = m_indices.size() / 3;
+	if (triangleCount == 0 || a_cacheSize == 0)
+	{
+		return 0.0f;
+	}
+	std::vector<unsigned int> timestamps(GetVertexCount(), 0);
+	unsigned int time = a_cacheSize + 1;
+	size_t misses = 0;
+	for (unsigned int index : m_indices)
+	{
+		if (time - timestamps[index] > a_cacheSize)
+		{
+			timestamps[index] = time++;
+			misses++;
+		}
+	}
+	return (float)misses / (float)triangleCount;
+}
+
+void OBJMesh::OptimizeVertexCache()
+{
+	size_t triangleCount = m_indices.size() / 3;
+	size_t vertexCount = GetVertexCount();
+	if (triangleCount < 2)
+	{
+		return;
+	}
+	//Triangles using each vertex, liveTriangles[v] of them at vertexTriangles[triangleStart[v]] are not yet emitted.
+	std::vector<unsigned int> liveTriangles(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		liveTriangles[m_indices[i]]++;
+	}
+	std::vector<unsigned int> triangleStart(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		triangleStart[v + 1] = triangleStart[v] + liveTriangles[v];
+	}
+	std::vector<unsigned int> vertexTriangles(triangleCount * 3);
+	std::vector<unsigned int> fill(triangleStart.begin(), triangleStart.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (size_t corner = 0; corner < 3; corner++)
+		{
+			unsigned int v = m_indices[t * 3 + corner];
+			vertexTriangles[fill[v]++] = (unsigned int)t;
+		}
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		vertexScore[v] = ForsythVertexScore(-1, liveTriangles[v]);
+	}
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	unsigned int bestTriangle = 0;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const unsigned int* triangle = &m_indices[t * 3];
+		triangleScore[t] = vertexScore[triangle[0]] + vertexScore[triangle[1]] + vertexScore[triangle[2]];
+		if (triangleScore[t] > triangleScore[bestTriangle])
+		{
+			bestTriangle = (unsigned int)t;
+		}
+	}
+
+	OBJArenaVector<unsigned int> optimized;
+	optimized.reserve(triangleCount * 3);
+	//The modelled cache, with room for the three vertices pushed in by each new triangle.
+	std::vector<unsigned int> cache;
+	std::vector<unsigned int> nextCache;
+	cache.reserve(s_forsythCacheSize + 3);
+	nextCache.reserve(s_forsythCacheSize + 3);
+	size_t scanTriangle = 0;
+	for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+	{
+		if (emitted[bestTriangle] || triangleScore[bestTriangle] < 0.0f)
+		{
+			//Nothing in the cache has triangles left, carry on from the first triangle not yet emitted.
+			while (emitted[scanTriangle])
+			{
+				scanTriangle++;
+			}
+			bestTriangle = (unsigned int)scanTriangle;
+		}
+		const unsigned int* triangle = &m_indices[bestTriangle * 3];
+		emitted[bestTriangle] = true;
+		nextCache.clear();
+		for (size_t corner = 0; corner < 3; corner++)
+		{
+			unsigned int v = triangle[corner];
+			optimized.push_back(v);
+			//Take the triangle off the vertex's live list.
+			unsigned int* begin = &vertexTriangles[triangleStart[v]];
+			unsigned int* end = begin + liveTriangles[v];
+			unsigned int* found = std::find(begin, end, bestTriangle);
+			if (found != end)
+			{
+				std::swap(*found, *(end - 1));
+				liveTriangles[v]--;
+			}
+			if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end())
+			{
+				nextCache.push_back(v);
+			}
+		}
+		for (unsigned int v : cache)
+		{
+			if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end())
+			{
+				nextCache.push_back(v);
+			}
+		}
+		//Rescore everything that was or is in the cache and push the score changes onto the live triangles.
+		for (size_t i = 0; i < nextCache.size(); i++)
+		{
+			unsigned int v = nextCache[i];
+			cachePosition[v] = (i < (size_t)s_forsythCacheSize) ? (int)i : -1;
+			float score = ForsythVertexScore(cachePosition[v], liveTriangles[v]);
+			float delta = score - vertexScore[v];
+			vertexScore[v] = score;
+			for (unsigned int n = 0; n < liveTriangles[v]; n++)
+			{
+				triangleScore[vertexTriangles[triangleStart[v] + n]] += delta;
+			}
+		}
+		if (nextCache.size() > (size_t)s_forsythCacheSize)
+		{
+			nextCache.resize(s_forsythCacheSize);
+		}
+		cache.swap(nextCache);
+		//The next triangle is the best scoring live triangle touching the cache.
+		float bestScore = -1.0f;
+		for (unsigned int v : cache)
+		{
+			for (unsigned int n = 0; n < liveTriangles[v]; n++)
+			{
+				unsigned int t = vertexTriangles[triangleStart[v] + n];
+				if (triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					bestTriangle = t;
+				}
+			}
+		}
+	}
+	//Any trailing indices that do not make a full triangle are kept at the end.
+	optimized.insert(optimized.end(), m_indices.begin() + triangleCount * 3, m_indices.end());
+	m_indices.swap(optimized);
+}
+
+void OBJMesh::OptimizeOverdraw(float a_threshold)
+{
+	size_t triangleCount = m_indices.size() / 3;
+	if (triangleCount <= s_minClusterSize)
+	{
+		return;
+	}
+	//Simulate a FIFO cache, a_time only moves on for misses. Moving it on by the cache size empties the cache,
+	//as happens when a cluster is drawn after some other cluster.
+	const unsigned int cacheSize = 16;
+	std::vector<unsigned int> timestamps(GetVertexCount(), 0);
+	unsigned int time = cacheSize + 1;
+	auto countMisses = [&](size_t a_triangle)
+	{
+		unsigned int misses = 0;
+		for (size_t corner = 0; corner < 3; corner++)
+		{
+			unsigned int index = m_indices[a_triangle * 3 + corner];
+			if (time - timestamps[index] > cacheSize)
+			{
+				timestamps[index] = time++;
+				misses++;
+			}
+		}
+		return misses;
+	};
+	//A triangle missing all three vertices is a point where the cache optimised order jumped and can be split
+	//without losing any locality.
+	size_t optimizedMisses = 0;
+	std::vector<size_t> hardBoundaries;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		unsigned int misses = countMisses(t);
+		optimizedMisses += misses;
+		if (t == 0 || misses == 3)
+		{
+			hardBoundaries.push_back(t);
+		}
+	}
+	hardBoundaries.push_back(triangleCount);
+
+	//Split each hard cluster further where the ACMR of the piece so far, starting from an empty cache, has come down
+	//to within a_threshold of the whole cluster's. Every piece then costs at most that much wherever it is drawn.
+	std::vector<size_t> clusterStart;
+	for (size_t h = 0; h + 1 < hardBoundaries.size(); h++)
+	{
+		size_t begin = hardBoundaries[h];
+		size_t end = hardBoundaries[h + 1];
+		time += cacheSize + 1;
+		size_t clusterMisses = 0;
+		for (size_t t = begin; t < end; t++)
+		{
+			clusterMisses += countMisses(t);
+		}
+		float clusterBound = a_threshold * (float)clusterMisses / (float)(end - begin);
+		clusterStart.push_back(begin);
+		time += cacheSize + 1;
+		size_t pieceStart = begin;
+		size_t pieceMisses = 0;
+		for (size_t t = begin; t + 1 < end; t++)
+		{
+			pieceMisses += countMisses(t);
+			if ((float)pieceMisses / (float)(t + 1 - pieceStart) <= clusterBound)
+			{
+				pieceStart = t + 1;
+				pieceMisses = 0;
+				clusterStart.push_back(pieceStart);
+				time += cacheSize + 1;
+			}
+		}
+	}
+	clusterStart.push_back(triangleCount);
+	size_t clusterCount = clusterStart.size() - 1;
+
+	//A view independent guess at draw order: clusters far out along their own normal are likely to occlude the rest.
+	std::vector<glm::vec3> clusterCentroid(clusterCount, glm::vec3(0.0f));
+	std::vector<glm::vec3> clusterNormal(clusterCount, glm::vec3(0.0f));
+	glm::vec3 meshCentroid = glm::vec3(0.0f);
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		float clusterArea = 0.0f;
+		for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; t++)
+		{
+			glm::vec3 a = GetVertexPosition(m_indices[t * 3]);
+			glm::vec3 b = GetVertexPosition(m_indices[t * 3 + 1]);
+			glm::vec3 p = GetVertexPosition(m_indices[t * 3 + 2]);
+			glm::vec3 normal = glm::cross(b - a, p - a);
+			float area = glm::length(normal);
+			clusterCentroid[c] += (a + b + p) * (area / 3.0f);
+			clusterNormal[c] += normal;
+			clusterArea += area;
+		}
+		meshCentroid += clusterCentroid[c];
+		meshArea += clusterArea;
+		clusterCentroid[c] = (clusterArea > 0.0f) ? clusterCentroid[c] / clusterArea : clusterCentroid[c];
+	}
+	if (meshArea > 0.0f)
+	{
+		meshCentroid /= meshArea;
+	}
+	std::vector<float> sortKey(clusterCount);
+	std::vector<size_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		float length = glm::length(clusterNormal[c]);
+		glm::vec3 normal = (length > 0.0f) ? clusterNormal[c] / length : glm::vec3(0.0f);
+		sortKey[c] = glm::dot(clusterCentroid[c] - meshCentroid, normal);
+		order[c] = c;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](size_t a_lhs, size_t a_rhs) { return sortKey[a_lhs] > sortKey[a_rhs]; });
+
+	OBJArenaVector<unsigned int> sorted;
+	sorted.reserve(m_indices.size());
+	for (size_t c : order)
+	{
+		sorted.insert(sorted.end(), m_indices.begin() + clusterStart[c] * 3, m_indices.begin() + clusterStart[c + 1] * 3);
+	}
+	sorted.insert(sorted.end(), m_indices.begin() + triangleCount * 3, m_indices.end());
+
+	//Pieces that end a little before the cluster's own ACMR can still add up to more, keep the cache optimised
+	//order if the sorted one is outside the bound.
+	time += cacheSize + 1;
+	size_t sortedMisses = 0;
+	sorted.swap(m_indices);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		sortedMisses += countMisses(t);
+	}
+	if ((float)sortedMisses > a_threshold * (float)optimizedMisses)
+	{
+		m_indices.swap(sorted);
+	}
+}
+
+//Spreads the low 10 bits of a_value out to every third bit.
+static uint32_t SpreadMortonBits(uint32_t a_value)
+{
+	a_value &= 0x3FF;
+	a_value = (a_value | (a_value << 16)) & 0x030000FF;
+	a_value = (a_value | (a_value << 8)) & 0x0300F00F;
+	a_value = (a_value | (a_value << 4)) & 0x030C30C3;
+	a_value = (a_value | (a_value << 2)) & 0x09249249;
+	return a_value;
+}
+
+void OBJMesh::SortTrianglesSpatially()
+{
+	size_t triangleCount = m_indices.size() / 3;
+	if (triangleCount < 2)
+	{
+		return;
+	}
+	std::vector<glm::vec3> centroids(triangleCount);
+	glm::vec3 minimum = glm::vec3(0.0f);
+	glm::vec3 maximum = glm::vec3(0.0f);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		centroids[t] = (GetVertexPosition(m_indices[t * 3]) + GetVertexPosition(m_indices[t * 3 + 1]) + GetVertexPosition(m_indices[t * 3 + 2])) / 3.0f;
+		minimum = (t == 0) ? centroids[t] : glm::min(minimum, centroids[t]);
+		maximum = (t == 0) ? centroids[t] : glm::max(maximum, centroids[t]);
+	}
+	//Centroids are quantized to 10 bits per axis over the centroid bounds and interleaved into a 30 bit key.
+	glm::vec3 extent = maximum - minimum;
+	glm::vec3 toGrid = glm::vec3(0.0f);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (extent[axis] > 0.0f)
+		{
+			toGrid[axis] = 1023.0f / extent[axis];
+		}
+	}
+	std::vector<std::pair<uint32_t, unsigned int>> keys(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		glm::vec3 cell = (centroids[t] - minimum) * toGrid;
+		keys[t].first = SpreadMortonBits((uint32_t)cell.x) | (SpreadMortonBits((uint32_t)cell.y) << 1) | (SpreadMortonBits((uint32_t)cell.z) << 2);
+		keys[t].second = (unsigned int)t;
+	}
+	std::sort(keys.begin(), keys.end());
+
+	OBJArenaVector<unsigned int> sorted;
+	sorted.reserve(m_indices.size());
+	for (const std::pair<uint32_t, unsigned int>& key : keys)
+	{
+		sorted.insert(sorted.end(), m_indices.begin() + key.second * 3, m_indices.begin() + key.second * 3 + 3);
+	}
+	sorted.insert(sorted.end(), m_indices.begin() + triangleCount * 3, m_indices.end());
+	m_indices.swap(sorted);
+}
+
+void OBJMesh::OptimizeVertexFetch()
+{
+	if (m_indices.empty())
+	{
+		return;
+	}
+	std::vector<unsigned int> oldToNew(GetVertexCount(), s_unusedVertex);
+	std::vector<unsigned int> newToOld;
+	newToOld.reserve(GetVertexCount());
+	for (unsigned int& index : m_indices)
+	{
+		if (oldToNew[index] == s_unusedVertex)
+		{
+			oldToNew[index] = (unsigned int)newToOld.size();
+			newToOld.push_back(index);
+		}
+		index = oldToNew[index];
+	}
+	RemapVertices(newToOld);
+}
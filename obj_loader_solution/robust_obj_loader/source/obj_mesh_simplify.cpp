@@ -0,0 +1,325 @@
+#include "obj_loader.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <tuple>
+#include <unordered_map>
+
+//Level of detail generation for OBJMesh by quadric error edge collapse (Garland and Heckbert), every vertex is
+//collapsed onto one of its neighbours so the levels are just index buffers over the mesh's own vertices.
+//Vertices on an open border, and vertices split by a UV or normal seam, are never moved so the levels do not
+//tear, meshes therefore need welded vertices (LOAD_WELD_VERTICES) to simplify well.
+
+static const unsigned int s_noTarget = 0xFFFFFFFFu;
+
+//Sum of squared distances to a set of planes, stored as the upper half of a symmetric 4x4 matrix.
+struct OBJQuadric
+{
+	double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+
+	void AddPlane(const glm::dvec3& a_normal, double a_distance)
+	{
+		a2 += a_normal.x * a_normal.x; ab += a_normal.x * a_normal.y; ac += a_normal.x * a_normal.z; ad += a_normal.x * a_distance;
+		b2 += a_normal.y * a_normal.y; bc += a_normal.y * a_normal.z; bd += a_normal.y * a_distance;
+		c2 += a_normal.z * a_normal.z; cd += a_normal.z * a_distance;
+		d2 += a_distance * a_distance;
+	}
+	void Add(const OBJQuadric& a_other)
+	{
+		a2 += a_other.a2; ab += a_other.ab; ac += a_other.ac; ad += a_other.ad;
+		b2 += a_other.b2; bc += a_other.bc; bd += a_other.bd;
+		c2 += a_other.c2; cd += a_other.cd;
+		d2 += a_other.d2;
+	}
+	double Evaluate(const glm::dvec3& a_point) const
+	{
+		const double x = a_point.x, y = a_point.y, z = a_point.z;
+		double error = a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x +
+			b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y +
+			c2 * z * z + 2.0 * cd * z + d2;
+		return std::max(error, 0.0);
+	}
+};
+
+//A queued collapse of vertex from onto vertex to, stale once the vertex's version has moved on.
+struct OBJCollapse
+{
+	double error;
+	unsigned int from;
+	unsigned int to;
+	unsigned int version;
+	bool operator>(const OBJCollapse& a_other) const { return error > a_other.error; }
+};
+
+void OBJMesh::GetIndices(std::vector<unsigned int>& a_indices) const
+{
+	if (!HasShortIndices())
+	{
+		a_indices.assign(m_indices.begin(), m_indices.end());
+		return;
+	}
+	a_indices.resize(m_shortIndices.size());
+	for (const OBJIndexRange& range : m_indexRanges)
+	{
+		for (unsigned int i = range.indexStart; i < range.indexStart + range.indexCount; i++)
+		{
+			a_indices[i] = range.baseVertex + m_shortIndices[i];
+		}
+	}
+}
+
+void OBJMesh::BuildLods(const std::vector<float>& a_ratios)
+{
+	m_lodIndices.clear();
+	m_lodLevels.clear();
+	std::vector<unsigned int> triangles;
+	GetIndices(triangles);
+	size_t triangleCount = triangles.size() / 3;
+	size_t vertexCount = GetVertexCount();
+	if (triangleCount == 0)
+	{
+		return;
+	}
+	std::vector<glm::dvec3> positions(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		positions[v] = glm::dvec3(GetVertexPosition((unsigned int)v));
+	}
+
+	//Group vertices that share a position, a position with more than one vertex is on a seam.
+	std::vector<unsigned int> positionId(vertexCount);
+	std::vector<unsigned int> positionUses;
+	{
+		std::vector<unsigned int> byPosition(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			byPosition[v] = (unsigned int)v;
+		}
+		std::sort(byPosition.begin(), byPosition.end(), [&](unsigned int a_lhs, unsigned int a_rhs)
+		{
+			return std::tie(positions[a_lhs].x, positions[a_lhs].y, positions[a_lhs].z) < std::tie(positions[a_rhs].x, positions[a_rhs].y, positions[a_rhs].z);
+		});
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			if (i == 0 || positions[byPosition[i]] != positions[byPosition[i - 1]])
+			{
+				positionUses.push_back(0);
+			}
+			positionId[byPosition[i]] = (unsigned int)positionUses.size() - 1;
+			positionUses.back()++;
+		}
+	}
+	std::vector<bool> lockedPosition(positionUses.size(), false);
+	for (size_t p = 0; p < positionUses.size(); p++)
+	{
+		lockedPosition[p] = positionUses[p] > 1;
+	}
+	//Edges used by anything but exactly two triangles are open borders or non-manifold, lock both ends.
+	{
+		std::unordered_map<uint64_t, unsigned int> edgeUses;
+		edgeUses.reserve(triangleCount * 3);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			for (int corner = 0; corner < 3; corner++)
+			{
+				uint64_t a = positionId[triangles[t * 3 + corner]];
+				uint64_t b = positionId[triangles[t * 3 + (corner + 1) % 3]];
+				edgeUses[(std::min(a, b) << 32) | std::max(a, b)]++;
+			}
+		}
+		for (const std::pair<const uint64_t, unsigned int>& edge : edgeUses)
+		{
+			if (edge.second != 2)
+			{
+				lockedPosition[(unsigned int)(edge.first >> 32)] = true;
+				lockedPosition[(unsigned int)(edge.first & 0xFFFFFFFFu)] = true;
+			}
+		}
+	}
+
+	//Each vertex starts with the planes of the triangles around it.
+	std::vector<OBJQuadric> quadrics(vertexCount);
+	memset(quadrics.data(), 0, quadrics.size() * sizeof(OBJQuadric));
+	std::vector<std::vector<unsigned int>> vertexTriangles(vertexCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const unsigned int* triangle = &triangles[t * 3];
+		glm::dvec3 normal = glm::cross(positions[triangle[1]] - positions[triangle[0]], positions[triangle[2]] - positions[triangle[0]]);
+		double length = glm::length(normal);
+		if (length > 0.0)
+		{
+			normal /= length;
+			for (int corner = 0; corner < 3; corner++)
+			{
+				quadrics[triangle[corner]].AddPlane(normal, -glm::dot(normal, positions[triangle[0]]));
+			}
+		}
+		for (int corner = 0; corner < 3; corner++)
+		{
+			vertexTriangles[triangle[corner]].push_back((unsigned int)t);
+		}
+	}
+
+	std::vector<bool> triangleAlive(triangleCount, true);
+	std::vector<bool> vertexAlive(vertexCount, true);
+	std::vector<unsigned int> version(vertexCount, 0);
+	std::priority_queue<OBJCollapse, std::vector<OBJCollapse>, std::greater<OBJCollapse>> queue;
+	//Queues the cheapest collapse of a_vertex onto one of its neighbours.
+	auto queueCollapse = [&](unsigned int a_vertex)
+	{
+		version[a_vertex]++;
+		if (!vertexAlive[a_vertex] || lockedPosition[positionId[a_vertex]])
+		{
+			return;
+		}
+		OBJCollapse best = { 0.0, a_vertex, s_noTarget, version[a_vertex] };
+		for (unsigned int t : vertexTriangles[a_vertex])
+		{
+			for (int corner = 0; corner < 3; corner++)
+			{
+				unsigned int target = triangles[t * 3 + corner];
+				if (target == a_vertex)
+				{
+					continue;
+				}
+				OBJQuadric combined = quadrics[a_vertex];
+				combined.Add(quadrics[target]);
+				double error = combined.Evaluate(positions[target]);
+				if (best.to == s_noTarget || error < best.error)
+				{
+					best.error = error;
+					best.to = target;
+				}
+			}
+		}
+		if (best.to != s_noTarget)
+		{
+			queue.push(best);
+		}
+	};
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		queueCollapse((unsigned int)v);
+	}
+
+	//Levels are taken from one run of collapses, each snapshot continuing from the last.
+	std::vector<float> ratios = a_ratios;
+	std::sort(ratios.begin(), ratios.end(), std::greater<float>());
+	size_t liveTriangles = triangleCount;
+	double maxError = 0.0;
+	std::vector<unsigned int> neighbours;
+	auto takeSnapshot = [&]()
+	{
+		if (liveTriangles == (m_lodLevels.empty() ? triangleCount : m_lodLevels.back().indexCount / 3))
+		{
+			return;
+		}
+		OBJLodLevel level = { (unsigned int)m_lodIndices.size(), (unsigned int)liveTriangles * 3, (float)std::sqrt(maxError) };
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			if (triangleAlive[t])
+			{
+				m_lodIndices.insert(m_lodIndices.end(), triangles.begin() + t * 3, triangles.begin() + t * 3 + 3);
+			}
+		}
+		m_lodLevels.push_back(level);
+	};
+	for (float ratio : ratios)
+	{
+		size_t target = (size_t)(triangleCount * ratio);
+		while (liveTriangles > target && !queue.empty())
+		{
+			OBJCollapse collapse = queue.top();
+			queue.pop();
+			if (collapse.version != version[collapse.from] || !vertexAlive[collapse.to])
+			{
+				continue;
+			}
+			//Reject collapses that would flip a triangle over.
+			bool flips = false;
+			for (unsigned int t : vertexTriangles[collapse.from])
+			{
+				const unsigned int* triangle = &triangles[t * 3];
+				if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+				{
+					continue;
+				}
+				glm::dvec3 corners[3];
+				for (int corner = 0; corner < 3; corner++)
+				{
+					corners[corner] = positions[triangle[corner]];
+				}
+				glm::dvec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+				for (int corner = 0; corner < 3; corner++)
+				{
+					corners[corner] = (triangle[corner] == collapse.from) ? positions[collapse.to] : corners[corner];
+				}
+				glm::dvec3 after = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+				if (glm::dot(before, after) <= 0.0)
+				{
+					flips = true;
+					break;
+				}
+			}
+			if (flips)
+			{
+				continue;
+			}
+
+			neighbours.clear();
+			for (unsigned int t : vertexTriangles[collapse.from])
+			{
+				unsigned int* triangle = &triangles[t * 3];
+				if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+				{
+					triangleAlive[t] = false;
+					liveTriangles--;
+				}
+				else
+				{
+					for (int corner = 0; corner < 3; corner++)
+					{
+						triangle[corner] = (triangle[corner] == collapse.from) ? collapse.to : triangle[corner];
+					}
+					vertexTriangles[collapse.to].push_back(t);
+				}
+				neighbours.insert(neighbours.end(), triangle, triangle + 3);
+			}
+			quadrics[collapse.to].Add(quadrics[collapse.from]);
+			vertexAlive[collapse.from] = false;
+			std::vector<unsigned int>().swap(vertexTriangles[collapse.from]);
+			maxError = std::max(maxError, collapse.error);
+			//Drop the triangles that just died from the neighbours' lists and requeue them with their new costs.
+			std::sort(neighbours.begin(), neighbours.end());
+			neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+			for (unsigned int neighbour : neighbours)
+			{
+				std::vector<unsigned int>& list = vertexTriangles[neighbour];
+				list.erase(std::remove_if(list.begin(), list.end(), [&](unsigned int a_triangle) { return !triangleAlive[a_triangle]; }), list.end());
+				queueCollapse(neighbour);
+			}
+		}
+		takeSnapshot();
+	}
+}
+
+unsigned int OBJMesh::SelectLod(const glm::vec3& a_cameraPosition, float a_pixelsPerUnit, float a_maxPixelError) const
+{
+	//Distance to the nearest point of the bounds, inside them the full mesh is always used.
+	float distance = glm::length(a_cameraPosition - m_bounds.GetCenter()) - m_bounds.GetRadius();
+	if (distance <= 0.0f)
+	{
+		return 0;
+	}
+	unsigned int lod = 0;
+	for (unsigned int level = 0; level < m_lodLevels.size(); level++)
+	{
+		if (m_lodLevels[level].error / distance * a_pixelsPerUnit > a_maxPixelError)
+		{
+			break;
+		}
+		lod = level + 1;
+	}
+	return lod;
+}
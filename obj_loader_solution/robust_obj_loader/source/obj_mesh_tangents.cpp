@@ -0,0 +1,146 @@
+#include "obj_loader.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+//Tangent generation for OBJMesh, following Morten Mikkelsen's MikkTSpace so normal maps baked against it shade
+//correctly. Each triangle's tangent comes from its uv derivatives, is projected into the plane of each corner's
+//normal and summed, weighted by the corner angle, over all corners with the same vertex data and the same uv winding.
+//Vertices shared by triangles with opposite uv winding (mirrored uvs) are split so each side keeps its own sign.
+
+static const unsigned int s_noVertex = 0xFFFFFFFFu;
+static const float s_tangentEpsilon = 1e-20f;
+
+//Part of a_vector perpendicular to the unit vector a_normal, normalised, or zero if nothing is left.
+static glm::vec3 PerpendicularUnit(const glm::vec3& a_vector, const glm::vec3& a_normal)
+{
+	glm::vec3 perpendicular = a_vector - a_normal * glm::dot(a_normal, a_vector);
+	float lengthSquared = glm::dot(perpendicular, perpendicular);
+	return (lengthSquared > s_tangentEpsilon) ? perpendicular / std::sqrt(lengthSquared) : glm::vec3(0.0f);
+}
+
+static glm::vec3 UnitNormal(const OBJVertex& a_vertex)
+{
+	glm::vec3 normal = glm::vec3(a_vertex.normal);
+	float length = glm::length(normal);
+	return (length > 0.0f) ? normal / length : normal;
+}
+
+bool OBJMesh::GenerateTangents()
+{
+	if (HasShortIndices())
+	{
+		return false;
+	}
+	VertexLayout layout = m_layout;
+	SetVertexLayout(LAYOUT_INTERLEAVED);
+	size_t vertexCount = m_vertices.size();
+	size_t triangleCount = m_indices.size() / 3;
+
+	//Tangent direction and uv winding of each triangle, triangles with no uv area have neither.
+	std::vector<glm::vec3> faceTangents(triangleCount, glm::vec3(0.0f));
+	std::vector<int8_t> faceWinding(triangleCount, 0);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const OBJVertex& a = m_vertices[m_indices[t * 3]];
+		const OBJVertex& b = m_vertices[m_indices[t * 3 + 1]];
+		const OBJVertex& c = m_vertices[m_indices[t * 3 + 2]];
+		glm::vec3 edgeB = glm::vec3(b.position - a.position);
+		glm::vec3 edgeC = glm::vec3(c.position - a.position);
+		glm::vec2 uvB = b.uvcoord - a.uvcoord;
+		glm::vec2 uvC = c.uvcoord - a.uvcoord;
+		float uvArea = uvB.x * uvC.y - uvB.y * uvC.x;
+		glm::vec3 tangent = edgeB * uvC.y - edgeC * uvB.y;
+		float length = glm::length(tangent);
+		if (uvArea != 0.0f && length > 0.0f)
+		{
+			faceWinding[t] = (uvArea > 0.0f) ? 1 : -1;
+			faceTangents[t] = tangent * (faceWinding[t] / length);
+		}
+	}
+
+	//Number the distinct vertex values, unwelded meshes repeat the same vertex for every face corner.
+	std::vector<unsigned int> vertexClass(vertexCount);
+	std::vector<unsigned int> order(vertexCount);
+	std::iota(order.begin(), order.end(), 0u);
+	std::sort(order.begin(), order.end(), [&](unsigned int a_lhs, unsigned int a_rhs) { return m_vertices[a_lhs] < m_vertices[a_rhs]; });
+	unsigned int classCount = 0;
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		if (i == 0 || !(m_vertices[order[i]] == m_vertices[order[i - 1]]))
+		{
+			classCount++;
+		}
+		vertexClass[order[i]] = classCount - 1;
+	}
+	std::vector<unsigned int>().swap(order);
+
+	//The first winding to use a vertex keeps it, corners with the other winding move to a copy of it.
+	std::vector<int8_t> vertexSign(vertexCount, 0);
+	std::vector<unsigned int> mirrored(vertexCount, s_noVertex);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		int8_t winding = faceWinding[i / 3];
+		unsigned int vertex = m_indices[i];
+		if (winding == 0 || vertexSign[vertex] == winding)
+		{
+			continue;
+		}
+		if (vertexSign[vertex] == 0)
+		{
+			vertexSign[vertex] = winding;
+			continue;
+		}
+		if (mirrored[vertex] == s_noVertex)
+		{
+			mirrored[vertex] = (unsigned int)m_vertices.size();
+			OBJVertex copy = m_vertices[vertex];
+			m_vertices.push_back(copy);
+			vertexClass.push_back(vertexClass[vertex]);
+			vertexSign.push_back(winding);
+		}
+		m_indices[i] = mirrored[vertex];
+	}
+	std::vector<unsigned int>().swap(mirrored);
+
+	//Sum the corners of each vertex value and winding.
+	std::vector<glm::vec3> classTangents((size_t)classCount * 2, glm::vec3(0.0f));
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		if (faceWinding[t] == 0)
+		{
+			continue;
+		}
+		for (int corner = 0; corner < 3; corner++)
+		{
+			unsigned int vertex = m_indices[t * 3 + corner];
+			glm::vec3 position = glm::vec3(m_vertices[vertex].position);
+			glm::vec3 normal = UnitNormal(m_vertices[vertex]);
+			glm::vec3 next = glm::vec3(m_vertices[m_indices[t * 3 + (corner + 1) % 3]].position);
+			glm::vec3 previous = glm::vec3(m_vertices[m_indices[t * 3 + (corner + 2) % 3]].position);
+			//Corner angle measured in the normal's plane, as MikkTSpace does.
+			float cosine = glm::dot(PerpendicularUnit(next - position, normal), PerpendicularUnit(previous - position, normal));
+			float angle = std::acos(std::min(std::max(cosine, -1.0f), 1.0f));
+			classTangents[(size_t)vertexClass[vertex] * 2 + (faceWinding[t] < 0)] += PerpendicularUnit(faceTangents[t], normal) * angle;
+		}
+	}
+
+	m_tangents.resize(m_vertices.size());
+	for (size_t v = 0; v < m_vertices.size(); v++)
+	{
+		glm::vec3 normal = UnitNormal(m_vertices[v]);
+		glm::vec3 tangent = PerpendicularUnit(classTangents[(size_t)vertexClass[v] * 2 + (vertexSign[v] < 0)], normal);
+		if (tangent == glm::vec3(0.0f))
+		{
+			//No uv mapped triangle uses this vertex, any tangent in the normal's plane will do.
+			tangent = PerpendicularUnit((std::abs(normal.x) < 0.9f) ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f), normal);
+			if (tangent == glm::vec3(0.0f))
+			{
+				tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+			}
+		}
+		m_tangents[v] = glm::vec4(tangent, (vertexSign[v] < 0) ? -1.0f : 1.0f);
+	}
+	SetVertexLayout(layout);
+	return true;
+}
@@ -0,0 +1,120 @@
+#include "vertex_welder.h"
+
+#include <algorithm>
+
+//Slot value marking an empty entry.
+static const unsigned int s_emptySlot = 0xFFFFFFFFu;
+//Starting capacity, always a power of two so the hash can be masked rather than divided.
+static const size_t s_initialCapacity = 1024;
+
+OBJVertexWelder::OBJVertexWelder() : m_keys(s_initialCapacity), m_values(s_initialCapacity, s_emptySlot), m_count(0), m_mask(s_initialCapacity - 1)
+{
+}
+
+void OBJVertexWelder::Clear()
+{
+	//Models with thousands of small groups clear the table constantly, do not keep sweeping a huge table for them.
+	if (m_values.size() > s_initialCapacity && m_count * 8 < m_values.size())
+	{
+		size_t capacity = s_initialCapacity;
+		while (capacity < m_count * 4)
+		{
+			capacity <<= 1;
+		}
+		m_keys.assign(capacity, Key());
+		m_values.assign(capacity, s_emptySlot);
+		m_mask = capacity - 1;
+	}
+	else
+	{
+		std::fill(m_values.begin(), m_values.end(), s_emptySlot);
+	}
+	m_count = 0;
+}
+
+void OBJVertexWelder::Reserve(size_t a_count)
+{
+	size_t capacity = m_values.size();
+	while (capacity < a_count * 2)
+	{
+		capacity <<= 1;
+	}
+	if (capacity == m_values.size())
+	{
+		return;
+	}
+	if (m_count == 0)
+	{
+		m_keys.assign(capacity, Key());
+		m_values.assign(capacity, s_emptySlot);
+		m_mask = capacity - 1;
+		return;
+	}
+	while (m_values.size() < capacity)
+	{
+		Grow();
+	}
+}
+
+bool OBJVertexWelder::FindOrInsert(const Key& a_key, unsigned int a_newIndex, unsigned int& a_index)
+{
+	//Keep the load factor under one half so probe sequences stay short.
+	if ((m_count + 1) * 2 > m_values.size())
+	{
+		Grow();
+	}
+	size_t slot = Hash(a_key) & m_mask;
+	while (m_values[slot] != s_emptySlot)
+	{
+		if (m_keys[slot] == a_key)
+		{
+			a_index = m_values[slot];
+			return true;
+		}
+		slot = (slot + 1) & m_mask;
+	}
+	m_keys[slot] = a_key;
+	m_values[slot] = a_newIndex;
+	m_count++;
+	a_index = a_newIndex;
+	return false;
+}
+
+uint64_t OBJVertexWelder::Hash(const Key& a_key)
+{
+	//Multiply-xorshift mix of the five fields, cheap and good enough for linear probing.
+	uint64_t h = (uint64_t)(uint32_t)a_key.x * 0x9E3779B97F4A7C15ull;
+	h ^= (uint64_t)(uint32_t)a_key.y * 0xC2B2AE3D27D4EB4Full;
+	h ^= (uint64_t)(uint32_t)a_key.z * 0x165667B19E3779F9ull;
+	h ^= (uint64_t)(uint32_t)a_key.vt * 0x27D4EB2F165667C5ull;
+	h ^= (uint64_t)(uint32_t)a_key.vn * 0x94D049BB133111EBull;
+	h ^= h >> 32;
+	h *= 0xD6E8FEB86659FD93ull;
+	h ^= h >> 29;
+	return h;
+}
+
+void OBJVertexWelder::Grow()
+{
+	std::vector<Key> oldKeys;
+	std::vector<unsigned int> oldValues;
+	oldKeys.swap(m_keys);
+	oldValues.swap(m_values);
+	size_t capacity = oldValues.size() * 2;
+	m_keys.assign(capacity, Key());
+	m_values.assign(capacity, s_emptySlot);
+	m_mask = capacity - 1;
+	for (size_t i = 0; i < oldValues.size(); i++)
+	{
+		if (oldValues[i] != s_emptySlot)
+		{
+			size_t slot = Hash(oldKeys[i]) & m_mask;
+			while (m_values[slot] != s_emptySlot)
+			{
+				slot = (slot + 1) & m_mask;
+			}
+			m_keys[slot] = oldKeys[i];
+			m_values[slot] = oldValues[i];
+		}
+	}
+}